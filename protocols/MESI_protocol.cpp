@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -19,7 +19,15 @@ MESI_protocol::~MESI_protocol() {
 
 void MESI_protocol::dump(void) {
     const char *block_states[5] = { "X", "I", "S", "E", "M" };
-    fprintf(stderr, "MESI_protocol - state: %s\n", block_states[state]);
+    fprintf(SIM_LOG, "MESI_protocol - state: %s\n", block_states[state]);
+}
+
+int MESI_protocol::get_state(void) {
+    return state;
+}
+
+void MESI_protocol::set_state(int state) {
+    this->state = (MESI_cache_state_t)state;
 }
 
 void MESI_protocol::process_cache_request(Mreq *request) {
@@ -77,7 +85,7 @@ inline void MESI_protocol::do_cache_I(Mreq *request) {
             state = MESI_CACHE_ISE;
 
             //Cache miss as well
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         case STORE:
             //Request data with intent to modify. Move to state IM to await DATA message
@@ -85,7 +93,7 @@ inline void MESI_protocol::do_cache_I(Mreq *request) {
             state = MESI_CACHE_IM;
 
             //Cache miss as well
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -106,7 +114,7 @@ inline void MESI_protocol::do_cache_S(Mreq *request) {
             state = MESI_CACHE_SM;
 
             //Counts as a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -126,7 +134,7 @@ inline void MESI_protocol::do_cache_E(Mreq *request) {
             state = MESI_CACHE_M;
 
             //A silent upgrade.
-            Sim->silent_upgrades++;
+            my_table->stats.silent_upgrades++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
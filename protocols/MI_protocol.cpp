@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -25,7 +25,17 @@ void MI_protocol::dump (void)
 	 * variable should be the same size and order as the state enum in the header.
 	 */
     const char *block_states[4] = {"X","I","IM","M"};
-    fprintf (stderr, "MI_protocol - state: %s\n", block_states[state]);
+    fprintf (SIM_LOG, "MI_protocol - state: %s\n", block_states[state]);
+}
+
+int MI_protocol::get_state (void)
+{
+    return state;
+}
+
+void MI_protocol::set_state (int state)
+{
+    this->state = (MI_cache_state_t)state;
 }
 
 void MI_protocol::process_cache_request (Mreq *request)
@@ -63,7 +73,7 @@ inline void MI_protocol::do_cache_I (Mreq *request)
     	 */
     	state = MI_CACHE_IM;
     	/* This is a cache miss */
-    	Sim->cache_misses++;
+    	my_table->stats.cache_misses++;
     	break;
     default:
         request->print_msg (my_table->moduleID, "ERROR");
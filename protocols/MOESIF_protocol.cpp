@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -18,7 +18,15 @@ MOESIF_protocol::~MOESIF_protocol() {
 
 void MOESIF_protocol::dump(void) {
     const char *block_states[9] = { "X", "I", "S", "E", "O", "M", "F" };
-    fprintf(stderr, "MOESIF_protocol - state: %s\n", block_states[state]);
+    fprintf(SIM_LOG, "MOESIF_protocol - state: %s\n", block_states[state]);
+}
+
+int MOESIF_protocol::get_state(void) {
+    return state;
+}
+
+void MOESIF_protocol::set_state(int state) {
+    this->state = (MOESIF_cache_state_t)state;
 }
 
 void MOESIF_protocol::process_cache_request(Mreq *request) {
@@ -96,7 +104,7 @@ inline void MOESIF_protocol::do_cache_F(Mreq *request) {
             send_GETM(request->addr);
             state = MOESIF_CACHE_FM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -110,13 +118,13 @@ inline void MOESIF_protocol::do_cache_I(Mreq *request) {
             send_GETS(request->addr);
             state = MOESIF_CACHE_ISE;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         case STORE:
             send_GETM(request->addr);
             state = MOESIF_CACHE_IM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -134,7 +142,7 @@ inline void MOESIF_protocol::do_cache_S(Mreq *request) {
             send_GETM(request->addr);
             state = MOESIF_CACHE_SM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -151,7 +159,7 @@ inline void MOESIF_protocol::do_cache_E(Mreq *request) {
             send_DATA_to_proc(request->addr);
             state = MOESIF_CACHE_M;
 
-            Sim->silent_upgrades++;
+            my_table->stats.silent_upgrades++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -168,7 +176,7 @@ inline void MOESIF_protocol::do_cache_O(Mreq *request) {
             send_GETM(request->addr);
             state = MOESIF_CACHE_OM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -18,7 +18,15 @@ MOESI_protocol::~MOESI_protocol() {
 
 void MOESI_protocol::dump(void) {
     const char *block_states[6] = { "X", "I", "S", "E", "O", "M" };
-    fprintf(stderr, "MOESI_protocol - state: %s\n", block_states[state]);
+    fprintf(SIM_LOG, "MOESI_protocol - state: %s\n", block_states[state]);
+}
+
+int MOESI_protocol::get_state(void) {
+    return state;
+}
+
+void MOESI_protocol::set_state(int state) {
+    this->state = (MOESI_cache_state_t)state;
 }
 
 void MOESI_protocol::process_cache_request(Mreq *request) {
@@ -83,13 +91,13 @@ inline void MOESI_protocol::do_cache_I(Mreq *request) {
             send_GETS(request->addr);
             state = MOESI_CACHE_ISE;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         case STORE:
             send_GETM(request->addr);
             state = MOESI_CACHE_IM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -107,7 +115,7 @@ inline void MOESI_protocol::do_cache_S(Mreq *request) {
             send_GETM(request->addr);
             state = MOESI_CACHE_SM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -124,7 +132,7 @@ inline void MOESI_protocol::do_cache_E(Mreq *request) {
             send_DATA_to_proc(request->addr);
             state = MOESI_CACHE_M;
 
-            Sim->silent_upgrades++;
+            my_table->stats.silent_upgrades++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -141,7 +149,7 @@ inline void MOESI_protocol::do_cache_O(Mreq *request) {
             send_GETM(request->addr);
             state = MOESI_CACHE_OM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -32,6 +32,8 @@ class MOESI_protocol: public Protocol
         void process_cache_request(Mreq *request);
         void process_snoop_request(Mreq *request);
         void dump(void);
+        int get_state(void);
+        void set_state(int state);
 
         inline void do_cache_I(Mreq *request);
         inline void do_cache_S(Mreq *request);
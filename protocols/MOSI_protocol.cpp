@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -18,7 +18,15 @@ MOSI_protocol::~MOSI_protocol() {
 
 void MOSI_protocol::dump(void) {
     const char *block_states[5] = { "X", "I", "S", "O", "M" };
-    fprintf(stderr, "MOSI_protocol - state: %s\n", block_states[state]);
+    fprintf(SIM_LOG, "MOSI_protocol - state: %s\n", block_states[state]);
+}
+
+int MOSI_protocol::get_state(void) {
+    return state;
+}
+
+void MOSI_protocol::set_state(int state) {
+    this->state = (MOSI_cache_state_t)state;
 }
 
 void MOSI_protocol::process_cache_request(Mreq *request) {
@@ -76,7 +84,7 @@ inline void MOSI_protocol::do_cache_I(Mreq *request) {
             state = MOSI_CACHE_IS;
 
             //also a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         case STORE:
             //Request the data with intention to modify it, so send a GETM on the bus and transition to the M state.
@@ -84,7 +92,7 @@ inline void MOSI_protocol::do_cache_I(Mreq *request) {
             state = MOSI_CACHE_IM;
 
             //also a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -104,7 +112,7 @@ inline void MOSI_protocol::do_cache_S(Mreq *request) {
             state = MOSI_CACHE_IM;
 
             //Counts as a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -122,7 +130,7 @@ inline void MOSI_protocol::do_cache_O(Mreq *request) {
             send_GETM(request->addr);
             state = MOSI_CACHE_OM;
 
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -3,7 +3,7 @@
 #include "../sim/sim.h"
 #include "../sim/hash_table.h"
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
 
 /*************************
  * Constructor/Destructor.
@@ -19,7 +19,15 @@ MSI_protocol::~MSI_protocol() {
 
 void MSI_protocol::dump(void) {
     const char *block_states[4] = { "X", "I", "S", "M" };
-    fprintf(stderr, "MSI_protocol - state: %s\n", block_states[state]);
+    fprintf(SIM_LOG, "MSI_protocol - state: %s\n", block_states[state]);
+}
+
+int MSI_protocol::get_state(void) {
+    return state;
+}
+
+void MSI_protocol::set_state(int state) {
+    this->state = (MSI_cache_state_t)state;
 }
 
 void MSI_protocol::process_cache_request(Mreq *request) {
@@ -68,7 +76,7 @@ inline void MSI_protocol::do_cache_I(Mreq *request) {
             state = MSI_CACHE_IS;
 
             //also a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         case STORE:
             //Request the data with intention to modify it, so send a GETM on the bus and transition to the M state.
@@ -76,7 +84,7 @@ inline void MSI_protocol::do_cache_I(Mreq *request) {
             state = MSI_CACHE_IM;
 
             //also a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
@@ -96,7 +104,7 @@ inline void MSI_protocol::do_cache_S(Mreq *request) {
             state = MSI_CACHE_IM;
 
             //Counts as a cache miss
-            Sim->cache_misses++;
+            my_table->stats.cache_misses++;
             break;
         default:
             request->print_msg(my_table->moduleID, "ERROR");
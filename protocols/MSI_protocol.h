@@ -23,6 +23,8 @@ public:
 	void process_cache_request(Mreq *request);
 	void process_snoop_request(Mreq *request);
 	void dump(void);
+	int get_state(void);
+	void set_state(int state);
 
 	/* Functions that specify the actions to take on requests from the processor
 	 * when the cache is in various states
@@ -24,6 +24,11 @@ typedef enum
 
     DATA,
 
+    /* A finite cache putting a dirty line it drops back in memory (see
+     * hash_table.h).  The protocols never see it.
+     */
+    WRITEBACK,
+
     MREQ_INVALID,
 	MREQ_MESSAGE_NUM	// Use this to make a Stat Array of message types
 } message_t;
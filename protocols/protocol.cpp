@@ -3,7 +3,8 @@
 #include "../sim/hash_table.h"
 #include "../sim/sim.h"
 
-extern Simulator * Sim;
+extern thread_local Simulator *Sim;
+extern thread_local Sim_settings settings;
 
 Protocol::Protocol (Hash_table *my_table, Hash_entry *my_entry)
 {
@@ -43,11 +44,12 @@ void Protocol::send_DATA_on_bus(paddr_t addr, ModuleID dest)
 	// When DATA is sent on the bus it _MUST_ have a destination module
 	new_request = new Mreq(DATA, addr, my_table->moduleID, dest);
 	/* Debug Message -- DO NOT REMOVE or you won't match the validation runs */
-	fprintf(stderr,"**** DATA_SEND Cache: %d -- Clock: %lld\n",my_table->moduleID.nodeID,Global_Clock);
+	if (settings.verbose)
+		fprintf(SIM_LOG,"**** DATA_SEND Cache: %d -- Clock: %lld\n",my_table->moduleID.nodeID,Global_Clock);
 	/* This will but the message in the bus' arbitration queue to sent */
 	this->my_table->write_to_bus(new_request);
 
-	Sim->cache_to_cache_transfers++;
+	my_table->stats.cache_to_cache_transfers++;
 }
 
 void Protocol::send_DATA_to_proc(paddr_t addr)
@@ -66,11 +68,14 @@ void Protocol::send_DATA_to_proc(paddr_t addr)
 void Protocol::set_shared_line ()
 {
 	// Set the bus' shared line
-	Sim->bus->shared_line = true;
+	if (my_table->local_only)
+		my_table->local_failed = true;
+	else
+		Sim->bus->set_shared_line(my_table->moduleID.nodeID);
 }
 
 bool Protocol::get_shared_line ()
 {
 	// Find out if the shared line is active
-	return Sim->bus->is_shared_active();
+	return Sim->bus->get_shared_line(my_table->moduleID.nodeID);
 }
@@ -35,6 +35,12 @@ public:
 	 * This function dumps the coherence state (Useful for debugging)
 	 */
     virtual void dump (void) =0;  
+    /** These virtual functions must be implemented by all children
+     * They read and overwrite the coherence state as a plain int, so the
+     * simulator can save and restore it without knowing the protocol.
+     */
+    virtual int get_state (void) =0;
+    virtual void set_state (int state) =0;
 
     /** These helper functions are provided to you to make it easier to
      * interface with the processor and bus.
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <chrono>
+
+#include "bench.h"
+#include "sim.h"
+#include "simulation.h"
+#include "trace.h"
+
+using namespace std;
+
+static double seconds_since (chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double> (chrono::steady_clock::now () - start).count ();
+}
+
+Lookup_bench::Lookup_bench (Sim_settings &base, const char *trace_dir)
+{
+    Simulation probe (base, trace_dir);
+    VECTOR<VECTOR<paddr_t> > traces;
+    paddr_t line_mask = (~(paddr_t)0) << base.cache_line_size_log2;
+    protocol_t protocol = base.protocol;
+    size_t longest = 0;
+
+    this->trace_dir = trace_dir;
+    num_nodes = probe.config.num_nodes;
+
+    Trace_source source (trace_dir, num_nodes, 0);
+
+    traces.resize (num_nodes);
+    for (int i = 0; i < num_nodes; i++)
+    {
+        Trace_reader reader (&source, 0, i);
+        paddr_t addr;
+        char op;
+
+        while (reader.next (&op, &addr))
+            traces[i].push_back (addr & line_mask);
+        longest = max (longest, traces[i].size ());
+    }
+
+    for (size_t r = 0; r < longest; r++)
+        for (int i = 0; i < num_nodes; i++)
+            if (r < traces[i].size ())
+                lines.push_back (traces[i][r]);
+
+    /** Only the entries are looked at, so any protocol will do.  */
+    if (protocol == NULL_PRO)
+        protocol = MESI_PRO;
+
+    maps.resize (num_nodes);
+    for (int i = 0; i < num_nodes; i++)
+    {
+        caches.push_back (new Hash_table ((ModuleID){i, L1_M}, "L1", base.l1_cache_size,
+                                          base.l1_cache_assoc, base.cache_line_size,
+                                          base.l1_mshrs, base.l1_hit_time, protocol));
+
+        for (size_t r = 0; r < lines.size (); r++)
+            maps[i][lines[r]] = caches[i]->get_entry (lines[r]);
+    }
+}
+
+Lookup_bench::~Lookup_bench ()
+{
+    for (unsigned int i = 0; i < caches.size (); i++)
+        delete caches[i];
+}
+
+/** Through get_entry (), as a run does.  */
+double Lookup_bench::time_table (int passes, counter_t *found)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+
+    *found = 0;
+    for (int p = 0; p < passes; p++)
+        for (size_t r = 0; r < lines.size (); r++)
+            for (int i = 0; i < num_nodes; i++)
+                *found += caches[i]->get_entry (lines[r])->tag == lines[r];
+
+    return seconds_since (start);
+}
+
+/** The way get_entry () went about it with a std::map: find, and then
+ *  look up again with [].  */
+double Lookup_bench::time_map (int passes, counter_t *found)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+    MAP<paddr_t, Hash_entry *>::iterator it;
+
+    *found = 0;
+    for (int p = 0; p < passes; p++)
+        for (size_t r = 0; r < lines.size (); r++)
+            for (int i = 0; i < num_nodes; i++)
+            {
+                it = maps[i].find (lines[r]);
+                if (it == maps[i].end ())
+                    fatal_error ("Lookup bench: line 0x%llx missing\n",
+                                 (unsigned long long)lines[r]);
+                *found += maps[i][lines[r]]->tag == lines[r];
+            }
+
+    return seconds_since (start);
+}
+
+void Lookup_bench::run (void)
+{
+    counter_t per_pass = (counter_t)lines.size () * num_nodes;
+    counter_t map_found, table_found;
+    double map_seconds, table_seconds;
+    int passes;
+
+    if (per_pass == 0)
+        fatal_error ("Lookup bench: %s has no references\n", trace_dir);
+
+    passes = max ((counter_t)1, BENCH_LOOKUPS / per_pass);
+
+    map_seconds = time_map (passes, &map_found);
+    table_seconds = time_table (passes, &table_found);
+
+    if (map_found != table_found || table_found != per_pass * passes)
+        fatal_error ("Lookup bench: the tables disagree\n");
+
+    fprintf (stdout, "\nLookups on %s: %d cores, %lld references, %lld lines per cache, "
+             "%d passes of %lld lookups\n", trace_dir, num_nodes, (long long int)lines.size (),
+             (long long int)caches[0]->my_entries.size (), passes, (long long int)per_pass);
+    fprintf (stdout, "%-12s %10s %16s\n", "Table", "Seconds", "Lookups/s");
+    fprintf (stdout, "%-12s %10.3f %16.0f\n", "std::map", map_seconds,
+             per_pass * passes / map_seconds);
+    fprintf (stdout, "%-12s %10.3f %16.0f\n", "Line_table", table_seconds,
+             per_pass * passes / table_seconds);
+    fprintf (stdout, "Speedup: %.2fx\n", map_seconds / table_seconds);
+}
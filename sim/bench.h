@@ -0,0 +1,47 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include "hash_table.h"
+#include "settings.h"
+#include "types.h"
+
+using namespace std;
+
+/** Lookups timed in all, over as many passes over the traces as that
+ *  takes.  */
+#define BENCH_LOOKUPS   20000000
+
+/**
+ * Times the lookups the caches do, on the lines of a trace directory,
+ * with the Line_table the caches keep their entries in against the
+ * std::map they kept them in before.
+ *
+ * Every cache gets an entry for every line of every trace, as the
+ * infinite caches end up with.  Then the references are played round
+ * robin over the cores, each as a lookup by its own cache and one by each
+ * of the others, as for the processor request and the snoops of a run.
+ * Both structures hold the same entries and see the same lookups.
+ */
+class Lookup_bench {
+public:
+    Lookup_bench (Sim_settings &base, const char *trace_dir);
+    ~Lookup_bench ();
+
+    /** Reports to stdout.  */
+    void run (void);
+
+private:
+    const char *trace_dir;
+    int num_nodes;
+
+    /** Line of each reference.  */
+    VECTOR<paddr_t> lines;
+
+    VECTOR<Hash_table *> caches;
+    VECTOR<MAP<paddr_t, Hash_entry *> > maps;
+
+    double time_table (int passes, counter_t *found);
+    double time_map (int passes, counter_t *found);
+};
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "branch.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Brancher::Brancher ()
+{
+    result_fd = -1;
+}
+
+Brancher::~Brancher ()
+{
+    if (result_fd >= 0)
+        close (result_fd);
+}
+
+void Brancher::branch (void)
+{
+    int n = settings.variants.size ();
+    VECTOR<Sim_result> results (n);
+    VECTOR<int> status (n, -1);
+    VECTOR<int> fds (n, -1);
+    MAP<pid_t, int> running;
+    MAP<pid_t, int>::iterator it;
+    int next = 0;
+
+    /** Anything still buffered would be written again by every child.  */
+    fflush (stdout);
+    fflush (SIM_LOG);
+
+    trace_pos.resize (settings.num_nodes);
+    for (int i = 0; i < settings.num_nodes; i++)
+        trace_pos[i] = ftell (Sim->get_PR (i)->infile);
+
+    while (next < n || !running.empty ())
+    {
+        while (next < n && (int)running.size () < settings.num_threads)
+        {
+            int pipe_fds[2];
+            pid_t pid;
+
+            if (pipe (pipe_fds) != 0)
+                fatal_error ("Branch: cannot create a pipe\n");
+
+            pid = fork ();
+            if (pid < 0)
+                fatal_error ("Branch: cannot fork variant %d\n", next);
+
+            if (pid == 0)
+            {
+                close (pipe_fds[0]);
+                for (it = running.begin (); it != running.end (); it++)
+                    close (fds[it->second]);
+
+                result_fd = pipe_fds[1];
+                start_child (next);
+                return;
+            }
+
+            close (pipe_fds[1]);
+            fds[next] = pipe_fds[0];
+            running[pid] = next++;
+        }
+
+        int wstatus;
+        pid_t pid = waitpid (-1, &wstatus, 0);
+        if (pid < 0)
+            fatal_error ("Branch: lost track of the variants\n");
+
+        it = running.find (pid);
+        if (it == running.end ())
+            continue;
+
+        /** The result is far smaller than a pipe buffer, so it is all
+         *  there by the time the child has exited.  */
+        int v = it->second;
+        if (WIFEXITED (wstatus) && WEXITSTATUS (wstatus) == 0 &&
+            read (fds[v], &results[v], sizeof (Sim_result)) == sizeof (Sim_result))
+            status[v] = 0;
+        else
+            status[v] = wstatus ? wstatus : -1;
+
+        close (fds[v]);
+        running.erase (it);
+    }
+
+    report (results, status);
+    exit (0);
+}
+
+void Brancher::start_child (int variant)
+{
+    if (!settings.apply_override (settings.variants[variant]))
+        fatal_error ("Branch: invalid variant %s\n", settings.variants[variant]);
+    Sim->apply_settings ();
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        Sim->get_PR (i)->reopen_trace (trace_pos[i]);
+
+    /** Only the parent's table is of interest.  */
+    if (freopen ("/dev/null", "w", stdout) == NULL)
+        fatal_error ("Branch: cannot discard the output of variant %d\n", variant);
+    sim_log_stream = stdout;
+}
+
+void Brancher::send_result (void)
+{
+    Sim_result result;
+
+    if (result_fd < 0)
+        return;
+
+    result = Sim->result ();
+
+    if (write (result_fd, &result, sizeof (result)) != sizeof (result))
+        fatal_error ("Branch: cannot send the result to the parent\n");
+
+    close (result_fd);
+    result_fd = -1;
+}
+
+void Brancher::report (VECTOR<Sim_result> &results, VECTOR<int> &status)
+{
+    fprintf (stdout, "\nBranched at cycle %lld into %d variants:\n",
+             (long long int)Sim->global_clock, (int)results.size ());
+    fprintf (stdout, "%-24s %10s %10s %10s %10s %10s %8s\n", "Variant",
+             "Run Time", "Misses", "Accesses", "Upgrades", "$-to-$", "Bus");
+
+    for (unsigned int i = 0; i < results.size (); i++)
+    {
+        Sim_result &r = results[i];
+
+        if (status[i] != 0)
+        {
+            fprintf (stdout, "%-24s failed (status %d)\n", settings.variants[i], status[i]);
+            continue;
+        }
+
+        fprintf (stdout, "%-24s %10lld %10ld %10ld %10ld %10ld %7.1f%%\n",
+                 settings.variants[i], (long long int)r.run_time,
+                 r.stats.cache_misses, r.stats.cache_accesses,
+                 r.stats.silent_upgrades, r.stats.cache_to_cache_transfers,
+                 r.run_time ? 100.0 * r.bus_busy_cycles / r.run_time : 0.0);
+    }
+}
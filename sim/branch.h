@@ -0,0 +1,45 @@
+#ifndef BRANCH_H_
+#define BRANCH_H_
+
+#include <sys/types.h>
+
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Runs several variants of a simulation from one warmed up state.
+ *
+ * The simulation runs once up to the branch cycle.  There the process
+ * fork ()s a child per variant, at most num_threads at a time; each child
+ * shares the warm caches with its parent copy-on-write, applies its
+ * variant's settings, and runs to completion with its output discarded.
+ * When it is done it sends its results back over a pipe, and the parent
+ * prints them all in one table.
+ */
+class Brancher {
+public:
+    Brancher ();
+    ~Brancher ();
+
+    /** Only returns in a child, with its variant applied.  */
+    void branch (void);
+
+    /** Called by the child at the end of its run.  */
+    void send_result (void);
+
+private:
+    /** Write end of the pipe to the parent, in a child.  */
+    int result_fd;
+
+    /** Where each trace was at the branch.  Children share the parent's
+     *  file offsets until they reopen the traces, so the parent cannot
+     *  tell any more once a child has run.  */
+    VECTOR<long> trace_pos;
+
+    void start_child (int variant);
+    void report (VECTOR<Sim_result> &results, VECTOR<int> &status);
+};
+
+#endif /* BRANCH_H_ */
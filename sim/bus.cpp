@@ -1,5 +1,10 @@
 #include "bus.h"
 #include "mreq.h"
+#include "sim.h"
+#include "timewarp.h"
+
+extern thread_local Simulator *Sim;
+extern thread_local Sim_settings settings;
 
 Bus::Bus()
 {
@@ -7,6 +12,10 @@ Bus::Bus()
     data_reply = NULL;
     request_in_progress = false;
     shared_line = false;
+    grant_cycle = 0;
+    busy_cycles = 0;
+    deferring = false;
+    ordered_node = -1;
 }
 
 Bus::~Bus()
@@ -25,6 +34,10 @@ void Bus::tick()
 			current_request = data_reply;
 			data_reply = NULL;
 			request_in_progress=false;
+			busy_cycles += Global_Clock - grant_cycle + 1;
+
+			if (Sim->recorder)
+				Sim->recorder->data (current_request);
 		}
 		else
 		{
@@ -33,29 +46,90 @@ void Bus::tick()
 	}
 	else if (!pending_requests.empty())
 	{
+		if (settings.jitter_seed)
+			shuffle_head ();
+
 		shared_line = false;
 	    current_request = pending_requests.front();
 	    pending_requests.pop_front();
 	    request_in_progress = true;
+	    grant_cycle = Global_Clock;
+
+	    if (Sim->recorder)
+	        Sim->recorder->grant (current_request);
+	    if (Sim->lockstep)
+	        Sim->lockstep->grant (current_request);
 	}
 	else
 	{
 		current_request = NULL;
 	}
+
+	/** The bus must run again next cycle to retire what is on it now.  */
+	if (current_request)
+		Sim->schedule (BUS_PHASE, 0, Global_Clock + 1);
+}
+
+void Bus::shuffle_head()
+{
+	LIST<Mreq *>::iterator it = pending_requests.begin();
+	timestamp_t queued = (*it)->req_time;
+	int same = 0;
+
+	while (it != pending_requests.end() && (*it)->req_time == queued)
+	{
+		it++;
+		same++;
+	}
+
+	if (same < 2)
+		return;
+
+	it = pending_requests.begin();
+	advance (it, Sim->jitter (same));
+	pending_requests.push_front (*it);
+	pending_requests.erase (it);
+}
+
+/** True if tick() would leave nothing on the bus for the caches to snoop.  */
+bool Bus::is_idle()
+{
+	if (request_in_progress)
+		return data_reply == NULL;
+	else
+		return pending_requests.empty();
 }
 
 bool Bus::bus_request(Mreq *request)
 {
+	if (tw_node)
+	{
+		tw_node->bus_request(request);
+		return true;
+	}
+
+	if (deferring)
+	{
+		deferred_requests[request->src_mid.nodeID].push_back(request);
+		return true;
+	}
+
 	if (request->msg == DATA)
 	{
-		assert (data_reply == NULL);
+		if (data_reply != NULL)
+			fatal_error ("Bus: DATA reply while another is waiting\n");
 		data_reply = request;
 	}
 	else
     {
         pending_requests.push_back(request);
+
+        if (Sim->recorder)
+            Sim->recorder->issue (request);
     }
 
+	Sim->schedule (BUS_PHASE, 0, Global_Clock + 1);
+
 	return true;
 }
 
@@ -63,6 +137,9 @@ Mreq* Bus::bus_snoop()
 {
     Mreq *request;
 
+    if (tw_node)
+        return tw_node->bus_snoop();
+
     if (current_request)
     {
         request = new Mreq ();
@@ -74,3 +151,65 @@ Mreq* Bus::bus_snoop()
         return NULL;
     }
 }
+
+void Bus::set_shared_line(int nodeID)
+{
+	if (tw_node)
+		tw_node->set_shared_line();
+	else if (deferring)
+		deferred_shared[nodeID] = true;
+	else
+		shared_line = true;
+}
+
+/** While deferring, the reader sees assertions made so far by itself and by
+ *  lower numbered nodes, just as it would have in the serial engine.  */
+bool Bus::get_shared_line(int nodeID)
+{
+	if (tw_node)
+		return tw_node->get_shared_line();
+
+	if (deferring)
+	{
+		assert (nodeID == ordered_node && "Shared line read out of node order");
+		for (int i = 0; i <= nodeID; i++)
+			if (deferred_shared[i])
+				return true;
+	}
+	return shared_line;
+}
+
+void Bus::defer(int num_nodes, int ordered_node)
+{
+	assert (!deferring);
+
+	if ((int)deferred_requests.size() < num_nodes)
+	{
+		deferred_requests.resize(num_nodes);
+		deferred_shared.resize(num_nodes);
+	}
+	deferring = true;
+	this->ordered_node = ordered_node;
+}
+
+void Bus::merge()
+{
+	assert (deferring);
+	deferring = false;
+	ordered_node = -1;
+
+	for (unsigned int i = 0; i < deferred_requests.size(); i++)
+	{
+		if (deferred_shared[i])
+		{
+			shared_line = true;
+			deferred_shared[i] = false;
+		}
+
+		while (!deferred_requests[i].empty())
+		{
+			bus_request(deferred_requests[i].front());
+			deferred_requests[i].pop_front();
+		}
+	}
+}
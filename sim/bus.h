@@ -20,11 +20,38 @@ public:
 
     bool shared_line;
 
+    /** Statistics: cycles from a grant up to and including the one its
+     *  DATA is on the bus, during which nobody else can be granted.  */
+    timestamp_t grant_cycle;
+    counter_t busy_cycles;
+
+    /** While deferring (parallel engine), bus requests and shared line
+     *  assertions are held per node and applied in node order by merge (),
+     *  which is the order the serial engine would have produced them in.
+     *  Only ordered_node may read the shared line meanwhile.  */
+    bool deferring;
+    int ordered_node;
+    VECTOR<LIST<Mreq *> > deferred_requests;
+    VECTOR<bool> deferred_shared;
+
+    /** Under the optimistic engine, caches reach the bus through their
+     *  logical process (tw_node) rather than directly.  */
+
     void tick ();
+    bool is_idle ();
+
+    /** Under jitter, put one of the requests queued in the same cycle as
+     *  the oldest, at random, at the head of the queue.  */
+    void shuffle_head ();
 
     bool is_shared_active () { return shared_line; }
+    void set_shared_line (int nodeID);
+    bool get_shared_line (int nodeID);
     bool bus_request (Mreq * request);
     Mreq *bus_snoop();
+
+    void defer (int num_nodes, int ordered_node);
+    void merge ();
 };
 
 #endif
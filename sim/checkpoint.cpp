@@ -0,0 +1,318 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "checkpoint.h"
+#include "hash_table.h"
+#include "memo.h"
+#include "memory.h"
+#include "mreq.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Checkpoint::Checkpoint ()
+{
+    file = NULL;
+    path = NULL;
+}
+
+Checkpoint::~Checkpoint ()
+{
+    if (file)
+        fclose (file);
+}
+
+/** Size and hash of the whole of a trace, leaving it where it was.  */
+static void trace_stamp (FILE *trace, uint64_t *size, uint64_t *hash)
+{
+    long offset = ftell (trace);
+    char buf[65536];
+    size_t n;
+
+    *size = 0;
+    *hash = MEMO_HASH_SEED;
+
+    rewind (trace);
+    while ((n = fread (buf, 1, sizeof (buf), trace)) > 0)
+    {
+        *hash = hash_bytes (*hash, buf, n);
+        *size += n;
+    }
+
+    if (ferror (trace) || fseek (trace, offset, SEEK_SET) != 0)
+        fatal_error ("Checkpoint: cannot read a trace\n");
+}
+
+/***************
+ * Encoding.
+ ***************/
+void Checkpoint::put (uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc ((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc ((int)value, file);
+}
+
+void Checkpoint::put_signed (int64_t value)
+{
+    put (((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void Checkpoint::put_mreq (Mreq *request)
+{
+    if (request == NULL)
+    {
+        put (0);
+        return;
+    }
+
+    put (1);
+    put (request->msg);
+    put (request->addr);
+    put_signed (request->src_mid.nodeID);
+    put (request->src_mid.module_index);
+    put_signed (request->dest_mid.nodeID);
+    put (request->dest_mid.module_index);
+    put (request->req_time);
+}
+
+void Checkpoint::put_magic (void)
+{
+    fwrite (CKPT_MAGIC, 1, sizeof (CKPT_MAGIC), file);
+}
+
+uint64_t Checkpoint::get (void)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        c = fgetc (file);
+        if (c == EOF || shift > 63)
+            fatal_error ("Checkpoint %s: truncated or corrupt\n", path);
+        value |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return value;
+}
+
+int64_t Checkpoint::get_signed (void)
+{
+    uint64_t value = get ();
+
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+Mreq *Checkpoint::get_mreq (void)
+{
+    Mreq *request;
+
+    if (!get ())
+        return NULL;
+
+    request = new Mreq ();
+    request->msg = (message_t)get ();
+    request->addr = get ();
+    request->src_mid.nodeID = get_signed ();
+    request->src_mid.module_index = (module_t)get ();
+    request->dest_mid.nodeID = get_signed ();
+    request->dest_mid.module_index = (module_t)get ();
+    request->req_time = get ();
+    return request;
+}
+
+void Checkpoint::get_magic (void)
+{
+    char magic[sizeof (CKPT_MAGIC)];
+
+    if (fread (magic, 1, sizeof (magic), file) != sizeof (magic) ||
+        memcmp (magic, CKPT_MAGIC, sizeof (magic)))
+        fatal_error ("Checkpoint %s: not a checkpoint, or truncated\n", path);
+}
+
+/***************
+ * Save/restore.
+ ***************/
+long Checkpoint::save (const char *path)
+{
+    Bus *bus = Sim->bus;
+    Memory_controller *mc = Sim->get_MC (settings.num_nodes);
+    LIST<Mreq *>::iterator it;
+    VECTOR<Hash_entry*> entries;
+    long size;
+
+    this->path = path;
+    file = fopen (path, "wb");
+    if (file == NULL)
+        fatal_error ("Checkpoint: cannot write %s\n", path);
+
+    put_magic ();
+    put (CKPT_VERSION);
+    put (settings.num_nodes);
+    put (settings.protocol);
+    put (settings.cache_line_size_log2);
+    put (settings.mem_hit_time);
+
+    put (Sim->global_clock);
+
+    put (bus->request_in_progress);
+    put (bus->shared_line);
+    put (bus->grant_cycle);
+    put (bus->busy_cycles);
+    put_mreq (bus->current_request);
+    put_mreq (bus->data_reply);
+    put (bus->pending_requests.size ());
+    for (it = bus->pending_requests.begin (); it != bus->pending_requests.end (); it++)
+        put_mreq (*it);
+
+    put (mc->request_in_progress);
+    put (mc->data_time);
+    put (mc->data_addr);
+    put_signed (mc->data_target.nodeID);
+    put (mc->data_target.module_index);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+        Hash_table *cache = Sim->get_L1 (i);
+        paddr_t line = 0;
+        uint64_t size, hash;
+
+        trace_stamp (pr->infile, &size, &hash);
+        put (size);
+        put (hash);
+        put (ftell (pr->infile));
+        put (pr->end_of_trace);
+        put (pr->outstanding_request);
+        put (pr->resume_time);
+        put_mreq (pr->inbound_request);
+        put_mreq (pr->inbound_request_buf);
+
+        put_mreq (cache->proc_request);
+        put (cache->stats.cache_misses);
+        put (cache->stats.cache_accesses);
+        put (cache->stats.silent_upgrades);
+        put (cache->stats.cache_to_cache_transfers);
+
+        cache->my_entries.sorted (entries);
+        put (entries.size ());
+        for (unsigned int j = 0; j < entries.size (); j++)
+        {
+            paddr_t next = entries[j]->tag >> settings.cache_line_size_log2;
+
+            put (next - line);
+            put (entries[j]->protocol->get_state ());
+            line = next;
+        }
+    }
+
+    put_magic ();
+
+    size = ftell (file);
+    if (fclose (file) != 0)
+        fatal_error ("Checkpoint: error writing %s\n", path);
+    file = NULL;
+
+    return size;
+}
+
+void Checkpoint::restore (const char *path)
+{
+    Bus *bus = Sim->bus;
+    Memory_controller *mc = Sim->get_MC (settings.num_nodes);
+    uint64_t version, count;
+
+    this->path = path;
+    file = fopen (path, "rb");
+    if (file == NULL)
+        fatal_error ("Checkpoint: cannot read %s\n", path);
+
+    get_magic ();
+    version = get ();
+    if (version != CKPT_VERSION)
+        fatal_error ("Checkpoint %s: version %llu, expected %d\n",
+                     path, (unsigned long long)version, CKPT_VERSION);
+
+    if ((int)get () != settings.num_nodes || (int)get () != settings.protocol ||
+        get () != settings.cache_line_size_log2 || (int)get () != settings.mem_hit_time)
+        fatal_error ("Checkpoint %s: taken with a different configuration\n", path);
+
+    Sim->global_clock = get ();
+
+    bus->request_in_progress = get ();
+    bus->shared_line = get ();
+    bus->grant_cycle = get ();
+    bus->busy_cycles = get ();
+    delete bus->current_request;
+    bus->current_request = get_mreq ();
+    delete bus->data_reply;
+    bus->data_reply = get_mreq ();
+    while (!bus->pending_requests.empty ())
+    {
+        delete bus->pending_requests.front ();
+        bus->pending_requests.pop_front ();
+    }
+    count = get ();
+    for (uint64_t n = 0; n < count; n++)
+        bus->pending_requests.push_back (get_mreq ());
+
+    mc->request_in_progress = get ();
+    mc->data_time = get ();
+    mc->data_addr = get ();
+    mc->data_target.nodeID = get_signed ();
+    mc->data_target.module_index = (module_t)get ();
+    mc->restart ();
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+        Hash_table *cache = Sim->get_L1 (i);
+        paddr_t line = 0;
+        uint64_t size, hash;
+
+        trace_stamp (pr->infile, &size, &hash);
+        if (get () != size || get () != hash)
+            fatal_error ("Checkpoint %s: trace %d is not the one it was taken on\n", path, i);
+        if (fseek (pr->infile, get (), SEEK_SET) != 0)
+            fatal_error ("Checkpoint %s: cannot seek in trace %d\n", path, i);
+        pr->end_of_trace = get ();
+        pr->outstanding_request = get ();
+        pr->resume_time = get ();
+        delete pr->inbound_request;
+        pr->inbound_request = get_mreq ();
+        delete pr->inbound_request_buf;
+        pr->inbound_request_buf = get_mreq ();
+        pr->restart ();
+
+        cache->clear ();
+        delete cache->proc_request;
+        cache->proc_request = get_mreq ();
+        cache->stats.cache_misses = get ();
+        cache->stats.cache_accesses = get ();
+        cache->stats.silent_upgrades = get ();
+        cache->stats.cache_to_cache_transfers = get ();
+
+        count = get ();
+        for (uint64_t n = 0; n < count; n++)
+        {
+            line += get ();
+            cache->get_entry (line << settings.cache_line_size_log2)->protocol->set_state (get ());
+        }
+    }
+
+    get_magic ();
+
+    fclose (file);
+    file = NULL;
+}
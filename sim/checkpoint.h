@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <stdio.h>
+
+#include "types.h"
+
+using namespace std;
+
+class Mreq;
+
+#define CKPT_MAGIC      "CSXCKPT"
+#define CKPT_VERSION    2
+
+/**
+ * Saves the complete simulator state at the start of a cycle to a file,
+ * and restores it so the run carries on from there.
+ *
+ * The file starts with a magic string and a format version, followed by
+ * the configuration it was taken with, which a restore must match.  The
+ * rest is a stream of unsigned LEB128 varints (zigzag coded where values
+ * may be negative): the clock, the bus, the memory controller, and then
+ * per node the processor, with the size and a hash of its trace, which a
+ * restore must match too, and the offset it has read it up to, and the L1
+ * cache, whose entries go in address order as deltas between successive
+ * line numbers.  A trailing magic string guards against truncation.
+ */
+class Checkpoint {
+public:
+    Checkpoint ();
+    ~Checkpoint ();
+
+    /** Returns the size of the file written.  */
+    long save (const char *path);
+    void restore (const char *path);
+
+private:
+    FILE *file;
+    const char *path;
+
+    void put (uint64_t value);
+    void put_signed (int64_t value);
+    void put_mreq (Mreq *request);
+    void put_magic (void);
+
+    uint64_t get (void);
+    int64_t get_signed (void);
+    Mreq *get_mreq (void);
+    void get_magic (void);
+};
+
+#endif /* CHECKPOINT_H_ */
@@ -0,0 +1,519 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <thread>
+
+#include "daemon.h"
+#include "settings.h"
+#include "sim.h"
+#include "simulation.h"
+
+using namespace std;
+
+static bool write_all (int fd, const char *buf, size_t size)
+{
+    while (size > 0)
+    {
+        ssize_t n = write (fd, buf, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        buf += n;
+        size -= n;
+    }
+    return true;
+}
+
+/** Writes to the log of a job go to its client as "L" frames.  */
+static ssize_t frame_write (void *cookie, const char *buf, size_t size)
+{
+    int fd = *(int *)cookie;
+    char header[32];
+    int n;
+
+    n = snprintf (header, sizeof (header), "L %zu\n", size);
+    if (!write_all (fd, header, n) || !write_all (fd, buf, size))
+        return -1;
+    return size;
+}
+
+static void send_line (int fd, const char *format, ...)
+{
+    char line[1000];
+    va_list args;
+    int n;
+
+    va_start (args, format);
+    n = vsnprintf (line, sizeof (line), format, args);
+    va_end (args);
+
+    if (n >= (int)sizeof (line))
+        n = sizeof (line) - 1;
+    write_all (fd, line, n);
+}
+
+static int unix_socket (const char *path, struct sockaddr_un *addr)
+{
+    int fd;
+
+    if (strlen (path) >= sizeof (addr->sun_path))
+        fatal_error ("Daemon: socket path too long - %s\n", path);
+
+    memset (addr, 0, sizeof (*addr));
+    addr->sun_family = AF_UNIX;
+    strcpy (addr->sun_path, path);
+
+    fd = socket (AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        fatal_error ("Daemon: cannot create a socket\n");
+    return fd;
+}
+
+Daemon::Daemon (Sim_settings &base, const char *socket_path)
+{
+    struct sockaddr_un addr;
+
+    /** Jobs run on traces decoded in memory, with no files to read.  */
+    if (!base.plain_run ())
+        fatal_error ("The daemon runs plain simulations only\n");
+    if (base.engine == OPTIMISTIC_ENGINE)
+        fatal_error ("The daemon needs a synchronous engine\n");
+
+    this->base = base;
+    this->socket_path = strdup (socket_path);
+    uses = 0;
+
+    listen_fd = unix_socket (socket_path, &addr);
+
+    /** What a daemon before this one left behind.  */
+    unlink (socket_path);
+
+    if (bind (listen_fd, (struct sockaddr *)&addr, sizeof (addr)) != 0 ||
+        listen (listen_fd, DAEMON_QUEUE) != 0)
+        fatal_error ("Daemon: cannot listen on %s\n", socket_path);
+}
+
+Daemon::~Daemon ()
+{
+    close (listen_fd);
+    unlink (socket_path);
+    free (socket_path);
+
+    for (unsigned int i = 0; i < traces.size (); i++)
+        drop_trace (traces[i]);
+}
+
+void Daemon::serve (void)
+{
+    VECTOR<thread> workers;
+
+    /** A client that goes away only ends its own job.  */
+    signal (SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < base.num_threads; i++)
+        workers.push_back (thread (&Daemon::worker_main, this));
+
+    fprintf (stdout, "Serving on %s with %d workers\n", socket_path, base.num_threads);
+    fflush (stdout);
+
+    while (true)
+    {
+        int fd = accept (listen_fd, NULL, NULL);
+
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            fatal_error ("Daemon: cannot accept on %s\n", socket_path);
+        }
+
+        unique_lock<mutex> guard (lock);
+        while (connections.size () >= DAEMON_QUEUE)
+            taken.wait (guard);
+        connections.push_back (fd);
+        queued.notify_one ();
+    }
+}
+
+void Daemon::worker_main (void)
+{
+    context.adopt ();
+
+    /** A job that fails fails alone (see handle ()).  */
+    fatal_throws = true;
+
+    while (true)
+    {
+        int fd;
+
+        {
+            unique_lock<mutex> guard (lock);
+            while (connections.empty ())
+                queued.wait (guard);
+            fd = connections.front ();
+            connections.pop_front ();
+            taken.notify_one ();
+        }
+
+        handle (fd);
+    }
+}
+
+void Daemon::handle (int fd)
+{
+    FILE *in = fdopen (dup (fd), "r");
+    Sim_settings job = base;
+    char *trace_dir = NULL;
+    char error[1000];
+
+    if (in == NULL)
+    {
+        close (fd);
+        return;
+    }
+
+    if (!read_job (in, job, &trace_dir, error, sizeof (error)))
+        send_line (fd, "E %s\n", error);
+    else
+    {
+        try
+        {
+            run_job (fd, job, trace_dir);
+        }
+        catch (Sim_error &failure)
+        {
+            /** On one line, whatever the message ends in.  */
+            snprintf (error, sizeof (error), "%s", failure.msg.c_str ());
+            error[strcspn (error, "\n")] = '\0';
+            send_line (fd, "E %s\n", error);
+        }
+    }
+
+    free (trace_dir);
+    fclose (in);
+    close (fd);
+}
+
+/** Throws a Sim_error if the job hits a fatal error, with its simulation
+ *  and traces let go of.  */
+void Daemon::run_job (int fd, Sim_settings &job, const char *trace_dir)
+{
+    Simulation simulation (job, trace_dir);
+    Cached_trace *trace = get_trace (trace_dir, simulation.config.num_nodes);
+    cookie_io_functions_t frames;
+    Sim_result result;
+
+    if (trace == NULL)
+    {
+        send_line (fd, "E %s: trace files missing\n", trace_dir);
+        return;
+    }
+
+    memset (&frames, 0, sizeof (frames));
+    frames.write = frame_write;
+
+    simulation.config.trace_source = trace->source;
+    simulation.config.trace_instance = 0;
+    simulation.log = fopencookie (&fd, "w", frames);
+
+    try
+    {
+        result = simulation.run ();
+    }
+    catch (Sim_error &failure)
+    {
+        fclose (simulation.log);
+        put_trace (trace);
+        throw;
+    }
+
+    fclose (simulation.log);
+    put_trace (trace);
+
+    send_line (fd, "R %lld %ld %ld %ld %ld %lld\n", (long long int)result.run_time,
+               result.stats.cache_misses, result.stats.cache_accesses,
+               result.stats.silent_upgrades, result.stats.cache_to_cache_transfers,
+               (long long int)result.bus_busy_cycles);
+}
+
+bool Daemon::read_job (FILE *in, Sim_settings &job, char **trace_dir, char *error, size_t size)
+{
+    char line[1000];
+    char path[1100];
+    FILE *config;
+
+    /** A job runs on one worker, and only the plain way.  */
+    job.num_threads = 1;
+    job.trace_source = NULL;
+    job.variants.clear ();
+
+    while (fgets (line, sizeof (line), in))
+    {
+        char *value = strchr (line, ' ');
+        line[strcspn (line, "\n")] = '\0';
+
+        if (!strcmp (line, "run"))
+        {
+            if (*trace_dir == NULL)
+            {
+                snprintf (error, size, "no traces given");
+                return false;
+            }
+            if (job.protocol == NULL_PRO)
+            {
+                snprintf (error, size, "no protocol given");
+                return false;
+            }
+            if (!job.plain_run ())
+            {
+                snprintf (error, size, "only plain simulations run here");
+                return false;
+            }
+
+            snprintf (path, sizeof (path), "%s/config", *trace_dir);
+            config = fopen (path, "r");
+            if (config == NULL)
+            {
+                snprintf (error, size, "%s: no config file", *trace_dir);
+                return false;
+            }
+            fclose (config);
+            return true;
+        }
+
+        if (value == NULL)
+        {
+            snprintf (error, size, "malformed line - %s", line);
+            return false;
+        }
+        *value++ = '\0';
+
+        if (!strcmp (line, "traces"))
+        {
+            free (*trace_dir);
+            *trace_dir = strdup (value);
+        }
+        else if (!strcmp (line, "protocol"))
+        {
+            if (!parse_protocol (value, &job.protocol))
+            {
+                snprintf (error, size, "invalid protocol %s", value);
+                return false;
+            }
+        }
+        else if (!strcmp (line, "engine"))
+        {
+            /** Rolling back reopens the trace files, which a job does not
+             *  read (see fanout.h).  */
+            if (!parse_engine (value, &job.engine) || job.engine == OPTIMISTIC_ENGINE)
+            {
+                snprintf (error, size, "invalid engine %s", value);
+                return false;
+            }
+        }
+        else if (!strcmp (line, "verbose"))
+            job.verbose = atoi (value) != 0;
+        else if (!strcmp (line, "override"))
+        {
+            if (!job.apply_override (value, true, true))
+            {
+                snprintf (error, size, "invalid setting %s", value);
+                return false;
+            }
+        }
+        else
+        {
+            snprintf (error, size, "unknown field %s", line);
+            return false;
+        }
+    }
+
+    snprintf (error, size, "job ends before run");
+    return false;
+}
+
+/** False if a file is missing.  */
+bool Daemon::stamp (const char *dir, int num_nodes, VECTOR<struct stat> &stamps)
+{
+    char path[1100];
+
+    stamps.resize (num_nodes + 1);
+
+    snprintf (path, sizeof (path), "%s/config", dir);
+    if (stat (path, &stamps[0]) != 0)
+        return false;
+
+    for (int i = 0; i < num_nodes; i++)
+    {
+        snprintf (path, sizeof (path), "%s/p%d.trace", dir, i);
+        if (stat (path, &stamps[i + 1]) != 0)
+            return false;
+    }
+    return true;
+}
+
+static bool same_stamps (VECTOR<struct stat> &a, VECTOR<struct stat> &b)
+{
+    if (a.size () != b.size ())
+        return false;
+
+    for (unsigned int i = 0; i < a.size (); i++)
+        if (a[i].st_ino != b[i].st_ino || a[i].st_size != b[i].st_size ||
+            a[i].st_mtim.tv_sec != b[i].st_mtim.tv_sec ||
+            a[i].st_mtim.tv_nsec != b[i].st_mtim.tv_nsec)
+            return false;
+    return true;
+}
+
+Daemon::Cached_trace *Daemon::get_trace (const char *dir, int num_nodes)
+{
+    VECTOR<struct stat> stamps;
+    Cached_trace *found = NULL;
+
+    if (!stamp (dir, num_nodes, stamps))
+        return NULL;
+
+    unique_lock<mutex> guard (lock);
+
+    for (unsigned int i = 0; i < traces.size (); i++)
+    {
+        if (strcmp (traces[i]->dir, dir))
+            continue;
+
+        if (same_stamps (traces[i]->stamps, stamps))
+            found = traces[i];
+        else
+        {
+            /** Jobs still reading the old traces finish on them.  */
+            traces[i]->stale = true;
+            if (traces[i]->users == 0)
+                drop_trace (traces[i]);
+            traces.erase (traces.begin () + i);
+        }
+        break;
+    }
+
+    if (found == NULL)
+    {
+        /** First, as it may throw.  */
+        Trace_source *source = new Trace_source (dir, num_nodes, 0);
+
+        found = new Cached_trace;
+        found->dir = strdup (dir);
+        found->source = source;
+        found->stamps = stamps;
+        found->users = 0;
+        found->stale = false;
+        traces.push_back (found);
+
+        /** Make room by dropping the least recently used that nobody reads.  */
+        while (traces.size () > DAEMON_TRACES)
+        {
+            int oldest = -1;
+
+            for (unsigned int i = 0; i < traces.size (); i++)
+                if (traces[i]->users == 0 && traces[i] != found &&
+                    (oldest < 0 || traces[i]->last_used < traces[oldest]->last_used))
+                    oldest = i;
+
+            if (oldest < 0)
+                break;
+
+            drop_trace (traces[oldest]);
+            traces.erase (traces.begin () + oldest);
+        }
+    }
+
+    found->users++;
+    found->last_used = ++uses;
+    return found;
+}
+
+void Daemon::put_trace (Cached_trace *trace)
+{
+    unique_lock<mutex> guard (lock);
+
+    trace->users--;
+    if (trace->stale && trace->users == 0)
+        drop_trace (trace);
+}
+
+void Daemon::drop_trace (Cached_trace *trace)
+{
+    delete trace->source;
+    free (trace->dir);
+    delete trace;
+}
+
+int Daemon::submit (const char *socket_path, Sim_settings &job, const char *trace_dir,
+                    VECTOR<char *> &overrides)
+{
+    struct sockaddr_un addr;
+    char line[1000];
+    char buf[4096];
+    char *dir;
+    FILE *out, *in;
+    int fd, status = 1;
+
+    line[0] = '\0';
+    fd = unix_socket (socket_path, &addr);
+    if (connect (fd, (struct sockaddr *)&addr, sizeof (addr)) != 0)
+        fatal_error ("Daemon: cannot connect to %s\n", socket_path);
+
+    /** The daemon may well run elsewhere in the file system.  */
+    dir = realpath (trace_dir, NULL);
+    if (dir == NULL)
+        fatal_error ("Error: trace file directory %s not found\n", trace_dir);
+
+    out = fdopen (dup (fd), "w");
+    fprintf (out, "traces %s\n", dir);
+    fprintf (out, "protocol %s\n", protocol_name (job.protocol));
+    fprintf (out, "engine %s\n", engine_name (job.engine));
+    fprintf (out, "verbose %d\n", job.verbose ? 1 : 0);
+    for (unsigned int i = 0; i < overrides.size (); i++)
+        fprintf (out, "override %s\n", overrides[i]);
+    fprintf (out, "run\n");
+    fclose (out);
+    free (dir);
+
+    in = fdopen (fd, "r");
+    while (fgets (line, sizeof (line), in))
+    {
+        if (line[0] == 'L')
+        {
+            size_t left = strtoul (line + 2, NULL, 10);
+
+            while (left > 0)
+            {
+                size_t n = fread (buf, 1, left < sizeof (buf) ? left : sizeof (buf), in);
+                if (n == 0)
+                    break;
+                fwrite (buf, 1, n, stderr);
+                left -= n;
+            }
+        }
+        else if (line[0] == 'R')
+        {
+            status = 0;
+            break;
+        }
+        else if (line[0] == 'E')
+        {
+            fprintf (stderr, "Daemon: %s", line + 2);
+            break;
+        }
+    }
+
+    if (status != 0 && line[0] != 'E')
+        fprintf (stderr, "Daemon: the job ended early\n");
+
+    fclose (in);
+    return status;
+}
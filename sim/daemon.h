@@ -0,0 +1,100 @@
+#ifndef DAEMON_H_
+#define DAEMON_H_
+
+#include <sys/stat.h>
+#include <condition_variable>
+#include <mutex>
+
+#include "settings.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace std;
+
+/** Trace directories kept decoded between jobs.  */
+#define DAEMON_TRACES       8
+
+/** Connections waiting for a worker before the daemon stops accepting.  */
+#define DAEMON_QUEUE        64
+
+/**
+ * Job server: runs simulations for clients that connect to a Unix domain
+ * socket, on num_threads workers.  The traces of the last DAEMON_TRACES
+ * directories it ran stay decoded in memory (see trace.h), so a job on
+ * one of them reads and parses nothing; a directory whose files have
+ * changed since is decoded afresh.
+ *
+ * A client sends a job as lines of a name and a value, and then "run":
+ *
+ *     traces /abs/path/to/traces
+ *     protocol MESI
+ *     engine event
+ *     verbose 0
+ *     override mem_hit_time=50
+ *     run
+ *
+ * Only traces is needed; the rest default to the settings the daemon was
+ * started with.  The daemon answers with frames: "L <n>" followed by n
+ * bytes of what the run logs, as it logs it, and at the end "R" with the
+ * results, or "E" with why the job was refused.  submit () is the client.
+ *
+ * A job that hits a fatal error is answered with an "E" frame with the
+ * error, and the daemon carries on: its workers set fatal_throws (see
+ * sim.h).  A job runs on one thread, the worker's, so that is the only
+ * thread its errors can come from.
+ */
+class Daemon {
+public:
+    Daemon (Sim_settings &base, const char *socket_path);
+    ~Daemon ();
+
+    /** Never returns.  */
+    void serve (void);
+
+    /** Run a job on the daemon at socket_path, with what it logs going to
+     *  stderr.  Returns the exit status for sim_trace.  */
+    static int submit (const char *socket_path, Sim_settings &job, const char *trace_dir,
+                       VECTOR<char *> &overrides);
+
+private:
+    class Cached_trace {
+    public:
+        char *dir;
+        Trace_source *source;
+
+        /** Of the config and trace files, when they were decoded.  */
+        VECTOR<struct stat> stamps;
+
+        int users;
+        unsigned long last_used;
+
+        /** Out of the cache, and deleted once nobody is using it.  */
+        bool stale;
+    };
+
+    Sim_settings base;
+    char *socket_path;
+    int listen_fd;
+
+    /** Of the thread that starts the daemon, for the workers.  */
+    Sim_context context;
+
+    mutex lock;
+    condition_variable queued;
+    condition_variable taken;
+    DEQUE<int> connections;
+
+    VECTOR<Cached_trace *> traces;
+    unsigned long uses;
+
+    void worker_main (void);
+    void handle (int fd);
+    void run_job (int fd, Sim_settings &job, const char *trace_dir);
+    bool read_job (FILE *in, Sim_settings &job, char **trace_dir, char *error, size_t size);
+    Cached_trace *get_trace (const char *dir, int num_nodes);
+    void put_trace (Cached_trace *trace);
+    void drop_trace (Cached_trace *trace);
+    static bool stamp (const char *dir, int num_nodes, VECTOR<struct stat> &stamps);
+};
+
+#endif /* DAEMON_H_ */
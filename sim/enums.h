@@ -24,6 +24,14 @@ typedef enum {
     MEM_PRO
 } protocol_t;
 
+/** Simulation kernels, selected with -e.  */
+typedef enum {
+    TICK_ENGINE = 0,
+    EVENT_ENGINE,
+    PARALLEL_ENGINE,
+    OPTIMISTIC_ENGINE
+} engine_t;
+
 typedef enum {
     TIER0 = 0,
     TIER1,
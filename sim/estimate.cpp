@@ -0,0 +1,221 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "estimate.h"
+#include "functional.h"
+#include "hash_table.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Estimator::Estimator ()
+{
+    run_time = 0;
+    bus_busy = 0;
+}
+
+Estimator::~Estimator ()
+{
+}
+
+void Estimator::functional_pass (void)
+{
+    Functional_model model;
+    VECTOR<FILE *> traces (settings.num_nodes);
+    char trace_file[100];
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        sprintf (trace_file, "%s/p%d.trace", settings.trace_dir, i);
+        traces[i] = fopen (trace_file, "r");
+        if (traces[i] == NULL)
+            fatal_error ("Estimator: cannot open %s\n", trace_file);
+    }
+
+    model.run (traces, 0);
+
+    cores.resize (settings.num_nodes);
+    stats.clear ();
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        cores[i].accesses = model.cores[i].accesses;
+        cores[i].memory_fills = model.cores[i].memory_fills;
+        cores[i].cache_fills = model.cores[i].cache_fills;
+        cores[i].upgrades = model.cores[i].upgrades;
+
+        fclose (traces[i]);
+        stats += Sim->get_L1 (i)->stats;
+        Sim->get_L1 (i)->clear ();
+    }
+}
+
+/** Approximate MVA for one customer per class at a single FCFS server with
+ *  fixed service times: a customer arriving at the bus waits for all those
+ *  queued ahead of it, and for half the service of the one being served.
+ *  Near saturation the approximation can load the bus past capacity, so
+ *  throughputs are held to the utilization bound.  */
+void Estimator::mva (VECTOR<double> &think, VECTOR<double> &service, VECTOR<double> &response)
+{
+    int n = think.size ();
+    VECTOR<double> queue (n, 0.0);
+    VECTOR<double> busy (n, 0.0);
+
+    response = service;
+
+    for (int iter = 0; iter < EST_MAX_ITERATIONS; iter++)
+    {
+        double ahead = 0.0;
+        double change = 0.0;
+
+        for (int k = 0; k < n; k++)
+            ahead += (queue[k] - busy[k] / 2) * service[k];
+
+        for (int c = 0; c < n; c++)
+            response[c] = service[c] + ahead - (queue[c] - busy[c] / 2) * service[c];
+
+        for (int c = 0; c < n; c++)
+        {
+            double throughput = 1.0 / (think[c] + response[c]);
+            double q = throughput * response[c];
+
+            change = max (change, fabs (q - queue[c]));
+            queue[c] = q;
+            busy[c] = throughput * service[c];
+        }
+
+        if (change < EST_TOLERANCE)
+            break;
+    }
+
+    double utilization = 0.0;
+    for (int c = 0; c < n; c++)
+        utilization += service[c] / (think[c] + response[c]);
+
+    if (utilization > 1.0)
+        for (int c = 0; c < n; c++)
+            response[c] = (think[c] + response[c]) * utilization - think[c];
+}
+
+/** Cores run at the rate the model gives for the set still running, up to
+ *  the next one finishing, which unloads the bus for the others.  */
+void Estimator::solve (void)
+{
+    VECTOR<double> left (settings.num_nodes, 0.0);
+    VECTOR<int> running;
+    double now = 0.0;
+
+    bus_busy = 0.0;
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Core &core = cores[i];
+
+        core.finish = 0.0;
+        core.bus_wait = 0.0;
+        bus_busy += core.memory_fills * (double)(FUNC_CACHE_FILL + settings.mem_hit_time) +
+                    core.cache_fills * (double)FUNC_CACHE_FILL;
+
+        if (core.accesses)
+        {
+            left[i] = 1.0;
+            running.push_back (i);
+        }
+    }
+
+    while (!running.empty ())
+    {
+        int n = running.size ();
+        VECTOR<double> think (n), service (n), response, visits (n), rate (n);
+        VECTOR<int> still;
+        double step = -1.0;
+        int first = 0;
+
+        /** A core without fills visits the bus once, for nothing.  */
+        for (int k = 0; k < n; k++)
+        {
+            Core &core = cores[running[k]];
+            counter_t fills = core.memory_fills + core.cache_fills;
+
+            visits[k] = fills ? fills : 1;
+            think[k] = FUNC_ACCESS_CYCLES * (double)core.accesses / visits[k];
+            service[k] = (core.memory_fills * (double)(FUNC_CACHE_FILL + settings.mem_hit_time) +
+                          core.cache_fills * (double)FUNC_CACHE_FILL) / visits[k];
+        }
+
+        mva (think, service, response);
+
+        for (int k = 0; k < n; k++)
+        {
+            rate[k] = 1.0 / (visits[k] * (think[k] + response[k]));
+            if (step < 0 || left[running[k]] / rate[k] < step)
+            {
+                step = left[running[k]] / rate[k];
+                first = k;
+            }
+        }
+
+        now += step;
+        for (int k = 0; k < n; k++)
+        {
+            int i = running[k];
+            double done = min (left[i], rate[k] * step);
+
+            cores[i].bus_wait += (response[k] - service[k]) * done * visits[k];
+            left[i] -= done;
+
+            if (k == first || left[i] < EST_TOLERANCE)
+                cores[i].finish = now;
+            else
+                still.push_back (i);
+        }
+        running = still;
+    }
+
+    /** The run ends the cycle after the last reference completes.  */
+    run_time = 0.0;
+    for (int i = 0; i < settings.num_nodes; i++)
+        run_time = max (run_time, cores[i].finish + 1);
+}
+
+void Estimator::report (bool simulated)
+{
+    double run = Sim->global_clock;
+    double busy = Sim->bus->busy_cycles;
+
+    fprintf (stdout, "\nAnalytical Estimate:\n");
+
+    if (simulated)
+    {
+        fprintf (stdout, "                      Estimate     Simulated     Error\n");
+        fprintf (stdout, "Run Time:          %11.0f   %11.0f   %+6.1f%%\n",
+                 run_time, run, 100 * (run_time - run) / run);
+        fprintf (stdout, "Bus Utilization:   %10.1f%%   %10.1f%%   %+6.1f%%\n",
+                 100 * bus_busy / run_time, 100 * busy / run,
+                 100 * (bus_busy / run_time - busy / run));
+        fprintf (stdout, "Cache Misses:      %11ld   %11ld\n",
+                 stats.cache_misses, Sim->stats.cache_misses);
+        fprintf (stdout, "$-to-$ Transfers:  %11ld   %11ld\n",
+                 stats.cache_to_cache_transfers, Sim->stats.cache_to_cache_transfers);
+    }
+    else
+    {
+        fprintf (stdout, "Run Time:          %11.0f cycles\n", run_time);
+        fprintf (stdout, "Bus Utilization:   %10.1f%%\n", 100 * bus_busy / run_time);
+        fprintf (stdout, "Cache Misses:      %11ld misses\n", stats.cache_misses);
+        fprintf (stdout, "$-to-$ Transfers:  %11ld transfers\n", stats.cache_to_cache_transfers);
+    }
+
+    fprintf (stdout, "Core   Accesses  Mem Fills    $ Fills   Upgrades   Bus Wait      Finish\n");
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Core &core = cores[i];
+        counter_t fills = core.memory_fills + core.cache_fills;
+
+        fprintf (stdout, "%4d %10ld %10ld %10ld %10ld %10.1f %11.0f\n", i,
+                 core.accesses, core.memory_fills, core.cache_fills, core.upgrades,
+                 fills ? core.bus_wait / fills : 0.0, core.finish);
+    }
+}
@@ -0,0 +1,61 @@
+#ifndef ESTIMATE_H_
+#define ESTIMATE_H_
+
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/** Bound on the fixed point iteration of the queueing model.  */
+#define EST_MAX_ITERATIONS  1000
+#define EST_TOLERANCE       1e-9
+
+/**
+ * Analytical estimate of a run, in a fraction of the time the run takes.
+ *
+ * A pass of the functional model (see functional.h) over the whole traces
+ * yields, per core, the references and the fills from memory and from other
+ * caches that the run will see.
+ *
+ * The counts then drive a closed queueing model: every core is a customer
+ * that thinks (FUNC_ACCESS_CYCLES per reference) and then holds the bus for
+ * the length of one fill, and the bus serves them first come first served.
+ * It is solved with approximate mean value analysis, taking the service
+ * times as fixed, once for every stretch of time over which the same cores
+ * are still running.
+ */
+class Estimator {
+public:
+    Estimator ();
+    ~Estimator ();
+
+    /** Leaves the caches empty again for the real run.  */
+    void functional_pass (void);
+    void solve (void);
+
+    /** Goes to stdout, next to the simulated numbers if there are any.  */
+    void report (bool simulated);
+
+    class Core {
+    public:
+        counter_t accesses;
+        counter_t memory_fills;
+        counter_t cache_fills;
+        counter_t upgrades;
+
+        /** Model results.  */
+        double finish;
+        double bus_wait;
+    };
+
+    VECTOR<Core> cores;
+    Sim_stats stats;
+
+    double run_time;
+    double bus_busy;
+
+private:
+    void mva (VECTOR<double> &think, VECTOR<double> &service, VECTOR<double> &response);
+};
+
+#endif /* ESTIMATE_H_ */
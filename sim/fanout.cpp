@@ -0,0 +1,107 @@
+#include <stdio.h>
+
+#include "fanout.h"
+#include "sim.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+static const protocol_t fanout_protocols[] = {MI_PRO, MSI_PRO, MESI_PRO, MOSI_PRO,
+                                              MOESI_PRO, MOESIF_PRO};
+
+#define FANOUT_PROTOCOLS    6
+
+Fanout::Fanout (Sim_settings &base, const char *trace_dir)
+{
+    if (!base.plain_run ())
+        fatal_error ("A fan-out runs plain simulations only\n");
+
+    /** Rollback would need the trace back from before its chunk was freed.  */
+    if (base.engine == OPTIMISTIC_ENGINE)
+        fatal_error ("A fan-out needs a synchronous engine\n");
+
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+    {
+        Sim_settings config = base;
+
+        config.protocol = fanout_protocols[i];
+        config.verbose = false;
+        config.num_threads = 1;
+        config.trace_instance = i;
+        simulations.push_back (new Simulation (config, trace_dir));
+    }
+
+    source = new Trace_source (trace_dir, simulations[0]->config.num_nodes, FANOUT_PROTOCOLS);
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        simulations[i]->config.trace_source = source;
+
+    results.resize (FANOUT_PROTOCOLS);
+}
+
+Fanout::~Fanout ()
+{
+    for (unsigned int i = 0; i < simulations.size (); i++)
+        delete simulations[i];
+    delete source;
+}
+
+void Fanout::run (void)
+{
+    VECTOR<int> instances;
+
+    /** Every simulation has to be running for the slowest to get ahead.  */
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        instances.push_back (i);
+
+    Job_pool pool (FANOUT_PROTOCOLS);
+    pool.run (instances, run_worker, this);
+
+    report ();
+}
+
+void Fanout::run_worker (int instance, void *arg)
+{
+    Fanout *fanout = (Fanout *)arg;
+
+    fanout->simulations[instance]->log = Simulation::discard ();
+    fanout->results[instance] = fanout->simulations[instance]->run ();
+    fanout->source->finish (instance);
+}
+
+void Fanout::report (void)
+{
+    fprintf (stdout, "\nFan-out of %s to %d protocols: %lld references decoded once, "
+             "in %lld chunks, %lld waits\n", simulations[0]->config.trace_dir,
+             FANOUT_PROTOCOLS, (long long int)source->references,
+             (long long int)source->chunks, (long long int)source->waits);
+
+    fprintf (stdout, "%-18s", "");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10s", protocol_name (fanout_protocols[i]));
+
+    fprintf (stdout, "\n%-18s", "Run Time");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10lld", (long long int)results[i].run_time);
+
+    fprintf (stdout, "\n%-18s", "Cache Misses");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10ld", results[i].stats.cache_misses);
+
+    fprintf (stdout, "\n%-18s", "Cache Accesses");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10ld", results[i].stats.cache_accesses);
+
+    fprintf (stdout, "\n%-18s", "Silent Upgrades");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10ld", results[i].stats.silent_upgrades);
+
+    fprintf (stdout, "\n%-18s", "$-to-$ Transfers");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %10ld", results[i].stats.cache_to_cache_transfers);
+
+    fprintf (stdout, "\n%-18s", "Bus Busy");
+    for (int i = 0; i < FANOUT_PROTOCOLS; i++)
+        fprintf (stdout, " %9.1f%%", results[i].run_time ?
+                 100.0 * results[i].bus_busy_cycles / results[i].run_time : 0.0);
+    fprintf (stdout, "\n");
+}
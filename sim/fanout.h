@@ -0,0 +1,37 @@
+#ifndef FANOUT_H_
+#define FANOUT_H_
+
+#include "settings.h"
+#include "simulation.h"
+#include "stats.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Runs one trace directory under every protocol at once, reading and
+ * decoding the traces only once, and prints the results side by side.
+ *
+ * Each protocol gets a simulation (see simulation.h) of its own, with its
+ * own bus, caches and clock, on a thread of its own.  They all read the
+ * same Trace_source, which keeps them within a few chunks of each other.
+ */
+class Fanout {
+public:
+    Fanout (Sim_settings &base, const char *trace_dir);
+    ~Fanout ();
+
+    /** Runs them all, then reports to stdout.  */
+    void run (void);
+
+private:
+    VECTOR<Simulation *> simulations;
+    VECTOR<Sim_result> results;
+    Trace_source *source;
+
+    static void run_worker (int instance, void *arg);
+    void report (void);
+};
+
+#endif /* FANOUT_H_ */
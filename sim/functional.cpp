@@ -0,0 +1,166 @@
+#include <stdio.h>
+
+#include "functional.h"
+#include "hash_table.h"
+#include "memory.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Functional_model::Functional_model ()
+{
+    cores.resize (settings.num_nodes);
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        cores[i].accesses = 0;
+        cores[i].memory_fills = 0;
+        cores[i].cache_fills = 0;
+        cores[i].upgrades = 0;
+        cores[i].clock = 0;
+    }
+
+    /** State a line starts out in, whatever the protocol calls it.  */
+    Hash_entry probe (Sim->get_L1 (0), 0);
+    invalid_state = probe.protocol->get_state ();
+
+    hook = NULL;
+}
+
+Functional_model::~Functional_model ()
+{
+}
+
+counter_t Functional_model::run (VECTOR<FILE *> &traces, counter_t limit, counter_t total)
+{
+    VECTOR<counter_t> played (settings.num_nodes, 0);
+    VECTOR<bool> active (settings.num_nodes, true);
+    bool verbose = settings.verbose;
+    counter_t count = 0;
+    char c;
+    paddr_t addr;
+
+    /** Nothing here happens at a meaningful time, so nothing is logged.  */
+    settings.verbose = false;
+
+    while (total == 0 || count < total)
+    {
+        int next = -1;
+
+        /** The core whose next reference comes first on an idle bus.  */
+        for (int i = 0; i < settings.num_nodes; i++)
+            if (active[i] && (limit == 0 || played[i] < limit) &&
+                (next < 0 || cores[i].clock < cores[next].clock))
+                next = i;
+
+        if (next < 0)
+            break;
+
+        if (fscanf (traces[next], "%c 0x%llx\n", &c, (unsigned long long int*)&addr) != 2)
+        {
+            active[next] = false;
+            continue;
+        }
+
+        if (c != 'r' && c != 'w')
+            fatal_error ("Processor %d: unknown operation - %c", next, c);
+
+        timestamp_t cycles = access (next, c, addr);
+
+        cores[next].clock += cycles;
+        if (hook)
+            hook->reference (next, c, addr, cycles > FUNC_ACCESS_CYCLES);
+        played[next]++;
+        count++;
+    }
+
+    settings.verbose = verbose;
+    Sim->bus->shared_line = false;
+
+    return count;
+}
+
+timestamp_t Functional_model::access (int node, char op, paddr_t addr)
+{
+    Processor *pr = Sim->get_PR (node);
+    Hash_table *cache = Sim->get_L1 (node);
+    Mreq request (op == 'r' ? LOAD : STORE, addr, pr->moduleID);
+    Hash_entry *entry = cache->get_entry (request.addr);
+    bool valid = entry->protocol->get_state () != invalid_state;
+    timestamp_t cycles = FUNC_ACCESS_CYCLES;
+
+    cores[node].accesses++;
+    cache->stats.cache_accesses++;
+    entry->process_request_processor (&request);
+
+    if (valid && !Sim->bus->pending_requests.empty ())
+        cores[node].upgrades++;
+
+    while (!Sim->bus->pending_requests.empty ())
+        cycles += transaction ();
+
+    /** The processor would pick this up; nobody waits for it here.  */
+    if (pr->inbound_request_buf)
+    {
+        delete pr->inbound_request_buf;
+        pr->inbound_request_buf = NULL;
+    }
+
+    return cycles;
+}
+
+/** Grant the request at the head of the bus queue, let every cache snoop
+ *  it, and deliver the DATA that answers it, from a cache or else from
+ *  memory.  Returns the cycles it would hold the bus for.  */
+timestamp_t Functional_model::transaction (void)
+{
+    Bus *bus = Sim->bus;
+    Mreq *request, *data;
+    int requester;
+    timestamp_t cycles;
+
+    request = bus->pending_requests.front ();
+    bus->pending_requests.pop_front ();
+    requester = request->src_mid.nodeID;
+
+    bus->shared_line = false;
+    bus->request_in_progress = true;
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Mreq snoop = *request;
+        Hash_entry *entry = Sim->get_L1 (i)->snoop_entry (snoop.addr);
+
+        if (entry)
+            entry->process_request_snoop (&snoop);
+    }
+
+    if (bus->data_reply)
+    {
+        data = bus->data_reply;
+        bus->data_reply = NULL;
+        cores[requester].cache_fills++;
+        cycles = FUNC_CACHE_FILL;
+    }
+    else
+    {
+        data = new Mreq (DATA, request->addr,
+                         Sim->get_MC (settings.num_nodes)->moduleID, request->src_mid);
+        cores[requester].memory_fills++;
+        cycles = FUNC_CACHE_FILL + settings.mem_hit_time;
+    }
+    bus->request_in_progress = false;
+
+    {
+        Mreq reply = *data;
+        Sim->get_L1 (reply.dest_mid.nodeID)->find_entry (reply.addr)->process_request_snoop (&reply);
+    }
+
+    delete request;
+    delete data;
+
+    return cycles;
+}
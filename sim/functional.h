@@ -0,0 +1,73 @@
+#ifndef FUNCTIONAL_H_
+#define FUNCTIONAL_H_
+
+#include <stdio.h>
+
+#include "types.h"
+
+using namespace std;
+
+/** Cycles a reference takes outside the bus: fetch, then cache lookup.  */
+#define FUNC_ACCESS_CYCLES  2
+
+/** Cycles a fill from another cache holds the bus: the grant, then DATA.
+ *  A fill from memory holds it for mem_hit_time more.  */
+#define FUNC_CACHE_FILL     2
+
+/** Sees every reference the model plays, after the caches have.  */
+class Functional_hook {
+public:
+    virtual ~Functional_hook () {}
+
+    /** bus is set if the reference went on the bus.  */
+    virtual void reference (int node, char op, paddr_t addr, bool bus) = 0;
+};
+
+/**
+ * Functional model of the memory system: plays references through the
+ * simulator's own caches and protocol state machines, without timing.
+ * Each reference is handled on the spot, and a bus request it raises is
+ * snooped and answered in the same step, with no arbitration, memory
+ * latency or logging.  The bus must be idle and the processors must have
+ * nothing outstanding whenever it runs.
+ *
+ * References are taken from the cores in the order they would be issued
+ * on an uncontended bus, by a clock per core that advances by what each
+ * reference would take on its own.
+ */
+class Functional_model {
+public:
+    Functional_model ();
+    ~Functional_model ();
+
+    class Core {
+    public:
+        counter_t accesses;
+        counter_t memory_fills;
+        counter_t cache_fills;
+        counter_t upgrades;
+        timestamp_t clock;
+    };
+
+    VECTOR<Core> cores;
+
+    /** NULL for none.  */
+    Functional_hook *hook;
+
+    /** Play up to limit references (0 for all) from each trace, and no
+     *  more than total (0 for no bound) over all of them.  The traces are
+     *  left just after the last reference played from each.  Returns the
+     *  number of references played.  */
+    counter_t run (VECTOR<FILE *> &traces, counter_t limit, counter_t total = 0);
+
+    /** Handle one reference to completion.  Returns the cycles it would
+     *  take on an idle bus.  */
+    timestamp_t access (int node, char op, paddr_t addr);
+
+private:
+    int invalid_state;
+
+    timestamp_t transaction (void);
+};
+
+#endif /* FUNCTIONAL_H_ */
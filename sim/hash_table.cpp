@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <assert.h>
 #include <iostream>
 #include <math.h>
@@ -10,6 +11,7 @@
 #include "../protocols/MOSI_protocol.h"
 #include "../protocols/MOESI_protocol.h"
 #include "../protocols/MOESIF_protocol.h"
+#include "memory.h"
 #include "settings.h"
 #include "sharers.h"
 #include "sim.h"
@@ -18,7 +20,8 @@
 
 using namespace std;
 
-extern Simulator *Sim;
+extern thread_local Simulator *Sim;
+extern thread_local Sim_settings settings;
 
 /***************************************************************************
  * Hash_entry constructor, destructor, and functions.
@@ -27,6 +30,7 @@ Hash_entry::Hash_entry (Hash_table *t, paddr_t tag)
 {
     this->my_table = t;
     this->tag = tag;
+    this->last_use = 0;
 
     switch (my_table->protocol) {
     case MI_PRO:
@@ -54,6 +58,7 @@ Hash_entry::Hash_entry (Hash_table *t, paddr_t tag)
 
 Hash_entry::~Hash_entry (void)
 {
+    delete protocol;
 }
 
 void Hash_entry::process_request_snoop (Mreq *request)
@@ -71,7 +76,7 @@ void Hash_entry::process_request_processor (Mreq *request)
 
 void Hash_entry::dump (void)
 {
-    fprintf (stderr, "Addr: 0x%llx ", (unsigned long long)tag);
+    fprintf (SIM_LOG, "Addr: 0x%llx ", (unsigned long long)tag);
     protocol->dump ();
 }
 
@@ -80,7 +85,7 @@ void Hash_entry::dump (void)
  ***************************************************************************/
 Hash_table::Hash_table (ModuleID moduleID, const char *name,
                         int size, int assoc, int blocksize, int mshrs,
-                        int hit_time, protocol_t protocol)
+                        int hit_time, protocol_t protocol, bool infinite)
 	: Module (moduleID, name)
 {
     /** Sanity check.  */
@@ -102,7 +107,17 @@ Hash_table::Hash_table (ModuleID moduleID, const char *name,
     this->mshrs = mshrs;
     this->hit_time = hit_time;
     this->protocol = protocol;
-
+    this->proc_request = NULL;
+    this->local_only = false;
+    this->local_data = false;
+    this->local_failed = false;
+    this->infinite = infinite;
+    this->uses = 0;
+    this->victim_dirty = false;
+    this->victim_addr = 0;
+
+    if (!sets || !ISPOW2 (sets))
+        fatal_error ("%s: Invalid number of sets - %d\n", name, sets);
 
     /** Calculate tag and index masks once.  */
     num_index_bits = (int) log2 (sets);
@@ -119,12 +134,26 @@ Hash_table::Hash_table (ModuleID moduleID, const char *name,
     index_mask = index_mask & ~tag_mask;
 
     my_entries.clear ();
+
+    lru_check = NULL;
+    if (!infinite)
+    {
+        set_entries.resize (sets);
+        if (settings.l1_lru_check)
+            lru_check = new Lru_check (this);
+
+        /** State a line starts out in, whatever the protocol calls it.  */
+        Hash_entry probe (this, 0);
+        invalid_state = probe.protocol->get_state ();
+    }
 }
 
 /** Destructor.  */
 Hash_table::~Hash_table (void)
 {
-
+    clear ();
+    if (lru_check)
+        delete lru_check;
 }
 
 /*****************************
@@ -138,12 +167,23 @@ void Hash_table::tick (void)
     /** Request from processor.  */
     if (proc_request)
     {
-    	fprintf(stderr,"** PROC REQUEST -- ");
-    	proc_request->print_msg (moduleID, NULL);
-    	Sim->cache_accesses++;
+    	if (settings.verbose)
+    	{
+    		fprintf(SIM_LOG,"** PROC REQUEST -- ");
+    		proc_request->print_msg (moduleID, NULL);
+    	}
+    	counter_t upgrades = stats.silent_upgrades;
+
+    	stats.cache_accesses++;
+        victim_dirty = false;
         entry = get_entry (proc_request->addr);
         assert (entry);
+        if (victim_dirty)
+            write_back (victim_addr);
         entry->process_request_processor (proc_request);
+
+        if (Sim->recorder && stats.silent_upgrades != upgrades)
+            Sim->recorder->upgrade (moduleID.nodeID, proc_request->addr);
         delete proc_request;
         proc_request = NULL;
     }
@@ -154,14 +194,30 @@ void Hash_table::tick (void)
     {
     	if (request->msg == DATA && request->dest_mid != this->moduleID)
     	{
+    		delete request;
     		return;
     	}
 
-    	fprintf(stderr,"*** SNOOP REQUEST -- ");
-        request->print_msg (moduleID, NULL);
-        entry = get_entry (request->addr);
-        assert (entry);
-        entry->process_request_snoop (request);
+    	if (settings.verbose)
+    	{
+    		fprintf(SIM_LOG,"*** SNOOP REQUEST -- ");
+    		request->print_msg (moduleID, NULL);
+    	}
+
+    	/** Only the writer has anything to do with a writeback: send the
+    	 *  data now that it has the bus.  */
+    	if (request->msg == WRITEBACK)
+    	{
+    		if (request->src_mid == this->moduleID)
+    			write_to_bus (new Mreq (DATA, request->addr, moduleID, request->dest_mid));
+    		delete request;
+    		return;
+    	}
+
+        entry = snoop_entry (request->addr);
+        if (entry)
+            entry->process_request_snoop (request);
+        delete request;
     }
 }
 
@@ -170,6 +226,48 @@ void Hash_table::processor_request (Mreq *request)
 {
     assert (proc_request == NULL);
     proc_request = request;
+    Sim->schedule (CACHE_PHASE, moduleID.nodeID, Global_Clock + 1);
+}
+
+/** Handle a processor request on the spot, for the hit fast path.  This
+ *  only succeeds if the protocol answers it without the bus (or the shared
+ *  line); otherwise the line and the counters are left as they were and
+ *  the request must go the normal way.  */
+bool Hash_table::retire_hit (Mreq *request)
+{
+    Hash_entry *entry;
+    Sim_stats saved_stats;
+    int saved_state;
+
+    entry = find_entry (request->addr);
+    if (entry == NULL)
+        return false;
+
+    saved_stats = stats;
+    saved_state = entry->protocol->get_state ();
+
+    local_only = true;
+    local_data = false;
+    local_failed = false;
+
+    stats.cache_accesses++;
+    entry->process_request_processor (request);
+
+    local_only = false;
+
+    if (local_failed || !local_data)
+    {
+        entry->protocol->set_state (saved_state);
+        stats = saved_stats;
+        return false;
+    }
+
+    if (Sim->recorder && stats.silent_upgrades != saved_stats.silent_upgrades)
+        Sim->recorder->upgrade (moduleID.nodeID, request->addr);
+    entry->last_use = ++uses;
+    if (lru_check)
+        lru_check->use (request->addr);
+    return true;
 }
 
 void Hash_table::tock (void)
@@ -182,14 +280,134 @@ void Hash_table::tock (void)
  *******************************/
 Hash_entry* Hash_table::get_entry (paddr_t addr)
 {
-    MAP<paddr_t, Hash_entry*>::iterator it;
-    
-    it = my_entries.find (addr);
-    if (it == my_entries.end ())
+    Hash_entry *entry;
+
+    entry = my_entries.find (addr);
+    if (entry == NULL)
     {
-        my_entries.insert(pair<paddr_t, Hash_entry*>(addr,new Hash_entry (this, addr)));       
+        entry = new Hash_entry (this, addr);
+        if (!infinite)
+            place (entry);
+        my_entries.insert (addr, entry);
     }
-    return my_entries[addr];
+    else if (lru_check)
+        lru_check->use (addr);
+
+    entry->last_use = ++uses;
+    return entry;
+}
+
+/** Like get_entry, but returns NULL instead of allocating a missing entry.  */
+Hash_entry* Hash_table::find_entry (paddr_t addr)
+{
+    return my_entries.find (addr);
+}
+
+/** The entry a snoop is for: NULL if a finite cache does not hold the
+ *  line.  */
+Hash_entry* Hash_table::snoop_entry (paddr_t addr)
+{
+    return infinite ? get_entry (addr) : find_entry (addr);
+}
+
+void Hash_table::remove_entry (paddr_t addr)
+{
+    Hash_entry *entry;
+
+    entry = my_entries.erase (addr);
+    assert (entry);
+
+    if (!infinite)
+    {
+        VECTOR<Hash_entry*> &set = set_entries[(addr & index_mask) >> num_offset_bits];
+        set.erase (find (set.begin (), set.end (), entry));
+        if (lru_check)
+            lru_check->remove (addr);
+    }
+
+    delete entry;
+}
+
+/** Put a new entry in its set of a finite cache, dropping a line that is
+ *  no longer valid if the set is full, or else the least recently used.  */
+void Hash_table::place (Hash_entry *entry)
+{
+    VECTOR<Hash_entry*> &set = set_entries[(entry->tag & index_mask) >> num_offset_bits];
+
+    if ((int)set.size () >= assoc)
+    {
+        int victim = 0;
+
+        for (unsigned int i = 0; i < set.size (); i++)
+        {
+            if (set[i]->protocol->get_state () == invalid_state)
+            {
+                victim = i;
+                break;
+            }
+            if (set[i]->last_use < set[victim]->last_use)
+                victim = i;
+        }
+
+        if (dirty (set[victim]->protocol->get_state ()))
+        {
+            victim_dirty = true;
+            victim_addr = set[victim]->tag;
+            stats.writebacks++;
+        }
+
+        if (lru_check)
+            lru_check->evict (set[victim]->tag);
+
+        my_entries.erase (set[victim]->tag);
+        delete set[victim];
+        set.erase (set.begin () + victim);
+    }
+
+    set.push_back (entry);
+    if (lru_check)
+        lru_check->place (entry->tag);
+}
+
+/** Whether a line in state has data memory does not: M or O.  F is
+ *  clean, as MOESIF only enters it from E.  place () only ever drops
+ *  stable states, as the line of the one request in flight is the one
+ *  being placed.  */
+bool Hash_table::dirty (int state)
+{
+    switch (protocol) {
+    case MI_PRO:     return state == MI_CACHE_M;
+    case MSI_PRO:    return state == MSI_CACHE_M;
+    case MESI_PRO:   return state == MESI_CACHE_M;
+    case MOSI_PRO:   return state == MOSI_CACHE_M || state == MOSI_CACHE_O;
+    case MOESI_PRO:  return state == MOESI_CACHE_M || state == MOESI_CACHE_O;
+    case MOESIF_PRO: return state == MOESIF_CACHE_M || state == MOESIF_CACHE_O;
+    default:         return false;
+    }
+}
+
+/** Put a dirty line place () dropped back in memory: a WRITEBACK now, and
+ *  its DATA when the bus grants it (see tick ()).  */
+void Hash_table::write_back (paddr_t addr)
+{
+    if (settings.verbose)
+        fprintf (SIM_LOG, "**** WRITEBACK Cache: %d -- Clock: %lld\n", moduleID.nodeID,
+                 (long long int)Global_Clock);
+
+    write_to_bus (new Mreq (WRITEBACK, addr, moduleID, Sim->get_MC (settings.num_nodes)->moduleID));
+}
+
+/** Drop every entry and counter, as if the cache had just been built.  */
+void Hash_table::clear (void)
+{
+    my_entries.for_each ([] (Hash_entry *entry) { delete entry; });
+    my_entries.clear ();
+    for (unsigned int i = 0; i < set_entries.size (); i++)
+        set_entries[i].clear ();
+    if (lru_check)
+        lru_check->clear ();
+    uses = 0;
+    stats.clear ();
 }
 
 bool Hash_table::write_to_proc (Mreq *mreq)
@@ -197,9 +415,18 @@ bool Hash_table::write_to_proc (Mreq *mreq)
 	Processor * pr = (Processor*)Sim->get_PR(moduleID.nodeID);
 	mreq->src_mid = moduleID;
 
-	assert (!pr->inbound_request_buf);
+	if (local_only)
+	{
+		local_data = true;
+		delete mreq;
+		return true;
+	}
+
+	if (pr->inbound_request_buf)
+		fatal_error ("%s: DATA for a processor that is not waiting\n", name);
 
 	pr->inbound_request_buf = mreq;
+	Sim->schedule (TOCK_PHASE, moduleID.nodeID, Global_Clock);
 
 	return true;
 }
@@ -207,6 +434,14 @@ bool Hash_table::write_to_proc (Mreq *mreq)
 bool Hash_table::write_to_bus (Mreq *mreq)
 {
 	mreq->src_mid = moduleID;
+
+	if (local_only)
+	{
+		local_failed = true;
+		delete mreq;
+		return true;
+	}
+
 	return this->write_output_port(mreq);
 }
 
@@ -217,27 +452,28 @@ void Hash_table::dump_hash_entry (paddr_t addr)
 {
     Hash_entry *entry;
 
-    entry = get_entry (addr);
+    entry = find_entry (addr);
     if (entry)
         entry->dump ();
 }
 
 void Hash_table::dump_hash_table ()
 {
-	MAP<paddr_t, Hash_entry*>::iterator it;
+	VECTOR<Hash_entry*> entries;
 
-	fprintf(stderr, "Cache %d Contents:\n",moduleID.nodeID);
+	fprintf(SIM_LOG, "Cache %d Contents:\n",moduleID.nodeID);
 
-	for (it = my_entries.begin(); it != my_entries.end(); it++)
+	my_entries.sorted (entries);
+	for (unsigned int i = 0; i < entries.size (); i++)
 	{
-		it->second->dump();
+		entries[i]->dump();
 	}
 
 }
 
 void Hash_table::print_config (void)
 {
-    fprintf (stderr, "%s CONFIGURATION\n", name);
-    fprintf (stderr, " blocksize:         %d bytes\n", blocksize);
+    fprintf (SIM_LOG, "%s CONFIGURATION\n", name);
+    fprintf (SIM_LOG, " blocksize:         %d bytes\n", blocksize);
 }
 
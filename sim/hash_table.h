@@ -3,9 +3,12 @@
 
 #include <iostream>
 
+#include "line_table.h"
+#include "lru_check.h"
 #include "module.h"
 #include "mreq.h"
 #include "settings.h"
+#include "stats.h"
 #include "types.h"
 #include "../protocols/protocol.h"
 
@@ -22,6 +25,9 @@ public:
 
     Protocol *protocol;
 
+    /** When the processor last touched the line, in a finite cache.  */
+    counter_t last_use;
+
     void process_request_snoop (Mreq *request);
     void process_request_processor (Mreq *request);
 
@@ -48,27 +54,67 @@ public:
 
     Mreq *proc_request;
 
-    /** Table divided into sets which house the individual entries, indexed with index bits.  */
-    MAP<paddr_t, Hash_entry*> my_entries;
+    /** Set while retire_hit () runs the protocol: the request must be
+     *  answered from the cache alone, and anything else aborts it.  */
+    bool local_only;
+    bool local_data;
+    bool local_failed;
+
+    /** Events counted by this cache and its protocol entries.  */
+    Sim_stats stats;
+
+    /** Every line the cache holds an entry for, by address.  */
+    Line_table my_entries;
     Hash_entry* null_entry;
 
-    /** Internal helper functions.  */
+    /** Unless infinite, a set holds at most assoc lines, listed here by
+     *  set index, and a line the processor brings in takes the place of
+     *  one that is no longer valid, or else of the least recently used.
+     *  The other caches are not told, and memory supplies the line next
+     *  time.  A dirty line is written back first: the cache puts a
+     *  WRITEBACK for memory on the bus, and the DATA once it is granted,
+     *  so it holds the bus as long as a transfer from another cache does.
+     *  A snoop never brings a line in, as no protocol acts on one in I.  */
+    bool infinite;
+    VECTOR<VECTOR<Hash_entry*> > set_entries;
+    counter_t uses;
+    int invalid_state;
+
+    /** Set by place () when the line it drops is dirty.  */
+    bool victim_dirty;
+    paddr_t victim_addr;
+
+    /** With l1_lru_check, checks every use and placement of a finite
+     *  cache against a brute force LRU; NULL otherwise.  */
+    Lru_check *lru_check;
+
+    /** Internal helper functions.  get_entry is for the processor's
+     *  accesses, and marks the line most recently used.  */
     Hash_entry* get_entry (paddr_t addr);
+    Hash_entry* find_entry (paddr_t addr);
+    Hash_entry* snoop_entry (paddr_t addr);
+    void remove_entry (paddr_t addr);
+    void place (Hash_entry *entry);
+    bool dirty (int state);
+    void write_back (paddr_t addr);
+    void clear (void);
 
 public:
     Hash_table (ModuleID moduleID, const char *name,
                 int size, int assoc, int blocksize, int mshrs,
-                int hit_time, protocol_t protocol);
+                int hit_time, protocol_t protocol, bool infinite = true);
                 
     ~Hash_table (void);
 
     void processor_request (Mreq *request);
+    bool retire_hit (Mreq *request);
 
     bool write_to_proc (Mreq *mreq);
     bool write_to_bus (Mreq *mreq);
 
     void tick (void);
     void tock (void);
+    bool is_idle (void) { return proc_request == NULL; }
 
     /** Debug.  */
     void print_config (void);
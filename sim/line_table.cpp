@@ -0,0 +1,104 @@
+#include <algorithm>
+
+#include "hash_table.h"
+#include "line_table.h"
+
+using namespace std;
+
+Line_table::Line_table ()
+{
+    count = 0;
+    resize (LINE_TABLE_SLOTS);
+}
+
+Line_table::~Line_table ()
+{
+}
+
+/** Empty the table into size slots.  */
+void Line_table::resize (size_t size)
+{
+    slots.assign (size, Slot ());
+    for (size_t i = 0; i < size; i++)
+        slots[i].entry = NULL;
+
+    mask = size - 1;
+    shift = 64;
+    for (size_t n = size; n > 1; n >>= 1)
+        shift--;
+}
+
+void Line_table::insert (paddr_t addr, Hash_entry *entry)
+{
+    size_t i;
+
+    if (count + 1 > LINE_TABLE_LOAD * slots.size ())
+    {
+        VECTOR<Slot> old;
+
+        old.swap (slots);
+        resize (old.size () * 2);
+        for (size_t j = 0; j < old.size (); j++)
+            if (old[j].entry)
+            {
+                for (i = home (old[j].addr); slots[i].entry; i = (i + 1) & mask)
+                    ;
+                slots[i] = old[j];
+            }
+    }
+
+    for (i = home (addr); slots[i].entry; i = (i + 1) & mask)
+        ;
+    slots[i].addr = addr;
+    slots[i].entry = entry;
+    count++;
+}
+
+Hash_entry *Line_table::erase (paddr_t addr)
+{
+    Hash_entry *entry;
+    size_t i, j;
+
+    for (i = home (addr); slots[i].entry; i = (i + 1) & mask)
+        if (slots[i].addr == addr)
+            break;
+
+    entry = slots[i].entry;
+    if (entry == NULL)
+        return NULL;
+
+    /** Shift back whatever after it in the run could live in the hole: an
+     *  entry whose home is not between the hole and where it is now.  */
+    for (j = (i + 1) & mask; slots[j].entry; j = (j + 1) & mask)
+    {
+        size_t k = home (slots[j].addr);
+
+        if ((j > i && (k <= i || k > j)) || (j < i && k <= i && k > j))
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+
+    slots[i].entry = NULL;
+    count--;
+    return entry;
+}
+
+void Line_table::clear (void)
+{
+    for (size_t i = 0; i < slots.size (); i++)
+        slots[i].entry = NULL;
+    count = 0;
+}
+
+void Line_table::sorted (VECTOR<Hash_entry *> &entries)
+{
+    entries.clear ();
+    for (size_t i = 0; i < slots.size (); i++)
+        if (slots[i].entry)
+            entries.push_back (slots[i].entry);
+
+    sort (entries.begin (), entries.end (),
+          [] (Hash_entry *a, Hash_entry *b) { return a->tag < b->tag; });
+}
@@ -0,0 +1,89 @@
+#ifndef LINE_TABLE_H_
+#define LINE_TABLE_H_
+
+#include <stdint.h>
+
+#include "types.h"
+
+using namespace std;
+
+class Hash_entry;
+
+/** Slots a table starts out with, and the most it fills before it doubles,
+ *  as a fraction of them.  */
+#define LINE_TABLE_SLOTS    64
+#define LINE_TABLE_LOAD     0.5
+
+/**
+ * The entries of a cache by line address, in one flat array of slots:
+ * open addressing, with linear probing from the slot a Fibonacci hash of
+ * the address picks.  A slot holds the address next to the entry, so a
+ * lookup reads nothing but the array until it has its entry, and most
+ * find it in the first slot they read.  Taking an entry out shifts the
+ * rest of its run back, so there are no tombstones and a miss stops at
+ * the first empty slot.
+ *
+ * The entries themselves stay where they were allocated, as the protocols
+ * keep pointers to theirs.  Slots are in no particular order: a walk that
+ * has to come out the same whatever order the lines came in (a digest, a
+ * checkpoint, a dump) takes them sorted (), and any other goes through
+ * for_each (), which skips the sort.
+ */
+class Line_table {
+public:
+    Line_table ();
+    ~Line_table ();
+
+    /** NULL if the address is not there.  */
+    Hash_entry *find (paddr_t addr)
+    {
+        for (size_t i = home (addr); slots[i].entry; i = (i + 1) & mask)
+            if (slots[i].addr == addr)
+                return slots[i].entry;
+        return NULL;
+    }
+
+    /** For an address that is not there yet.  */
+    void insert (paddr_t addr, Hash_entry *entry);
+
+    /** Returns the entry taken out, or NULL if the address was not there.  */
+    Hash_entry *erase (paddr_t addr);
+
+    void clear (void);
+    size_t size (void) { return count; }
+
+    /** Every entry, by address.  */
+    void sorted (VECTOR<Hash_entry *> &entries);
+
+    /** Calls visit on every entry, in slot order.  visit must not insert
+     *  or erase.  */
+    template <class Visit> void for_each (Visit visit)
+    {
+        for (size_t i = 0; i < slots.size (); i++)
+            if (slots[i].entry)
+                visit (slots[i].entry);
+    }
+
+private:
+    class Slot {
+    public:
+        paddr_t addr;
+
+        /** NULL for an empty slot.  */
+        Hash_entry *entry;
+    };
+
+    VECTOR<Slot> slots;
+    size_t mask;
+    int shift;
+    size_t count;
+
+    size_t home (paddr_t addr)
+    {
+        return (size_t)(((uint64_t)addr * 0x9e3779b97f4a7c15ULL) >> shift);
+    }
+
+    void resize (size_t size);
+};
+
+#endif /* LINE_TABLE_H_ */
@@ -0,0 +1,356 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "hash_table.h"
+#include "lockstep.h"
+#include "mreq.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+static inline uint64_t digest_mix (uint64_t h, uint64_t v)
+{
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    return (h ^ v) * 0x100000001b3ULL;
+}
+
+static bool same_stats (Sim_stats &a, Sim_stats &b)
+{
+    return (a.cache_misses == b.cache_misses && a.cache_accesses == b.cache_accesses &&
+            a.silent_upgrades == b.silent_upgrades &&
+            a.cache_to_cache_transfers == b.cache_to_cache_transfers &&
+            a.writebacks == b.writebacks);
+}
+
+Lockstep::Lockstep ()
+{
+    reference = true;
+    alternate = TICK_ENGINE;
+    observations = 0;
+    child = -1;
+    read_fd = -1;
+    write_fd = -1;
+    per_grant = true;
+}
+
+Lockstep::~Lockstep ()
+{
+    if (read_fd >= 0)
+        close (read_fd);
+    if (write_fd >= 0)
+        close (write_fd);
+}
+
+void Lockstep::start (engine_t alternate)
+{
+    int down[2], up[2];
+
+    this->alternate = alternate;
+    per_grant = (alternate != OPTIMISTIC_ENGINE);
+
+    if (pipe (down) != 0 || pipe (up) != 0)
+        fatal_error ("Lockstep: cannot create a pipe\n");
+
+    /** Anything still buffered would be written again by the child.  */
+    fflush (stdout);
+    fflush (SIM_LOG);
+
+    child = fork ();
+    if (child < 0)
+        fatal_error ("Lockstep: cannot fork the %s engine\n", engine_name (alternate));
+
+    if (child == 0)
+    {
+        reference = false;
+        read_fd = down[0];
+        write_fd = up[1];
+        close (down[1]);
+        close (up[0]);
+        settings.engine = alternate;
+
+        /** Only the parent's output is of interest, until a divergence.  */
+        if (freopen ("/dev/null", "w", stdout) == NULL)
+            fatal_error ("Lockstep: cannot discard the output of the %s engine\n",
+                         engine_name (alternate));
+        sim_log_stream = stdout;
+    }
+    else
+    {
+        read_fd = up[0];
+        write_fd = down[1];
+        close (down[0]);
+        close (up[1]);
+        settings.engine = TICK_ENGINE;
+    }
+
+    /** The processors were built before the engine was settled on, and
+     *  share their trace offsets with the other process.  */
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+
+        pr->reopen_trace (0);
+        pr->fast_hits = !settings.verbose && settings.engine != OPTIMISTIC_ENGINE;
+    }
+}
+
+void Lockstep::observe (Observation &observation, int kind, Mreq *request)
+{
+    uint64_t h = 0;
+
+    observation = Observation ();
+    observation.kind = kind;
+    observation.cycle = Global_Clock;
+    observation.node = request ? request->src_mid.nodeID : -1;
+    observation.msg = request ? request->msg : NOP;
+    observation.addr = request ? request->addr : 0;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Hash_table *cache = Sim->get_L1 (i);
+        VECTOR<Hash_entry*> entries;
+
+        observation.stats += cache->stats;
+
+        cache->my_entries.sorted (entries);
+        h = digest_mix (h, entries.size ());
+        for (unsigned int j = 0; j < entries.size (); j++)
+        {
+            h = digest_mix (h, entries[j]->tag);
+            h = digest_mix (h, entries[j]->protocol->get_state ());
+        }
+    }
+    observation.digest = h;
+    observations++;
+}
+
+void Lockstep::grant (Mreq *request)
+{
+    Observation mine;
+
+    if (!per_grant)
+        return;
+
+    observe (mine, OBSERVE_GRANT, request);
+    exchange (mine);
+}
+
+void Lockstep::finish (void)
+{
+    Observation mine;
+    int status;
+
+    observe (mine, OBSERVE_END, NULL);
+    exchange (mine);
+
+    if (!reference)
+        exit (0);
+
+    if (waitpid (child, &status, 0) != child || !WIFEXITED (status) || WEXITSTATUS (status) != 0)
+        fatal_error ("Lockstep: the %s engine did not finish cleanly\n",
+                     engine_name (alternate));
+}
+
+/** The child sends its observation and waits to be let on; the parent
+ *  checks it against its own.  */
+void Lockstep::exchange (Observation &mine)
+{
+    Observation theirs;
+    char reply;
+
+    if (!reference)
+    {
+        send (&mine, sizeof (mine));
+        if (!receive (&reply, 1))
+            exit (1);
+        if (reply == 'd')
+            serve_dump ();
+        return;
+    }
+
+    if (!receive (&theirs, sizeof (theirs)))
+        diverged (mine, NULL);
+
+    if (theirs.kind != mine.kind || theirs.cycle != mine.cycle ||
+        theirs.node != mine.node || theirs.msg != mine.msg || theirs.addr != mine.addr ||
+        !same_stats (theirs.stats, mine.stats) || theirs.digest != mine.digest)
+        diverged (mine, &theirs);
+
+    reply = 'c';
+    send (&reply, 1);
+}
+
+void Lockstep::diverged (Observation &mine, Observation *theirs)
+{
+    VECTOR<Line_state> ours, others, differ;
+    unsigned int a = 0, b = 0;
+    char reply = 'd';
+    long count;
+
+    fprintf (stderr, "\nLockstep: the %s engine diverges from the tick engine at cycle %lld, "
+             "observation %lld\n", engine_name (alternate), (long long int)mine.cycle,
+             (long long int)observations);
+
+    Observation *both[2] = {&mine, theirs};
+    for (int i = 0; i < 2; i++)
+    {
+        Observation *o = both[i];
+
+        if (o == NULL)
+        {
+            fprintf (stderr, "  %-10s: stopped without a word\n", engine_name (alternate));
+            continue;
+        }
+
+        fprintf (stderr, "  %-10s: ", i ? engine_name (alternate) : "tick");
+        if (o->kind == OBSERVE_END)
+            fprintf (stderr, "end of run at cycle %lld", (long long int)o->cycle);
+        else
+            fprintf (stderr, "cycle %lld grant %s 0x%llx from node %d", (long long int)o->cycle,
+                     Mreq::message_t_str[o->msg], (unsigned long long int)o->addr, o->node);
+        fprintf (stderr, ", misses %ld accesses %ld upgrades %ld $-to-$ %ld, lines %016llx\n",
+                 o->stats.cache_misses, o->stats.cache_accesses, o->stats.silent_upgrades,
+                 o->stats.cache_to_cache_transfers, (unsigned long long int)o->digest);
+    }
+
+    if (theirs == NULL)
+        exit (1);
+
+    send (&reply, 1);
+    if (!receive (&count, sizeof (count)))
+        exit (1);
+    others.resize (count);
+    if (count && !receive (&others[0], count * sizeof (Line_state)))
+        exit (1);
+    get_states (ours);
+
+    /** Both lists are in node, then address order.  */
+    while ((a < ours.size () || b < others.size ()) && differ.size () < LOCKSTEP_MAX_DUMPS)
+    {
+        Line_state *x = a < ours.size () ? &ours[a] : NULL;
+        Line_state *y = b < others.size () ? &others[b] : NULL;
+
+        if (x && y && x->node == y->node && x->addr == y->addr)
+        {
+            if (x->state != y->state)
+                differ.push_back (*x);
+            a++;
+            b++;
+        }
+        else if (x && (!y || x->node < y->node || (x->node == y->node && x->addr < y->addr)))
+            differ.push_back (ours[a++]);
+        else
+            differ.push_back (others[b++]);
+    }
+
+    fprintf (SIM_LOG, "Lines that differ, tick engine:\n");
+    for (unsigned int i = 0; i < differ.size (); i++)
+    {
+        fprintf (SIM_LOG, "  Node %d: ", differ[i].node);
+        Sim->dump_cache_block (differ[i].node, differ[i].addr);
+    }
+    fflush (SIM_LOG);
+
+    count = differ.size ();
+    send (&count, sizeof (count));
+    if (count)
+        send (&differ[0], count * sizeof (Line_state));
+    waitpid (child, NULL, 0);
+
+    exit (1);
+}
+
+/** In the child, at the parent's request: the line states for the parent
+ *  to compare, then a dump of the lines it found to differ.  */
+void Lockstep::serve_dump (void)
+{
+    VECTOR<Line_state> states;
+    long count;
+
+    get_states (states);
+    count = states.size ();
+    send (&count, sizeof (count));
+    if (count)
+        send (&states[0], count * sizeof (Line_state));
+
+    if (!receive (&count, sizeof (count)))
+        exit (1);
+    states.resize (count);
+    if (count && !receive (&states[0], count * sizeof (Line_state)))
+        exit (1);
+
+    sim_log_stream = NULL;
+    fprintf (SIM_LOG, "Lines that differ, %s engine:\n", engine_name (alternate));
+    for (unsigned int i = 0; i < states.size (); i++)
+    {
+        fprintf (SIM_LOG, "  Node %d: ", states[i].node);
+        Sim->dump_cache_block (states[i].node, states[i].addr);
+    }
+    fflush (SIM_LOG);
+
+    exit (0);
+}
+
+void Lockstep::get_states (VECTOR<Line_state> &states)
+{
+    states.clear ();
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        VECTOR<Hash_entry*> entries;
+
+        Sim->get_L1 (i)->my_entries.sorted (entries);
+        for (unsigned int j = 0; j < entries.size (); j++)
+        {
+            Line_state line;
+
+            line.node = i;
+            line.addr = entries[j]->tag;
+            line.state = entries[j]->protocol->get_state ();
+            states.push_back (line);
+        }
+    }
+}
+
+void Lockstep::send (const void *buf, size_t size)
+{
+    const char *p = (const char *)buf;
+
+    while (size > 0)
+    {
+        ssize_t n = write (write_fd, p, size);
+        if (n <= 0)
+            exit (1);
+        p += n;
+        size -= n;
+    }
+}
+
+bool Lockstep::receive (void *buf, size_t size)
+{
+    char *p = (char *)buf;
+
+    while (size > 0)
+    {
+        ssize_t n = read (read_fd, p, size);
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= n;
+    }
+    return true;
+}
+
+void Lockstep::report (void)
+{
+    fprintf (stdout, "Lockstep: %lld observations of the %s engine agree with the tick engine\n",
+             (long long int)observations, engine_name (alternate));
+}
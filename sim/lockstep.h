@@ -0,0 +1,97 @@
+#ifndef LOCKSTEP_H_
+#define LOCKSTEP_H_
+
+#include <sys/types.h>
+
+#include "enums.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+class Mreq;
+
+/** Most differing lines dumped at a divergence.  */
+#define LOCKSTEP_MAX_DUMPS  16
+
+/**
+ * Runs an alternate engine side by side with the tick engine and stops at
+ * the first point where the two disagree.
+ *
+ * The process fork ()s before the run: the parent runs the tick engine as
+ * the reference, the child the alternate engine, each with its own copy
+ * of the simulator.  At every bus grant the child sends what it observes
+ * over a pipe: the cycle, the request granted, the counters of all caches,
+ * and a digest of the protocol state of every line in every cache.  The
+ * parent compares it with its own observation of the same grant, and only
+ * then lets the child go on, so the two run in lockstep.  The final state
+ * is compared once both are done.
+ *
+ * At the first difference, the parent asks the child for its full list of
+ * line states, and both dump every line they disagree on with
+ * Simulator::dump_cache_block () before the run stops.
+ *
+ * The optimistic engine grants speculatively and may take a grant back,
+ * so against it only the final state is compared.
+ */
+class Lockstep {
+public:
+    Lockstep ();
+    ~Lockstep ();
+
+    /** Returns in both processes, in the child with the alternate engine
+     *  selected.  */
+    void start (engine_t alternate);
+
+    /** Called by the bus as it grants a request.  */
+    void grant (Mreq *request);
+
+    /** Called at the end of the run.  Only returns in the parent.  */
+    void finish (void);
+
+    bool reference;
+    engine_t alternate;
+    counter_t observations;
+    void report (void);
+
+private:
+    typedef enum {
+        OBSERVE_GRANT = 0,
+        OBSERVE_END
+    } observe_t;
+
+    class Observation {
+    public:
+        int kind;
+        timestamp_t cycle;
+        int node;
+        int msg;
+        paddr_t addr;
+        Sim_stats stats;
+        uint64_t digest;
+    };
+
+    class Line_state {
+    public:
+        int node;
+        paddr_t addr;
+        int state;
+    };
+
+    pid_t child;
+    int read_fd;
+    int write_fd;
+
+    /** Compared at every grant, rather than only at the end.  */
+    bool per_grant;
+
+    void observe (Observation &observation, int kind, Mreq *request);
+    void exchange (Observation &mine);
+    void diverged (Observation &mine, Observation *theirs);
+    void serve_dump (void);
+    void get_states (VECTOR<Line_state> &states);
+    void send (const void *buf, size_t size);
+    bool receive (void *buf, size_t size);
+};
+
+#endif /* LOCKSTEP_H_ */
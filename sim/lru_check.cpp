@@ -0,0 +1,108 @@
+#include <algorithm>
+
+#include "hash_table.h"
+#include "lru_check.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Simulator *Sim;
+
+Lru_check::Lru_check (Hash_table *cache)
+{
+    this->cache = cache;
+}
+
+Lru_check::~Lru_check ()
+{
+}
+
+int Lru_check::set_of (paddr_t addr)
+{
+    return (addr & cache->index_mask) >> cache->num_offset_bits;
+}
+
+/** The lines of a set, in the order they came in.  */
+void Lru_check::lines_of (int set, VECTOR<paddr_t> &lines)
+{
+    lines.clear ();
+    for (LIST<paddr_t>::iterator it = arrival.begin (); it != arrival.end (); it++)
+        if (set_of (*it) == set)
+            lines.push_back (*it);
+}
+
+void Lru_check::use (paddr_t addr)
+{
+    LIST<paddr_t>::iterator it = find (recency.begin (), recency.end (), addr);
+
+    if (it == recency.end ())
+        fatal_error ("%s %d: LRU check: used 0x%llx, which it does not hold\n", cache->name,
+                     cache->moduleID.nodeID, (unsigned long long)addr);
+
+    recency.erase (it);
+    recency.push_front (addr);
+}
+
+void Lru_check::evict (paddr_t victim)
+{
+    int set = set_of (victim);
+    VECTOR<paddr_t> lines;
+    paddr_t expected = 0;
+    bool found = false;
+
+    lines_of (set, lines);
+    if ((int)lines.size () != cache->assoc)
+        fatal_error ("%s %d: LRU check: evicts from set %d with %d of %d lines\n", cache->name,
+                     cache->moduleID.nodeID, set, (int)lines.size (), cache->assoc);
+
+    for (unsigned int i = 0; i < lines.size () && !found; i++)
+        if (cache->find_entry (lines[i])->protocol->get_state () == cache->invalid_state)
+        {
+            expected = lines[i];
+            found = true;
+        }
+
+    for (LIST<paddr_t>::reverse_iterator it = recency.rbegin (); it != recency.rend () && !found; it++)
+        if (set_of (*it) == set)
+        {
+            expected = *it;
+            found = true;
+        }
+
+    if (victim != expected)
+        fatal_error ("%s %d: LRU check: evicts 0x%llx where LRU evicts 0x%llx, cycle %lld\n",
+                     cache->name, cache->moduleID.nodeID, (unsigned long long)victim,
+                     (unsigned long long)expected, (long long int)Global_Clock);
+
+    remove (victim);
+}
+
+void Lru_check::place (paddr_t addr)
+{
+    int set = set_of (addr);
+    VECTOR<paddr_t> lines;
+    VECTOR<paddr_t> held;
+
+    recency.push_front (addr);
+    arrival.push_back (addr);
+
+    lines_of (set, lines);
+    for (unsigned int i = 0; i < cache->set_entries[set].size (); i++)
+        held.push_back (cache->set_entries[set][i]->tag);
+
+    if (lines != held || (int)lines.size () > cache->assoc)
+        fatal_error ("%s %d: LRU check: set %d holds other lines than LRU, cycle %lld\n",
+                     cache->name, cache->moduleID.nodeID, set, (long long int)Global_Clock);
+}
+
+void Lru_check::remove (paddr_t addr)
+{
+    recency.remove (addr);
+    arrival.remove (addr);
+}
+
+void Lru_check::clear (void)
+{
+    recency.clear ();
+    arrival.clear ();
+}
@@ -0,0 +1,49 @@
+#ifndef LRU_CHECK_H_
+#define LRU_CHECK_H_
+
+#include "types.h"
+
+using namespace std;
+
+class Hash_table;
+
+/**
+ * Brute force reference for the replacement of a finite cache (see
+ * hash_table.h), run alongside it with l1_lru_check.  It keeps what the
+ * cache should hold its own way: every line in one list from most to
+ * least recently used, and every line in one list in the order it came
+ * in.  Each victim is worked out from those alone, by scanning all of
+ * them: the first line of the set to come in that is no longer valid, or
+ * else the one of the set used longest ago.  A victim other than the
+ * cache's, or a set that holds other lines than the cache's, is a fatal
+ * error.
+ */
+class Lru_check {
+public:
+    Lru_check (Hash_table *cache);
+    ~Lru_check ();
+
+    /** The processor used a line the cache holds.  */
+    void use (paddr_t addr);
+
+    /** The cache is dropping victim to make room in its set.  */
+    void evict (paddr_t victim);
+
+    /** The cache has put addr in its set.  */
+    void place (paddr_t addr);
+
+    /** The cache dropped addr by other means.  */
+    void remove (paddr_t addr);
+
+    void clear (void);
+
+private:
+    Hash_table *cache;
+    LIST<paddr_t> recency;
+    LIST<paddr_t> arrival;
+
+    int set_of (paddr_t addr);
+    void lines_of (int set, VECTOR<paddr_t> &lines);
+};
+
+#endif /* LRU_CHECK_H_ */
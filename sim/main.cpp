@@ -5,12 +5,15 @@
 #include <strings.h>
 #include <unistd.h>
 
+#include "bench.h"
+#include "daemon.h"
+#include "fanout.h"
+#include "seeds.h"
 #include "sim.h"
 #include "settings.h"
-
-Sim_settings settings;
-
-Simulator *Sim;
+#include "simulation.h"
+#include "sweep.h"
+#include "tune.h"
 
 extern char *optarg;
 extern int optind, optopt;
@@ -19,22 +22,82 @@ void usage (void)
 {
     fprintf (stderr, "Usage:\n");
     fprintf (stderr, "\t-p <protocol> (choices MI, MSI, MESI)\n");
-    fprintf (stderr, "\t-t <trace directory>\n\n");
+    fprintf (stderr, "\t-t <trace directory>\n");
+    fprintf (stderr, "\t-e <engine> (choices tick, event, parallel, optimistic; default event)\n");
+    fprintf (stderr, "\t-j <threads> (parallel engine, or variants run at once; default one per cpu)\n");
+    fprintf (stderr, "\t-q (quiet: only print the final statistics)\n");
+    fprintf (stderr, "\t-x (extrapolate over periodic steady states)\n");
+    fprintf (stderr, "\t-a (also estimate the run analytically, for comparison)\n");
+    fprintf (stderr, "\t-A (only estimate the run analytically)\n");
+    fprintf (stderr, "\t-m <size[:assoc][,size[:assoc]...]> (count the misses of these L1 caches, in one functional pass)\n");
+    fprintf (stderr, "\t-c <file> (save a checkpoint, at the cycle given by -C; default 0)\n");
+    fprintf (stderr, "\t-C <cycle>\n");
+    fprintf (stderr, "\t-r <file> (start from a checkpoint)\n");
+    fprintf (stderr, "\t-b <cycle> (run each variant from this cycle on, in a process of its own)\n");
+    fprintf (stderr, "\t-v <name=value[,name=value...]> (a variant; may be repeated)\n");
+    fprintf (stderr, "\t-w <references> (warm up functionally on this many references per core)\n");
+    fprintf (stderr, "\t-s <references> (sample: run in detail once every this many references per core)\n");
+    fprintf (stderr, "\t-S <references> (references per core measured in each sample; default 64)\n");
+    fprintf (stderr, "\t-k <phases> (simulate one representative interval per phase)\n");
+    fprintf (stderr, "\t-i <references> (references per core in an interval; default 1024)\n");
+    fprintf (stderr, "\t-l <file> (record the bus log of the run)\n");
+    fprintf (stderr, "\t-L <file> (replay a bus log instead of running)\n");
+    fprintf (stderr, "\t-d (check the engine against the tick engine, in lockstep)\n");
+    fprintf (stderr, "\t-f <file> (run the sweep in this spec file, instead of -p and -t)\n");
+    fprintf (stderr, "\t-F (run the traces under every protocol at once, instead of -p)\n");
+    fprintf (stderr, "\t-T <file> (search the L1 settings in this spec file for the fastest run at each size)\n");
+    fprintf (stderr, "\t-B (time the cache lookups of the traces instead of running, against a std::map)\n");
+    fprintf (stderr, "\t-M <directory> (keep results there, and take them from there if the same run was done)\n");
+    fprintf (stderr, "\t-R (run even if the result is kept, and keep the new one)\n");
+    fprintf (stderr, "\t-n <seeds> (run under jitter with each of this many seeds, and report the spread)\n");
+    fprintf (stderr, "\t-N <cycles> (memory latency jitter, either way; default 0)\n");
+    fprintf (stderr, "\t-o <name=value[,name=value...]> (change settings; may be repeated)\n");
+    fprintf (stderr, "\t-D <socket> (serve jobs on this socket, -j at a time, instead of running)\n");
+    fprintf (stderr, "\t-J <socket> (run on the daemon serving this socket; takes -t, -p, -e, -q and -o only)\n\n");
 }
 
 int main (int argc, char *argv[])
 {
-    int num_nodes = 0;
+    Sim_settings settings;
     char *trace_dir = NULL;
     char *protocol = NULL;
-    FILE *config_file = NULL;
-    char config_path[1000];
+    char *engine = NULL;
+    int num_threads = 0;
+    bool quiet = false;
+    bool extrapolate = false;
+    bool estimate = false;
+    bool estimate_only = false;
+    char *stack_study = NULL;
+    char *checkpoint_file = NULL;
+    long long checkpoint_cycle = 0;
+    char *restore_file = NULL;
+    long long branch_cycle = 0;
+    VECTOR<char *> variants;
+    long long warmup = -1;
+    long long sampling_interval = 0;
+    long long sample_size = 0;
+    long long simpoint_clusters = 0;
+    long long simpoint_interval = 0;
+    char *record_file = NULL;
+    char *replay_file = NULL;
+    bool lockstep = false;
+    char *sweep_file = NULL;
+    bool fanout = false;
+    char *tune_file = NULL;
+    bool bench = false;
+    char *memo_dir = NULL;
+    bool memo_refresh = false;
+    VECTOR<char *> overrides;
+    int seeds = 0;
+    int jitter_cycles = 0;
+    char *daemon_socket = NULL;
+    char *job_socket = NULL;
     bool debug = false;
 
     /** Parse command line arguments.  */
     int c;
 
-    while ((c = getopt(argc, argv, "hP:p:t:")) != -1)
+    while ((c = getopt(argc, argv, "hP:p:t:e:j:qxaAm:c:C:r:b:v:w:s:S:k:i:l:L:df:FT:BM:Ro:D:J:n:N:")) != -1)
     {
         switch(c)
         {
@@ -51,6 +114,130 @@ int main (int argc, char *argv[])
             trace_dir = strdup (optarg);
             break;
 
+        case 'e':
+            engine = strdup (optarg);
+            break;
+
+        case 'j':
+            num_threads = atoi (optarg);
+            break;
+
+        case 'q':
+            quiet = true;
+            break;
+
+        case 'x':
+            extrapolate = true;
+            break;
+
+        case 'a':
+            estimate = true;
+            break;
+
+        case 'A':
+            estimate_only = true;
+            break;
+
+        case 'm':
+            stack_study = strdup (optarg);
+            break;
+
+        case 'c':
+            checkpoint_file = strdup (optarg);
+            break;
+
+        case 'C':
+            checkpoint_cycle = atoll (optarg);
+            break;
+
+        case 'r':
+            restore_file = strdup (optarg);
+            break;
+
+        case 'b':
+            branch_cycle = atoll (optarg);
+            break;
+
+        case 'v':
+            variants.push_back (strdup (optarg));
+            break;
+
+        case 'w':
+            warmup = atoll (optarg);
+            break;
+
+        case 's':
+            sampling_interval = atoll (optarg);
+            break;
+
+        case 'S':
+            sample_size = atoll (optarg);
+            break;
+
+        case 'k':
+            simpoint_clusters = atoll (optarg);
+            break;
+
+        case 'i':
+            simpoint_interval = atoll (optarg);
+            break;
+
+        case 'l':
+            record_file = strdup (optarg);
+            break;
+
+        case 'L':
+            replay_file = strdup (optarg);
+            break;
+
+        case 'd':
+            lockstep = true;
+            break;
+
+        case 'f':
+            sweep_file = strdup (optarg);
+            break;
+
+        case 'F':
+            fanout = true;
+            break;
+
+        case 'T':
+            tune_file = strdup (optarg);
+            break;
+
+        case 'B':
+            bench = true;
+            break;
+
+        case 'M':
+            memo_dir = strdup (optarg);
+            break;
+
+        case 'R':
+            memo_refresh = true;
+            break;
+
+        case 'o':
+            overrides.push_back (strdup (optarg));
+            break;
+
+        case 'D':
+            daemon_socket = strdup (optarg);
+            break;
+
+        case 'J':
+            job_socket = strdup (optarg);
+            break;
+
+        case 'n':
+            seeds = atoi (optarg);
+            break;
+
+        case 'N':
+            jitter_cycles = atoi (optarg);
+            break;
+
         default:
             fprintf (stderr, "Invalid command line arguments - %c", c);
             usage ();
@@ -58,30 +245,24 @@ int main (int argc, char *argv[])
         }
     }
 
-    sprintf(config_path,"%s/config",trace_dir);
-    config_file = fopen (config_path,"r");
-    if (fscanf(config_file,"%d\n",&num_nodes) != 1)
-    {
-    	fatal_error("Config File should contain number of traces\n");
-    }
-
-    if (num_nodes == 0)
-        fatal_error ("Error: number of processors is zero.\n");
-
-    if (protocol == NULL)
+    if (protocol == NULL && sweep_file == NULL && !fanout && tune_file == NULL && !bench &&
+        daemon_socket == NULL)
         fatal_error ("Error: invalid protocol specified.\n");
 
-    if (trace_dir == NULL)
+    if (trace_dir == NULL && sweep_file == NULL && daemon_socket == NULL)
         fatal_error ("Error: trace file directory not defined!\n");
 
 
 
     /** Init settings.  */
     settings.set_defaults ();
-    settings.num_nodes = num_nodes;
-    settings.trace_dir = trace_dir;
 
-    if (!strcmp(protocol,"MI"))
+    if (protocol == NULL)
+    {
+    	/** Each run of the sweep, fan-out or tuner, or job of the daemon, has its own.  */
+    	settings.protocol = NULL_PRO;
+    }
+    else if (!strcmp(protocol,"MI"))
     {
     	settings.protocol = MI_PRO;
     }
@@ -110,9 +291,141 @@ int main (int argc, char *argv[])
     	fatal_error ("Error: invalid protocol specified.\n");
     }
 
+    if (engine == NULL || !strcmp(engine,"event"))
+    {
+    	settings.engine = EVENT_ENGINE;
+    }
+    else if (!strcmp(engine,"tick"))
+    {
+    	settings.engine = TICK_ENGINE;
+    }
+    else if (!strcmp(engine,"parallel"))
+    {
+    	settings.engine = PARALLEL_ENGINE;
+    }
+    else if (!strcmp(engine,"optimistic"))
+    {
+    	settings.engine = OPTIMISTIC_ENGINE;
+    }
+    else
+    {
+    	fatal_error ("Error: invalid engine specified.\n");
+    }
+
+    if (num_threads > 0)
+        settings.num_threads = num_threads;
+
+    settings.verbose = !quiet;
+    settings.extrapolate = extrapolate;
+    settings.estimate = estimate;
+    settings.estimate_only = estimate_only;
+    settings.stack_study = stack_study;
+    settings.checkpoint_file = checkpoint_file;
+    settings.checkpoint_cycle = checkpoint_cycle;
+    settings.restore_file = restore_file;
+    settings.branch_cycle = branch_cycle;
+    settings.variants = variants;
+    settings.record_file = record_file;
+    settings.replay_file = replay_file;
+    settings.lockstep = lockstep;
+    settings.memo_dir = memo_dir;
+    settings.memo_refresh = memo_refresh;
+    settings.jitter_cycles = jitter_cycles;
+
+    /** The functional model takes a limit of 0 as no limit at all.  */
+    if (warmup > 0)
+    {
+        settings.functional_warmup = true;
+        settings.warmup_time_per_core = warmup;
+    }
+
+    if (sampling_interval > 0)
+    {
+        settings.sampling = true;
+        settings.sampling_interval = sampling_interval;
+    }
+    if (sample_size > 0)
+        settings.sample_size = sample_size;
+
+    if (simpoint_clusters > 0)
+    {
+        settings.simpoint = true;
+        settings.simpoint_clusters = simpoint_clusters;
+    }
+    if (simpoint_interval > 0)
+        settings.simpoint_interval = simpoint_interval;
+
+    for (unsigned int i = 0; i < variants.size (); i++)
+        if (!settings.apply_override (variants[i], false))
+            fatal_error ("Error: invalid variant %s\n", variants[i]);
+
+    for (unsigned int i = 0; i < overrides.size (); i++)
+        if (!settings.apply_override (overrides[i], true, true))
+            fatal_error ("Error: invalid setting %s\n", overrides[i]);
+
+    /** Each window has to fast forward over something.  */
+    if (settings.sampling &&
+        settings.sampling_interval <= settings.sample_warmup + settings.sample_size)
+        fatal_error ("Error: sampling interval %lld is not above the %lld warmup and %lld "
+                     "measured references of a sample\n", settings.sampling_interval,
+                     settings.sample_warmup, settings.sample_size);
+
     //TODO: Add MI, MSI, MESI to config; Hardcoded for MI now    
 
+    if (sweep_file)
+    {
+        Sweep sweep (sweep_file);
+        sweep.run (settings);
+        return 0;
+    }
+
+    if (daemon_socket)
+    {
+        Daemon daemon (settings, daemon_socket);
+        daemon.serve ();
+    }
+
+    /** A job carries its traces, protocol, engine, -q and -o, and no more.  */
+    if (job_socket)
+    {
+        if (!settings.plain_run () || settings.memo_dir || settings.jitter_cycles || seeds ||
+            bench || tune_file || fanout)
+            fatal_error ("Error: -J runs a plain simulation, with -t, -p, -e, -q and -o only\n");
+        return Daemon::submit (job_socket, settings, trace_dir, overrides);
+    }
+
+    if (seeds)
+    {
+        Seeds runs (settings, trace_dir, seeds);
+        runs.run ();
+        return 0;
+    }
+
+    if (bench)
+    {
+        Lookup_bench lookups (settings, trace_dir);
+        lookups.run ();
+        return 0;
+    }
+
+    if (tune_file)
+    {
+        Tuner tuner (tune_file);
+        tuner.run (settings, trace_dir);
+        return 0;
+    }
+
+    if (fanout)
+    {
+        Fanout runs (settings, trace_dir);
+        runs.run ();
+        return 0;
+    }
+
     /** Build simulator.  */
-    Sim = new Simulator ();
-    Sim->run ();
+    Simulation simulation (settings, trace_dir);
+    simulation.run ();
+
+    if (simulation.memo_hit)
+        fprintf (stdout, "Result kept in %s\n", memo_dir);
 }
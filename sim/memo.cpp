@@ -0,0 +1,184 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <mutex>
+
+#include "memo.h"
+#include "sim.h"
+
+using namespace std;
+
+uint64_t hash_bytes (uint64_t h, const void *data, size_t size)
+{
+    const unsigned char *p = (const unsigned char *)data;
+
+    for (size_t i = 0; i < size; i++)
+        h = (h ^ p[i]) * MEMO_HASH_PRIME;
+    return h;
+}
+
+static uint64_t hash_int (uint64_t h, long long v)
+{
+    return hash_bytes (h, &v, sizeof (v));
+}
+
+/** Returns false if there is no such file.  */
+static bool hash_file (uint64_t *h, const char *file)
+{
+    FILE *f = fopen (file, "r");
+    char buf[65536];
+    size_t n;
+
+    if (f == NULL)
+        return false;
+
+    while ((n = fread (buf, 1, sizeof (buf), f)) > 0)
+        *h = hash_bytes (*h, buf, n);
+    fclose (f);
+
+    /** Keep one file's end apart from the next one's start.  */
+    *h = hash_int (*h, -1);
+    return true;
+}
+
+uint64_t Memo::binary_hash (void)
+{
+    static uint64_t hash = 0;
+    static bool hashed = false;
+    static mutex hash_lock;
+    unique_lock<mutex> guard (hash_lock);
+
+    if (!hashed)
+    {
+        hash = MEMO_HASH_SEED;
+        if (!hash_file (&hash, "/proc/self/exe"))
+            fatal_error ("Memo: cannot read the simulator binary\n");
+        hashed = true;
+    }
+
+    return hash;
+}
+
+Memo::Memo (Sim_settings &config)
+{
+    uint64_t key = MEMO_HASH_SEED;
+    char file[1000];
+
+    snprintf (file, sizeof (file), "%s/config", config.trace_dir);
+    if (!hash_file (&key, file))
+        fatal_error ("Memo: cannot read %s\n", file);
+
+    for (int i = 0; i < config.num_nodes; i++)
+    {
+        snprintf (file, sizeof (file), "%s/p%d.trace", config.trace_dir, i);
+        if (!hash_file (&key, file))
+            fatal_error ("Memo: cannot read %s\n", file);
+    }
+
+    /** Everything a plain run reads, the tunables included.  The number of
+     *  threads is left out: every engine gets the same result with any.  */
+    key = hash_int (key, config.num_nodes);
+    key = hash_int (key, config.protocol);
+    key = hash_int (key, config.engine);
+    key = hash_int (key, config.verbose);
+    key = hash_int (key, config.mem_hit_time);
+    key = hash_int (key, config.cache_line_size);
+    key = hash_int (key, config.cache_line_size_log2);
+    key = hash_int (key, config.l1_cache_size);
+    key = hash_int (key, config.l1_cache_assoc);
+    key = hash_int (key, config.l1_infinite);
+    key = hash_int (key, config.l1_hit_time);
+    key = hash_int (key, config.l1_mshrs);
+
+    root = strdup (config.memo_dir);
+    snprintf (file, sizeof (file), "%s/%016llx", root, (unsigned long long)binary_hash ());
+    dir = strdup (file);
+
+    snprintf (file, sizeof (file), "%s/%016llx", dir, (unsigned long long)key);
+    path = strdup (file);
+}
+
+Memo::~Memo ()
+{
+    free (root);
+    free (dir);
+    free (path);
+}
+
+bool Memo::load (Sim_result *result, FILE *log)
+{
+    FILE *f = fopen (path, "r");
+    char magic[16];
+    int version;
+    unsigned long long run_time, misses, accesses, upgrades, transfers, writebacks, busy;
+    size_t log_size;
+    char *buf;
+    bool hit;
+
+    if (f == NULL)
+        return false;
+
+    if (fscanf (f, "%15s %d\n%llu %llu %llu %llu %llu %llu %llu\n%zu\n", magic, &version,
+                &run_time, &misses, &accesses, &upgrades, &transfers, &writebacks, &busy,
+                &log_size) != 10 ||
+        strcmp (magic, MEMO_MAGIC) || version != MEMO_VERSION)
+    {
+        fclose (f);
+        return false;
+    }
+
+    buf = (char *)malloc (log_size + 1);
+    hit = fread (buf, 1, log_size, f) == log_size;
+    fclose (f);
+
+    if (hit)
+    {
+        result->run_time = run_time;
+        result->stats.cache_misses = misses;
+        result->stats.cache_accesses = accesses;
+        result->stats.silent_upgrades = upgrades;
+        result->stats.cache_to_cache_transfers = transfers;
+        result->stats.writebacks = writebacks;
+        result->bus_busy_cycles = busy;
+        fwrite (buf, 1, log_size, log);
+    }
+    free (buf);
+
+    return hit;
+}
+
+/** Written aside and renamed into place, so that runs in other threads or
+ *  processes never see half an entry.  */
+void Memo::store (Sim_result &result, const char *log, size_t log_size)
+{
+    char *tmp = (char *)malloc (strlen (path) + 8);
+    FILE *f;
+    int fd;
+
+    if ((mkdir (root, 0777) != 0 && errno != EEXIST) ||
+        (mkdir (dir, 0777) != 0 && errno != EEXIST))
+        fatal_error ("Memo: cannot create %s\n", dir);
+
+    sprintf (tmp, "%s.XXXXXX", path);
+    fd = mkstemp (tmp);
+    if (fd < 0 || (f = fdopen (fd, "w")) == NULL)
+        fatal_error ("Memo: cannot create %s\n", tmp);
+
+    fprintf (f, "%s %d\n%llu %llu %llu %llu %llu %llu %llu\n%zu\n", MEMO_MAGIC, MEMO_VERSION,
+             (unsigned long long)result.run_time,
+             (unsigned long long)result.stats.cache_misses,
+             (unsigned long long)result.stats.cache_accesses,
+             (unsigned long long)result.stats.silent_upgrades,
+             (unsigned long long)result.stats.cache_to_cache_transfers,
+             (unsigned long long)result.stats.writebacks,
+             (unsigned long long)result.bus_busy_cycles, log_size);
+    fwrite (log, 1, log_size, f);
+
+    if (fclose (f) != 0 || rename (tmp, path) != 0)
+        fatal_error ("Memo: cannot write %s\n", path);
+
+    free (tmp);
+}
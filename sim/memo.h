@@ -0,0 +1,56 @@
+#ifndef MEMO_H_
+#define MEMO_H_
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "settings.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+#define MEMO_MAGIC      "CSXMEMO"
+#define MEMO_VERSION    2
+
+/** FNV-1a, which memo keys are hashed with, from MEMO_HASH_SEED.  */
+#define MEMO_HASH_SEED      0xcbf29ce484222325ULL
+#define MEMO_HASH_PRIME     0x100000001b3ULL
+
+uint64_t hash_bytes (uint64_t h, const void *data, size_t size);
+
+/**
+ * On-disk cache of the results of plain runs (see
+ * Sim_settings::plain_run ()), in memo_dir.
+ *
+ * An entry is keyed by a hash of everything the run depends on: the
+ * contents of the config file and of every trace, the protocol, and the
+ * settings a plain run reads.  It holds the result and everything the run
+ * logged, so that a hit prints just what the run would have.
+ *
+ * Entries sit in a subdirectory named after a hash of the simulator binary
+ * itself, so a rebuilt simulator never sees the results of another build.
+ * Those can be deleted with their subdirectory.
+ */
+class Memo {
+public:
+    /** For the run config describes.  */
+    Memo (Sim_settings &config);
+    ~Memo ();
+
+    char *path;
+
+    /** On a hit, fills in result and writes what the run logged to log.  */
+    bool load (Sim_result *result, FILE *log);
+
+    void store (Sim_result &result, const char *log, size_t log_size);
+
+private:
+    /** memo_dir, and the subdirectory of this build in it.  */
+    char *root;
+    char *dir;
+
+    static uint64_t binary_hash (void);
+};
+
+#endif /* MEMO_H_ */
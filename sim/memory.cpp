@@ -1,7 +1,8 @@
 #include "memory.h"
 #include "sim.h"
 
-extern Simulator * Sim;
+extern thread_local Simulator *Sim;
+extern thread_local Sim_settings settings;
 
 Memory_controller::Memory_controller(ModuleID moduleID, int hit_time)
 	: Module (moduleID, "MC_")
@@ -10,6 +11,8 @@ Memory_controller::Memory_controller(ModuleID moduleID, int hit_time)
 	request_in_progress = false;
 	data_time = 0;
 	data_target = (ModuleID){-1,INVALID_M};
+	input = NULL;
+	task = run ();
 }
 
 Memory_controller::~Memory_controller()
@@ -18,34 +21,85 @@ Memory_controller::~Memory_controller()
 
 void Memory_controller::tick()
 {
-    Mreq *request;
+    input = read_input_port ();
+    task.poll ();
+    consume_input ();
+}
 
-    if ((request = read_input_port ()) != NULL)
+void Memory_controller::consume_input()
+{
+    if (input)
     {
-		if (request->msg != DATA)
-		{
-			assert (!request_in_progress);
-			request_in_progress = true;
-			data_addr = request->addr;
-			data_target = request->src_mid;
-			data_time = Global_Clock + hit_time;
-		}
-		else
-		{
-			request_in_progress = false;
-		}
+        delete input;
+        input = NULL;
     }
+}
 
-    if (request_in_progress && Global_Clock >= data_time)
+/** Wait for a request on the bus, then for data_time to come around, and
+ *  answer it, unless a cache has answered it first.  */
+Sim_task Memory_controller::run()
+{
+    while (true)
     {
-    	Mreq * new_request;
-    	new_request = new Mreq(DATA,data_addr,moduleID,data_target);
-    	request_in_progress = false;
-    	fprintf(stderr,"**** DATA SEND MC -- Clock: %lld\n",Global_Clock);
-    	this->write_output_port(new_request);
+        if (!request_in_progress)
+        {
+            co_await wait_until ([this] { return input != NULL; });
+
+            /** A writeback brings its own data.  */
+            if (input->msg != DATA && input->msg != WRITEBACK)
+            {
+                request_in_progress = true;
+                data_addr = input->addr;
+                data_target = input->src_mid;
+                data_time = Global_Clock + latency ();
+                Sim->schedule (MC_PHASE, moduleID.nodeID, data_time);
+            }
+            consume_input ();
+            continue;
+        }
+
+        co_await wait_until ([this] { return input != NULL || Global_Clock >= data_time; });
+
+        if (input)
+        {
+            if (input->msg != DATA)
+                fatal_error ("MC: request while another is in progress\n");
+            request_in_progress = false;
+            consume_input ();
+            continue;
+        }
+
+        Mreq * new_request;
+        new_request = new Mreq(DATA,data_addr,moduleID,data_target);
+        request_in_progress = false;
+        if (settings.verbose)
+            fprintf(SIM_LOG,"**** DATA SEND MC -- Clock: %lld\n",Global_Clock);
+        this->write_output_port(new_request);
     }
 }
 
+int Memory_controller::latency (void)
+{
+    if (!settings.jitter_seed || !settings.jitter_cycles)
+        return hit_time;
+
+    return max (1, hit_time - settings.jitter_cycles +
+                   Sim->jitter (2 * settings.jitter_cycles + 1));
+}
+
+int Memory_controller::min_latency (void)
+{
+    if (!settings.jitter_seed)
+        return hit_time;
+
+    return max (1, hit_time - settings.jitter_cycles);
+}
+
+void Memory_controller::restart()
+{
+    task = run ();
+}
+
 void Memory_controller::tock()
 {
     fatal_error ("Memory controller tock should never be called!\n");
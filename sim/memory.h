@@ -9,6 +9,7 @@
 #include "module.h"
 #include "mreq.h"
 #include "settings.h"
+#include "task.h"
 
 using namespace std;
 
@@ -20,13 +21,29 @@ public:
 
     int hit_time;
 
+    /** hit_time, give or take the jitter (see Sim_settings::jitter_seed),
+     *  and the least that can be.  */
+    int latency (void);
+    int min_latency (void);
+
     bool request_in_progress;
     timestamp_t data_time;
     paddr_t data_addr;
     ModuleID data_target;
 
+    /** What the bus showed this cycle, for the task to look at.  */
+    Mreq *input;
+
 	void tick();
 	void tock();
+
+    /** Start over from the state in the members above.  */
+    void restart();
+
+private:
+    Sim_task task;
+    Sim_task run();
+    void consume_input();
 };
 
 #endif /* MEM_MAIN_H_ */
@@ -5,8 +5,8 @@
 #include "settings.h"
 #include "sim.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
 
 using namespace std;
 
@@ -36,16 +36,16 @@ void Mreq::print_msg (ModuleID mid, const char *add_msg)
     print_id ("node", mid);
     print_id ("src", src_mid);
     print_id ("dest", dest_mid);
-    fprintf (stderr, "tag: 0x%8llx clock: %8lld ", (long long int)addr>>settings.cache_line_size_log2, Global_Clock);
-    fprintf (stderr, " %8s\n", Mreq::message_t_str[msg]);
+    fprintf (SIM_LOG, "tag: 0x%8llx clock: %8lld ", (long long int)addr>>settings.cache_line_size_log2, Global_Clock);
+    fprintf (SIM_LOG, " %8s\n", Mreq::message_t_str[msg]);
 }
 
 void Mreq::dump ()
 {
     //TODO: convert fprintfs to c++-ishy output
-    fprintf (stderr, "Request Dump ");
+    fprintf (SIM_LOG, "Request Dump ");
     print_id ("src", src_mid);
     print_id ("dest", dest_mid);
-    fprintf (stderr, "0x%8llx Clock: %8lld %20s\n",
+    fprintf (SIM_LOG, "0x%8llx Clock: %8lld %20s\n",
              (long long int)addr, Global_Clock, Mreq::message_t_str[msg]);
 }
@@ -4,8 +4,8 @@
 #include "memory.h"
 #include "sim.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
 
 Node::Node (int nodeID)
 {
@@ -33,14 +33,16 @@ void Node::build_processor (char *trace_file)
                                         settings.cache_line_size,
                                         settings.l1_mshrs,
                                         settings.l1_hit_time,
-                                        settings.protocol);
+                                        settings.protocol,
+                                        settings.l1_infinite != 0);
 
     mod[PR_M] = new Processor ((ModuleID){nodeID, PR_M}, cache, trace_file);
 }
 
 void Node::build_memory_controller (void)
 {
-	mod[MC_M] = new Memory_controller ((ModuleID){nodeID, MC_M}, 100);
+	mod[MC_M] = new Memory_controller ((ModuleID){nodeID, MC_M},
+	                                               settings.mem_hit_time);
 }
 
 void Node::tick_cache (void)
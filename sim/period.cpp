@@ -0,0 +1,241 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hash_table.h"
+#include "memory.h"
+#include "period.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+static inline uint64_t hash_mix (uint64_t h, uint64_t v)
+{
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    h ^= v + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    return h;
+}
+
+static void put_mreq (VECTOR<uint64_t> &state, Mreq *request)
+{
+    if (request == NULL)
+    {
+        state.push_back (0);
+        return;
+    }
+
+    state.push_back (1);
+    state.push_back (request->msg);
+    state.push_back (request->addr);
+    state.push_back (request->src_mid.nodeID);
+    state.push_back (request->dest_mid.nodeID);
+}
+
+Period_detector::Period_detector ()
+{
+    checks = 0;
+    periods_skipped = 0;
+    cycles_skipped = 0;
+    words = 0;
+}
+
+Period_detector::~Period_detector ()
+{
+}
+
+/** Nothing queued, granted or on its way back.  The shared line does not
+ *  matter: the next grant resets it before anyone can read it.  */
+bool Period_detector::bus_idle (void)
+{
+    Bus *bus = Sim->bus;
+
+    return (!bus->request_in_progress && bus->pending_requests.empty () &&
+            bus->data_reply == NULL);
+}
+
+void Period_detector::get_state (VECTOR<uint64_t> &state)
+{
+    VECTOR<Hash_entry*> entries;
+
+    state.clear ();
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+        Hash_table *cache = Sim->get_L1 (i);
+
+        state.push_back (pr->end_of_trace);
+        state.push_back (pr->outstanding_request);
+        put_mreq (state, pr->inbound_request);
+        put_mreq (state, pr->inbound_request_buf);
+        state.push_back (pr->resume_time > Sim->global_clock ?
+                         pr->resume_time - Sim->global_clock : 0);
+        put_mreq (state, cache->proc_request);
+
+        cache->my_entries.sorted (entries);
+        state.push_back (entries.size ());
+        for (unsigned int j = 0; j < entries.size (); j++)
+        {
+            state.push_back (entries[j]->tag);
+            state.push_back (entries[j]->protocol->get_state ());
+        }
+    }
+}
+
+uint64_t Period_detector::hash_state (VECTOR<uint64_t> &state)
+{
+    uint64_t h = 0;
+
+    for (unsigned int i = 0; i < state.size (); i++)
+        h = hash_mix (h, state[i]);
+    return h;
+}
+
+void Period_detector::take_snapshot (Snapshot &snapshot)
+{
+    snapshot.cycle = Sim->global_clock;
+    get_state (snapshot.state);
+    snapshot.trace_pos.resize (settings.num_nodes);
+    snapshot.stats.resize (settings.num_nodes);
+    snapshot.bus_busy_cycles = Sim->bus->busy_cycles;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        snapshot.trace_pos[i] = ftell (Sim->get_PR (i)->infile);
+        snapshot.stats[i] = Sim->get_L1 (i)->stats;
+    }
+}
+
+/** How many times in a row every trace repeats, from now on, the stretch
+ *  it consumed between the two snapshots.  */
+counter_t Period_detector::repeats (Snapshot &then, Snapshot &now)
+{
+    counter_t periods = ~(counter_t)0;
+    bool moved = false;
+
+    for (int i = 0; i < settings.num_nodes && periods > 0; i++)
+    {
+        int fd = fileno (Sim->get_PR (i)->infile);
+        long len = now.trace_pos[i] - then.trace_pos[i];
+        counter_t n = 0;
+        char *stretch, *next;
+
+        /** A trace that sat still for the whole period keeps sitting still.  */
+        if (len == 0)
+            continue;
+        moved = true;
+
+        stretch = (char *)malloc (len);
+        next = (char *)malloc (len);
+        if (pread (fd, stretch, len, then.trace_pos[i]) == len)
+        {
+            while (n < periods &&
+                   pread (fd, next, len, now.trace_pos[i] + n * len) == len &&
+                   !memcmp (stretch, next, len))
+                n++;
+        }
+        free (stretch);
+        free (next);
+
+        periods = min (periods, n);
+    }
+
+    /** Nothing to go by if no trace moved at all.  */
+    return moved ? periods : 0;
+}
+
+void Period_detector::skip (Snapshot &then, Snapshot &now, counter_t periods)
+{
+    timestamp_t period = now.cycle - then.cycle;
+    timestamp_t delta = period * periods;
+
+    if (settings.verbose)
+        fprintf (SIM_LOG, "**** FAST FORWARD -- %lld periods of %lld cycles -- Clock: %lld\n",
+                 (long long)periods, (long long)period, (long long)Sim->global_clock);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+        Sim_stats change = now.stats[i];
+        long len = now.trace_pos[i] - then.trace_pos[i];
+
+        fseek (pr->infile, now.trace_pos[i] + periods * len, SEEK_SET);
+
+        change -= then.stats[i];
+        change *= periods;
+        Sim->get_L1 (i)->stats += change;
+
+        if (pr->resume_time >= Sim->global_clock)
+            pr->resume_time += delta;
+    }
+
+    Sim->bus->busy_cycles += (now.bus_busy_cycles - then.bus_busy_cycles) * periods;
+
+    if (Sim->scheduler)
+        Sim->scheduler->shift (delta);
+    Sim->global_clock += delta;
+
+    periods_skipped += periods;
+    cycles_skipped += delta;
+}
+
+void Period_detector::check (void)
+{
+    MAP<uint64_t, Snapshot>::iterator it;
+    Snapshot now;
+    counter_t periods;
+    uint64_t h;
+
+    if (!bus_idle ())
+        return;
+
+    checks++;
+    take_snapshot (now);
+    h = hash_state (now.state);
+
+    it = snapshots.find (h);
+    if (it != snapshots.end () && it->second.state == now.state)
+    {
+        periods = repeats (it->second, now);
+        if (periods > 0)
+        {
+            skip (it->second, now, periods);
+
+            /** Older snapshots are from before the jump.  */
+            snapshots.clear ();
+            words = 0;
+            return;
+        }
+    }
+
+    /** A collision takes the place of the state it collides with.  */
+    if (it != snapshots.end ())
+    {
+        words -= it->second.state.size ();
+        snapshots.erase (it);
+    }
+
+    if (snapshots.size () >= PERIOD_MAX_SNAPSHOTS
+        || words + now.state.size () > PERIOD_MAX_WORDS)
+    {
+        snapshots.clear ();
+        words = 0;
+    }
+    words += now.state.size ();
+    snapshots[h] = now;
+}
+
+/** Goes to stdout, next to the other engine statistics.  */
+void Period_detector::report (void)
+{
+    fprintf (stdout, "\nSteady State Extrapolation:\n");
+    fprintf (stdout, "Idle Points:      %8lld checked\n", (long long)checks);
+    fprintf (stdout, "Periods Skipped:  %8lld periods\n", (long long)periods_skipped);
+    fprintf (stdout, "Cycles Skipped:   %8lld cycles\n", (long long)cycles_skipped);
+}
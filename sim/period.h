@@ -0,0 +1,64 @@
+#ifndef PERIOD_H_
+#define PERIOD_H_
+
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/** Most snapshots kept before the table is started over, and most words
+ *  of state between them.  */
+#define PERIOD_MAX_SNAPSHOTS 4096
+#define PERIOD_MAX_WORDS     (1 << 24)
+
+/**
+ * Detects a periodic steady state and skips over it.
+ *
+ * At the start of every cycle in which the bus is idle, the state of all
+ * caches and processors (with times taken relative to the clock) is taken
+ * down, and looked up by its hash.  When the same state comes up again,
+ * compared in full, as a hash may collide, the system is back where it
+ * was one period earlier, having consumed a fixed stretch of every trace
+ * in between.  For as many times as each trace goes on to repeat its
+ * stretch, the next period will play out exactly like the last one, so
+ * whole periods are skipped at once: the traces are moved on, and the
+ * clock and the counters of every cache advanced by the same multiple of
+ * their change over one period.
+ */
+class Period_detector {
+public:
+    Period_detector ();
+    ~Period_detector ();
+
+    /** Call at the start of a cycle, before the bus ticks.  May move the
+     *  clock forward.  */
+    void check (void);
+
+    /** Statistics.  */
+    counter_t checks;
+    counter_t periods_skipped;
+    counter_t cycles_skipped;
+    void report (void);
+
+private:
+    class Snapshot {
+    public:
+        timestamp_t cycle;
+        VECTOR<uint64_t> state;
+        VECTOR<long> trace_pos;
+        VECTOR<Sim_stats> stats;
+        counter_t bus_busy_cycles;
+    };
+
+    MAP<uint64_t, Snapshot> snapshots;
+    size_t words;
+
+    bool bus_idle (void);
+    void get_state (VECTOR<uint64_t> &state);
+    uint64_t hash_state (VECTOR<uint64_t> &state);
+    void take_snapshot (Snapshot &snapshot);
+    counter_t repeats (Snapshot &then, Snapshot &now);
+    void skip (Snapshot &then, Snapshot &now, counter_t periods);
+};
+
+#endif /* PERIOD_H_ */
@@ -5,70 +5,221 @@
 #include "processor.h"
 #include "settings.h"
 #include "sim.h"
+#include "trace.h"
 
 using namespace std;
 
-extern Simulator * Sim;
+extern thread_local Simulator *Sim;
+extern thread_local Sim_settings settings;
 
 Processor::Processor (ModuleID moduleID, Hash_table *cache, char *trace_file)
     : Module (moduleID, "Processor_")
 {
     this->moduleID = moduleID;
-    this->infile = fopen (trace_file, "r");
+    this->trace_file = strdup (trace_file);
+    if (settings.trace_source)
+    {
+        this->infile = NULL;
+        this->reader = new Trace_reader (settings.trace_source, settings.trace_instance,
+                                         moduleID.nodeID);
+    }
+    else
+    {
+        this->infile = fopen (trace_file, "r");
+        this->reader = NULL;
+    }
     this->my_cache = cache;
     this->end_of_trace = false;
+    this->outstanding_request = false;
     this->inbound_request = NULL;
     this->inbound_request_buf = NULL;
+    this->resume_time = 0;
+    this->fetch_budget = -1;
+    this->paused = false;
+
+    /** The fast path skips the per-request log lines, and looks at the
+     *  shared bus, which the optimistic engine does not allow.  */
+    this->fast_hits = !settings.verbose && settings.engine != OPTIMISTIC_ENGINE;
+
+    this->task = run ();
 }
 
 Processor::~Processor ()
 {
-    fclose (this->infile);
+    if (this->infile)
+        fclose (this->infile);
+    if (this->reader)
+        delete this->reader;
+    free (this->trace_file);
 }
 
-/** Done once at end of trace and no outstanding requests.  */
+/** Done once at end of trace, or paused, and no outstanding requests.  */
 bool Processor::done ()
 {
-    return (end_of_trace && !outstanding_request);
+    return ((end_of_trace || paused) && !outstanding_request);
+}
+
+/** Idle while blocked on the cache with nothing delivered yet, or when done.  */
+bool Processor::is_idle ()
+{
+    return (!inbound_request && !inbound_request_buf &&
+            (end_of_trace || paused || outstanding_request));
 }
 
 void Processor::tick ()
+{
+    task.poll ();
+}
+
+/** The processor's program: fetch a reference, block until the cache has
+ *  returned its data, repeat.  */
+Sim_task Processor::run ()
 {
     char c;
     paddr_t addr;
 
-    if (inbound_request)
+    while (!end_of_trace)
     {
-    	fprintf(stderr,"* COMPLETE -- PR: %d -- Clock: %lld\n",moduleID.nodeID, Global_Clock);
-    	assert (inbound_request->msg == DATA);
-    	outstanding_request = false;
-        delete inbound_request;
+        if (resume_time > Global_Clock)
+            co_await wait_until ([this] { return Global_Clock >= resume_time; });
+
+        if (outstanding_request)
+        {
+            co_await wait_until ([this] { return inbound_request != NULL; });
+
+            if (settings.verbose)
+                fprintf(SIM_LOG,"* COMPLETE -- PR: %d -- Clock: %lld\n",moduleID.nodeID, Global_Clock);
+            assert (inbound_request->msg == DATA);
+            outstanding_request = false;
+            delete inbound_request;
+            inbound_request = NULL;
+        }
+
+        if (fast_hits)
+        {
+            int hits = retire_hits ();
+
+            /** A hit fetched in cycle t completes in t + 2, where the next
+             *  fetch happens.  */
+            if (hits)
+            {
+                resume_time = Global_Clock + 2 * hits;
+                Sim->schedule (PR_PHASE, moduleID.nodeID, resume_time);
+                continue;
+            }
+        }
+
+        if (fetch_budget == 0)
+        {
+            paused = true;
+            co_await wait_until ([this] { return !paused; });
+            continue;
+        }
+
+        if (read_reference (&c, &addr))
+        {
+            Mreq *request;
+
+            if (fetch_budget > 0)
+                fetch_budget--;
+
+            if (settings.verbose)
+                fprintf (SIM_LOG,"* FETCH -- PR: %d -- Clock: %lld -- %c 0x%llx\n", moduleID.nodeID, Global_Clock, c, (unsigned long long int)addr);
+
+            switch (c) {
+            case 'r': request = new Mreq (LOAD, addr, moduleID); break;
+            case 'w': request = new Mreq (STORE, addr, moduleID); break;
+            default:
+                fatal_error ("Processor %d: unknown operation - %c", moduleID.nodeID, c);
+            }
+
+            my_cache->processor_request (request);
+            outstanding_request = true;
+        }
+        else
+        {
+            end_of_trace = true;
+        }
     }
-    inbound_request = NULL;
+}
 
-    if (end_of_trace || outstanding_request)
-        return;
+/** Retire the hits at the head of the trace that the cache would look up
+ *  before any bus request can be snooped, leaving the trace at the first
+ *  reference that has to go the normal way.  */
+int Processor::retire_hits ()
+{
+    timestamp_t horizon = Sim->next_snoop_cycle ();
+    int hits = 0;
+    char c;
+    paddr_t addr;
+    long pos;
 
-    if (fscanf (infile, "%c 0x%llx\n", &c, (unsigned long long int*)&addr) == 2)
+    /** Hit number i is fetched in cycle now + 2i and looked up in the next.  */
+    while (Global_Clock + 2 * hits + 1 <= horizon && fetch_budget != 0)
     {
-        Mreq *request;
+        pos = reader ? 0 : ftell (infile);
+        if (!read_reference (&c, &addr))
+        {
+            if (!reader)
+                fseek (infile, pos, SEEK_SET);
+            break;
+        }
 
-        fprintf (stderr,"* FETCH -- PR: %d -- Clock: %lld -- %c 0x%llx\n", moduleID.nodeID, Global_Clock, c, (unsigned long long int)addr);
+        if (c != 'r' && c != 'w')
+        {
+            unread_reference (pos);
+            break;
+        }
 
-        switch (c) {
-        case 'r': request = new Mreq (LOAD, addr, moduleID); break;
-        case 'w': request = new Mreq (STORE, addr, moduleID); break;
-        default:
-            fatal_error ("Processor %d: unknown operation - %c", moduleID.nodeID, c);
+        Mreq request (c == 'r' ? LOAD : STORE, addr, moduleID);
+        if (!my_cache->retire_hit (&request))
+        {
+            unread_reference (pos);
+            break;
         }
-        
-        my_cache->proc_request =  request;
-        outstanding_request = true;
+        hits++;
+
+        if (fetch_budget > 0)
+            fetch_budget--;
     }
+
+    return hits;
+}
+
+bool Processor::read_reference (char *c, paddr_t *addr)
+{
+    if (reader)
+        return reader->next (c, addr);
+
+    return fscanf (infile, "%c 0x%llx\n", c, (unsigned long long int*)addr) == 2;
+}
+
+/** Put back the reference just read, which started at pos in infile.  */
+void Processor::unread_reference (long pos)
+{
+    if (reader)
+        reader->unread ();
     else
-    {
-        end_of_trace = true;
-    }
+        fseek (infile, pos, SEEK_SET);
+}
+
+void Processor::restart ()
+{
+    task = run ();
+}
+
+void Processor::reopen_trace (long pos)
+{
+    fclose (infile);
+    infile = fopen (trace_file, "r");
+    if (infile == NULL || fseek (infile, pos, SEEK_SET) != 0)
+        fatal_error ("Processor %d: cannot reopen %s\n", moduleID.nodeID, trace_file);
+}
+
+void Processor::resume (long long budget)
+{
+    fetch_budget = budget;
+    paused = false;
 }
 
 void Processor::tock ()
@@ -77,6 +228,7 @@ void Processor::tock ()
 	{
 		inbound_request = inbound_request_buf;
 		inbound_request_buf = NULL;
+		Sim->schedule (PR_PHASE, moduleID.nodeID, Global_Clock + 1);
 	}
 }
 
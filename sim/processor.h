@@ -7,11 +7,13 @@
 #include "module.h"
 #include "mreq.h"
 #include "settings.h"
+#include "task.h"
 #include "types.h"
 
 using namespace std;
 
 class Hash_table;
+class Trace_reader;
 
 class Processor : public Module {
 public:
@@ -19,18 +21,51 @@ public:
 	~Processor();
 
     FILE *infile;
+    char *trace_file;
+
+    /** Where references come from instead of infile, when the traces are
+     *  shared with other simulations (see trace.h).  */
+    Trace_reader *reader;
     Hash_table *my_cache;
 
     bool end_of_trace;
     bool outstanding_request;
 
+    /** Hit fast path: retire runs of cache hits in one step, then sleep
+     *  until the cycle the last of them would have completed in.  */
+    bool fast_hits;
+    timestamp_t resume_time;
+
     Mreq * inbound_request;
     Mreq * inbound_request_buf;
 
+    /** References left to fetch before pausing, or negative for no limit.
+     *  A paused processor counts as done until resume () gives it more.  */
+    long long fetch_budget;
+    bool paused;
+
     bool done ();
+    bool is_idle ();
 
 	void tick ();
 	void tock ();
+
+    /** Start the program over from the state in the members above, after
+     *  they have been overwritten (rollback, checkpoint restore).  */
+    void restart ();
+
+    /** Open the trace afresh at offset pos, so the file offset is no
+     *  longer shared with a process this one was fork ()ed from.  */
+    void reopen_trace (long pos);
+
+    void resume (long long budget);
+
+private:
+    Sim_task task;
+    Sim_task run ();
+    int retire_hits ();
+    bool read_reference (char *c, paddr_t *addr);
+    void unread_reference (long pos);
 };
 
 #endif // PROCESSOR_H
@@ -0,0 +1,477 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "memory.h"
+#include "mreq.h"
+#include "processor.h"
+#include "replay.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+/***************
+ * Recording.
+ ***************/
+Bus_recorder::Bus_recorder (const char *path)
+{
+    this->path = path;
+    records = 0;
+    last_cycle = 0;
+    last_line = 0;
+
+    file = fopen (path, "wb");
+    if (file == NULL)
+        fatal_error ("Bus log %s: cannot open for writing\n", path);
+
+    fwrite (BUSLOG_MAGIC, 1, sizeof (BUSLOG_MAGIC), file);
+    put (BUSLOG_VERSION);
+    put (settings.num_nodes);
+    put (settings.protocol);
+    put (settings.cache_line_size_log2);
+}
+
+Bus_recorder::~Bus_recorder ()
+{
+    if (file)
+        fclose (file);
+}
+
+void Bus_recorder::put (uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        fputc ((int)(value & 0x7f) | 0x80, file);
+        value >>= 7;
+    }
+    fputc ((int)value, file);
+}
+
+void Bus_recorder::put_signed (int64_t value)
+{
+    put (((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void Bus_recorder::record (buslog_kind_t kind, int node, paddr_t addr, uint64_t extra)
+{
+    paddr_t line = addr >> settings.cache_line_size_log2;
+
+    put (Global_Clock - last_cycle);
+    put (kind | (node << 3));
+    put_signed (line - last_line);
+    if (kind != BUSLOG_UPGRADE)
+        put (extra);
+
+    last_cycle = Global_Clock;
+    last_line = line;
+    records++;
+}
+
+void Bus_recorder::issue (Mreq *request)
+{
+    record (BUSLOG_ISSUE, request->src_mid.nodeID, request->addr, request->msg);
+}
+
+void Bus_recorder::grant (Mreq *request)
+{
+    record (BUSLOG_GRANT, request->src_mid.nodeID, request->addr, request->msg);
+}
+
+void Bus_recorder::data (Mreq *request)
+{
+    record (BUSLOG_DATA, request->src_mid.nodeID, request->addr,
+            (request->dest_mid.nodeID << 1) | Sim->bus->shared_line);
+}
+
+void Bus_recorder::upgrade (int node, paddr_t addr)
+{
+    record (BUSLOG_UPGRADE, node, addr, 0);
+}
+
+long Bus_recorder::finish (void)
+{
+    long size;
+
+    put (Global_Clock - last_cycle);
+    put (BUSLOG_END);
+    for (int i = 0; i < settings.num_nodes; i++)
+        put (Sim->get_L1 (i)->stats.cache_accesses);
+    fwrite (BUSLOG_MAGIC, 1, sizeof (BUSLOG_MAGIC), file);
+
+    size = ftell (file);
+    fclose (file);
+    file = NULL;
+    return size;
+}
+
+/***************
+ * Replay.
+ ***************/
+Replayer::Replayer ()
+{
+    file = NULL;
+    path = NULL;
+    records = 0;
+    mismatches = 0;
+    snoop.kind = BUSLOG_END;
+    snooped = 0;
+}
+
+Replayer::~Replayer ()
+{
+    if (file)
+        fclose (file);
+
+    for (unsigned int i = 0; i < hooks.size (); i++)
+        delete hooks[i];
+}
+
+uint64_t Replayer::get (void)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    int c;
+
+    do
+    {
+        c = fgetc (file);
+        if (c == EOF || shift > 63)
+            fatal_error ("Bus log %s: truncated or corrupt\n", path);
+        value |= (uint64_t)(c & 0x7f) << shift;
+        shift += 7;
+    } while (c & 0x80);
+
+    return value;
+}
+
+int64_t Replayer::get_signed (void)
+{
+    uint64_t value = get ();
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/** False at the end record.  */
+bool Replayer::get_record (Bus_record &record, timestamp_t &cycle, paddr_t &line)
+{
+    uint64_t packed;
+
+    cycle += get ();
+    record.cycle = cycle;
+
+    packed = get ();
+    record.kind = (buslog_kind_t)(packed & 7);
+    record.node = packed >> 3;
+    if (record.kind == BUSLOG_END)
+        return false;
+
+    /** Only DATA comes from memory, which is node num_nodes.  */
+    if (record.kind > BUSLOG_END || packed >> 3 > (uint64_t)settings.num_nodes ||
+        (packed >> 3 == (uint64_t)settings.num_nodes && record.kind != BUSLOG_DATA))
+        fatal_error ("Bus log %s: corrupt record %lld\n", path, (long long int)records);
+
+    line += get_signed ();
+    record.addr = line << settings.cache_line_size_log2;
+    record.msg = NOP;
+    record.dest = -1;
+
+    record.shared = false;
+    if (record.kind == BUSLOG_DATA)
+    {
+        uint64_t extra = get ();
+
+        /** DATA goes to a cache, never to memory.  */
+        if (extra >> 1 >= (uint64_t)settings.num_nodes)
+            fatal_error ("Bus log %s: corrupt record %lld\n", path, (long long int)records);
+
+        record.dest = extra >> 1;
+        record.shared = extra & 1;
+    }
+    else if (record.kind != BUSLOG_UPGRADE)
+    {
+        record.msg = (message_t)get ();
+        if (record.msg >= MREQ_MESSAGE_NUM)
+            fatal_error ("Bus log %s: corrupt record %lld\n", path, (long long int)records);
+    }
+
+    return true;
+}
+
+void Replayer::run (const char *path)
+{
+    char magic[sizeof (BUSLOG_MAGIC)];
+    bool verbose = settings.verbose;
+    Bus_record record;
+    timestamp_t cycle = 0;
+    paddr_t line = 0;
+
+    this->path = path;
+    file = fopen (path, "rb");
+    if (file == NULL)
+        fatal_error ("Bus log %s: cannot open\n", path);
+
+    if (fread (magic, 1, sizeof (magic), file) != sizeof (magic) ||
+        memcmp (magic, BUSLOG_MAGIC, sizeof (magic)) != 0)
+        fatal_error ("Bus log %s: not a bus log\n", path);
+    if (get () != BUSLOG_VERSION)
+        fatal_error ("Bus log %s: unsupported version\n", path);
+    if (get () != (uint64_t)settings.num_nodes || get () != (uint64_t)settings.protocol ||
+        get () != (uint64_t)settings.cache_line_size_log2)
+        fatal_error ("Bus log %s: recorded with another configuration\n", path);
+
+    /** The protocols' log lines would all be out of context.  */
+    settings.verbose = false;
+
+    while (get_record (record, cycle, line))
+    {
+        Sim->global_clock = record.cycle;
+
+        /** Caches handle their processor request before they snoop, so
+         *  within its cycle, a grant is snooped by the nodes before the
+         *  one that next queues a request.  */
+        if (snoop.kind == BUSLOG_GRANT)
+        {
+            if (record.cycle == snoop.cycle &&
+                (record.kind == BUSLOG_ISSUE || record.kind == BUSLOG_UPGRADE))
+                snoop_until (record.node);
+            else
+                snoop_until (settings.num_nodes);
+        }
+
+        switch (record.kind) {
+        case BUSLOG_ISSUE:   issue (record); break;
+        case BUSLOG_GRANT:   grant (record); break;
+        case BUSLOG_DATA:    data (record); break;
+        case BUSLOG_UPGRADE: upgrade (record); break;
+        default: break;
+        }
+        records++;
+
+        for (unsigned int i = 0; i < hooks.size (); i++)
+            hooks[i]->event (record);
+    }
+    snoop_until (settings.num_nodes);
+
+    /** Hits never reach the bus: the log has their totals.  */
+    for (int i = 0; i < settings.num_nodes; i++)
+        Sim->get_L1 (i)->stats.cache_accesses = get ();
+
+    if (fread (magic, 1, sizeof (magic), file) != sizeof (magic) ||
+        memcmp (magic, BUSLOG_MAGIC, sizeof (magic)) != 0)
+        fatal_error ("Bus log %s: truncated\n", path);
+
+    fclose (file);
+    file = NULL;
+
+    settings.verbose = verbose;
+    Sim->global_clock = record.cycle;
+}
+
+/** Hand the cache the processor request that made it queue this one.  The
+ *  queue is made to hold what the log says whatever the protocol did.  */
+void Replayer::issue (Bus_record &record)
+{
+    Bus *bus = Sim->bus;
+    Processor *pr = Sim->get_PR (record.node);
+    Hash_table *cache = Sim->get_L1 (record.node);
+    Mreq request (record.msg == GETS ? LOAD : STORE, record.addr, pr->moduleID);
+    size_t queued = bus->pending_requests.size ();
+
+    cache->get_entry (record.addr)->process_request_processor (&request);
+
+    if (bus->pending_requests.size () != queued + 1 ||
+        bus->pending_requests.back ()->msg != record.msg ||
+        bus->pending_requests.back ()->addr != record.addr)
+    {
+        mismatches++;
+        while (bus->pending_requests.size () > queued)
+        {
+            delete bus->pending_requests.back ();
+            bus->pending_requests.pop_back ();
+        }
+        bus->pending_requests.push_back (new Mreq (record.msg, record.addr, cache->moduleID));
+    }
+
+    drop_reply (record.node);
+}
+
+void Replayer::grant (Bus_record &record)
+{
+    Bus *bus = Sim->bus;
+    Mreq *request;
+
+    if (bus->pending_requests.empty ())
+        fatal_error ("Bus log %s: grant of nothing at cycle %lld\n", path,
+                     (long long int)record.cycle);
+
+    request = bus->pending_requests.front ();
+    bus->pending_requests.pop_front ();
+    if (request->src_mid.nodeID != record.node || request->msg != record.msg ||
+        request->addr != record.addr)
+        mismatches++;
+
+    bus->shared_line = false;
+    bus->request_in_progress = true;
+    snoop = record;
+    snooped = 0;
+
+    delete request;
+}
+
+/** Let the caches from the last one to snoop the grant up to node, not
+ *  included, snoop it too.  */
+void Replayer::snoop_until (int node)
+{
+    for (; snooped < node; snooped++)
+    {
+        Mreq request (snoop.msg, snoop.addr, Sim->get_L1 (snoop.node)->moduleID);
+        Sim->get_L1 (snooped)->get_entry (request.addr)->process_request_snoop (&request);
+    }
+
+    if (snooped == settings.num_nodes)
+        snoop.kind = BUSLOG_END;
+}
+
+void Replayer::data (Bus_record &record)
+{
+    Bus *bus = Sim->bus;
+    Hash_table *dest = Sim->get_L1 (record.dest);
+    ModuleID src;
+
+    if (record.node == settings.num_nodes)
+        src = Sim->get_MC (settings.num_nodes)->moduleID;
+    else
+        src = Sim->get_L1 (record.node)->moduleID;
+
+    if (bus->data_reply ? bus->data_reply->src_mid.nodeID != record.node
+                        : record.node != settings.num_nodes)
+        mismatches++;
+
+    if (bus->data_reply)
+    {
+        delete bus->data_reply;
+        bus->data_reply = NULL;
+    }
+    bus->request_in_progress = false;
+
+    /** Processor hits may assert the shared line as well as snoops, and
+     *  those are not in the log.  */
+    bus->shared_line = record.shared;
+
+    Mreq reply (DATA, record.addr, src, dest->moduleID);
+    dest->get_entry (record.addr)->process_request_snoop (&reply);
+    drop_reply (record.dest);
+}
+
+/** What the cache answered the processor with: nobody waits for it.  */
+void Replayer::drop_reply (int node)
+{
+    Processor *pr = Sim->get_PR (node);
+
+    if (pr->inbound_request_buf)
+    {
+        delete pr->inbound_request_buf;
+        pr->inbound_request_buf = NULL;
+    }
+}
+
+void Replayer::upgrade (Bus_record &record)
+{
+    Bus *bus = Sim->bus;
+    Mreq request (STORE, record.addr, Sim->get_PR (record.node)->moduleID);
+    size_t queued = bus->pending_requests.size ();
+
+    Sim->get_L1 (record.node)->get_entry (record.addr)->process_request_processor (&request);
+
+    if (bus->pending_requests.size () != queued)
+    {
+        mismatches++;
+        while (bus->pending_requests.size () > queued)
+        {
+            delete bus->pending_requests.back ();
+            bus->pending_requests.pop_back ();
+        }
+    }
+
+    drop_reply (record.node);
+}
+
+/***************
+ * Analysis.
+ ***************/
+Bus_traffic::Bus_traffic ()
+{
+    Node_traffic zero;
+
+    memset (&zero, 0, sizeof (zero));
+    nodes.resize (settings.num_nodes, zero);
+}
+
+/** A processor has one request outstanding at most, so a node's grant is
+ *  always for the last request it queued.  */
+void Bus_traffic::event (Bus_record &record)
+{
+    switch (record.kind) {
+    case BUSLOG_ISSUE:
+        nodes[record.node].issued = record.cycle;
+        break;
+
+    case BUSLOG_GRANT:
+    {
+        Node_traffic &n = nodes[record.node];
+        timestamp_t wait = record.cycle - n.issued;
+
+        if (record.msg == GETS)
+            n.gets++;
+        else
+            n.getm++;
+        n.wait_cycles += wait;
+        n.max_wait = max (n.max_wait, wait);
+        break;
+    }
+
+    case BUSLOG_DATA:
+        if (record.node == settings.num_nodes)
+            nodes[record.dest].memory_fills++;
+        else
+            nodes[record.dest].cache_fills++;
+        break;
+
+    case BUSLOG_UPGRADE:
+        nodes[record.node].upgrades++;
+        break;
+
+    default:
+        break;
+    }
+}
+
+void Bus_traffic::report (void)
+{
+    fprintf (stdout, "%6s %8s %8s %8s %8s %8s %10s %10s\n", "Node", "GETS", "GETM",
+             "$-to-$", "Memory", "Upgrades", "Avg Wait", "Max Wait");
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Node_traffic &n = nodes[i];
+        counter_t grants = n.gets + n.getm;
+
+        fprintf (stdout, "%6d %8lld %8lld %8lld %8lld %8lld %10.1f %10lld\n", i,
+                 (long long int)n.gets, (long long int)n.getm,
+                 (long long int)n.cache_fills, (long long int)n.memory_fills,
+                 (long long int)n.upgrades, grants ? (double)n.wait_cycles / grants : 0.0,
+                 (long long int)n.max_wait);
+    }
+}
+
+void Replayer::report (void)
+{
+    fprintf (stdout, "\nReplayed %lld bus log records from %s: %lld mismatches\n",
+             (long long int)records, settings.replay_file, (long long int)mismatches);
+
+    for (unsigned int i = 0; i < hooks.size (); i++)
+        hooks[i]->report ();
+}
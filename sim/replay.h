@@ -0,0 +1,155 @@
+#ifndef REPLAY_H_
+#define REPLAY_H_
+
+#include <stdio.h>
+
+#include "types.h"
+#include "../protocols/messages.h"
+
+using namespace std;
+
+class Mreq;
+
+#define BUSLOG_MAGIC    "CSXBLOG"
+#define BUSLOG_VERSION  1
+
+/** What a bus log record stands for.  */
+typedef enum {
+    BUSLOG_ISSUE = 0,   /** A cache queued a request for the bus.  */
+    BUSLOG_GRANT,       /** The bus granted it.  */
+    BUSLOG_DATA,        /** DATA answering it went on the bus.  */
+    BUSLOG_UPGRADE,     /** A store hit changed a line's state without the bus.  */
+    BUSLOG_END          /** End of the run.  */
+} buslog_kind_t;
+
+class Bus_record {
+public:
+    buslog_kind_t kind;
+    timestamp_t cycle;
+
+    /** Requester, or sender for DATA (num_nodes for memory).  */
+    int node;
+    int dest;
+    bool shared;
+    message_t msg;
+    paddr_t addr;
+};
+
+/**
+ * Writes the order of events on the bus during a run to a file, for
+ * Replayer to go over again later.
+ *
+ * The file starts with a magic string, a format version, and the
+ * configuration it was recorded with.  Then come the records as unsigned
+ * LEB128 varints: the cycle as a delta from the last record, the kind and
+ * node packed together, the line as a zigzag coded delta from the last
+ * record's, and the message, or the destination and shared line for
+ * DATA.  The final record holds the accesses of every cache, which never
+ * reach the bus, and a trailing magic string guards against truncation.
+ */
+class Bus_recorder {
+public:
+    Bus_recorder (const char *path);
+    ~Bus_recorder ();
+
+    void issue (Mreq *request);
+    void grant (Mreq *request);
+    void data (Mreq *request);
+    void upgrade (int node, paddr_t addr);
+
+    /** Returns the size of the file written.  */
+    long finish (void);
+
+    counter_t records;
+
+private:
+    FILE *file;
+    const char *path;
+    timestamp_t last_cycle;
+    paddr_t last_line;
+
+    void put (uint64_t value);
+    void put_signed (int64_t value);
+    void record (buslog_kind_t kind, int node, paddr_t addr, uint64_t extra);
+};
+
+/** Analysis run on every record of a replay.  */
+class Replay_hook {
+public:
+    virtual ~Replay_hook () {}
+    virtual void event (Bus_record &record) = 0;
+    virtual void report (void) {}
+};
+
+/** Bus traffic per node, and how long requests waited to be granted.  */
+class Bus_traffic : public Replay_hook {
+public:
+    Bus_traffic ();
+
+    void event (Bus_record &record);
+    void report (void);
+
+private:
+    class Node_traffic {
+    public:
+        counter_t gets;
+        counter_t getm;
+        counter_t cache_fills;
+        counter_t memory_fills;
+        counter_t upgrades;
+        counter_t wait_cycles;
+        timestamp_t max_wait;
+        timestamp_t issued;
+    };
+
+    VECTOR<Node_traffic> nodes;
+};
+
+/**
+ * Drives the protocol state machines of the caches again from a bus log,
+ * with no trace parsing, arbitration or memory controller timing.  Every
+ * queued request is handed to its cache as the processor request that
+ * raised it, every grant is snooped by all caches, and every DATA is
+ * delivered to its destination, in the recorded order and at the recorded
+ * cycle, interleaved with the queued requests just as the caches would.
+ * What the protocols send in the process is checked against the log,
+ * which stays authoritative.
+ *
+ * The hooks see every record as it is replayed, after the caches have.
+ */
+class Replayer {
+public:
+    Replayer ();
+    ~Replayer ();
+
+    VECTOR<Replay_hook *> hooks;
+
+    /** Leaves the clock at the end of the recorded run.  */
+    void run (const char *path);
+    void report (void);
+
+    counter_t records;
+    counter_t mismatches;
+
+private:
+    FILE *file;
+    const char *path;
+
+    /** The grant the caches are snooping, if its kind is still GRANT, and
+     *  how many of them have.  */
+    Bus_record snoop;
+    int snooped;
+
+    uint64_t get (void);
+    int64_t get_signed (void);
+    bool get_record (Bus_record &record, timestamp_t &cycle, paddr_t &line);
+
+    void issue (Bus_record &record);
+    void grant (Bus_record &record);
+    void data (Bus_record &record);
+    void upgrade (Bus_record &record);
+    void drop_reply (int node);
+    void snoop_until (int node);
+};
+
+#endif /* REPLAY_H_ */
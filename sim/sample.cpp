@@ -0,0 +1,244 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "hash_table.h"
+#include "memory.h"
+#include "processor.h"
+#include "sample.h"
+#include "settings.h"
+#include "sim.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Sampler::Sampler ()
+{
+    windows = 0;
+    detailed_references = 0;
+    functional_references = 0;
+    detailed_cycles = 0;
+    measuring = false;
+    measured = false;
+    measure_cycle = 0;
+    window_accesses.resize (settings.num_nodes);
+}
+
+Sampler::~Sampler ()
+{
+}
+
+void Sampler::run (void)
+{
+    counter_t window = settings.sample_warmup + settings.sample_size;
+
+    while (!traces_ended ())
+    {
+        timestamp_t start = Sim->global_clock;
+        counter_t accesses = 0;
+
+        for (int i = 0; i < settings.num_nodes; i++)
+        {
+            window_accesses[i] = Sim->get_L1 (i)->stats.cache_accesses;
+            accesses += window_accesses[i];
+            Sim->get_PR (i)->resume (window);
+        }
+        measuring = false;
+        measured = false;
+
+        Sim->run_engine ();
+
+        Sim->collect_stats ();
+        windows++;
+        detailed_references += Sim->stats.cache_accesses - accesses;
+        detailed_cycles += Sim->global_clock - start;
+        end_window ();
+
+        fast_forward ();
+    }
+
+    summarize ();
+
+    /** What dump_stats () prints: the counters already cover every
+     *  reference, detailed or not.  */
+    Sim->global_clock = (timestamp_t)(mean.cycles *
+                                      (detailed_references + functional_references) + 0.5);
+}
+
+bool Sampler::traces_ended (void)
+{
+    for (int i = 0; i < settings.num_nodes; i++)
+        if (!Sim->get_PR (i)->end_of_trace)
+            return false;
+    return true;
+}
+
+void Sampler::check (void)
+{
+    if (measured)
+        return;
+
+    /** Once a core has stopped, the others run on an emptier bus.  */
+    if (measuring)
+    {
+        for (int i = 0; i < settings.num_nodes; i++)
+            if (Sim->get_PR (i)->paused)
+            {
+                stop_measuring ();
+                return;
+            }
+        return;
+    }
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        Processor *pr = Sim->get_PR (i);
+
+        if (!pr->done () &&
+            Sim->get_L1 (i)->stats.cache_accesses - window_accesses[i] <
+            (counter_t)settings.sample_warmup)
+            return;
+    }
+
+    measuring = true;
+    measure_cycle = Sim->global_clock;
+    Sim->collect_stats ();
+    measure_stats = Sim->stats;
+}
+
+/** Turn what was measured into a sample.  A window cut short by the end of
+ *  the traces may have measured nothing.  */
+void Sampler::stop_measuring (void)
+{
+    Sample sample;
+    Sim_stats delta;
+    double references;
+
+    measured = true;
+
+    Sim->collect_stats ();
+    delta = Sim->stats;
+    delta -= measure_stats;
+    if (delta.cache_accesses == 0)
+        return;
+
+    references = delta.cache_accesses;
+    sample.cycles = (Sim->global_clock - measure_cycle) / references;
+    sample.misses = delta.cache_misses / references;
+    sample.upgrades = delta.silent_upgrades / references;
+    sample.transfers = delta.cache_to_cache_transfers / references;
+    samples.push_back (sample);
+}
+
+void Sampler::end_window (void)
+{
+    Bus *bus = Sim->bus;
+
+    if (bus->request_in_progress || !bus->pending_requests.empty () || bus->data_reply ||
+        Sim->get_MC (settings.num_nodes)->request_in_progress)
+        fatal_error ("Sampling: the bus is still busy at the end of a window, cycle %lld\n",
+                     (long long int)Sim->global_clock);
+
+    if (measuring && !measured)
+        stop_measuring ();
+}
+
+void Sampler::fast_forward (void)
+{
+    VECTOR<FILE *> traces (settings.num_nodes);
+    long long skip = settings.sampling_interval - settings.sample_warmup - settings.sample_size;
+
+    if (skip <= 0)
+        return;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        traces[i] = Sim->get_PR (i)->infile;
+
+    functional_references += model.run (traces, skip);
+}
+
+/** Mean over the samples, and the half width of its confidence interval.  */
+void Sampler::summarize (void)
+{
+    double n = samples.size ();
+    Sample sum = {0, 0, 0, 0};
+    Sample squares = {0, 0, 0, 0};
+
+    for (unsigned int i = 0; i < samples.size (); i++)
+    {
+        Sample &s = samples[i];
+
+        sum.cycles += s.cycles;
+        sum.misses += s.misses;
+        sum.upgrades += s.upgrades;
+        sum.transfers += s.transfers;
+        squares.cycles += s.cycles * s.cycles;
+        squares.misses += s.misses * s.misses;
+        squares.upgrades += s.upgrades * s.upgrades;
+        squares.transfers += s.transfers * s.transfers;
+    }
+
+    mean = sum;
+    error.cycles = error.misses = error.upgrades = error.transfers = 0;
+
+    /** Traces too short for a window to get past its warmup: go by all
+     *  the detailed cycles, and the counters, which are exact anyway.  */
+    if (n == 0)
+    {
+        double references = detailed_references + functional_references;
+
+        Sim->collect_stats ();
+        if (detailed_references)
+            mean.cycles = (double)detailed_cycles / detailed_references;
+        if (references)
+        {
+            mean.misses = Sim->stats.cache_misses / references;
+            mean.upgrades = Sim->stats.silent_upgrades / references;
+            mean.transfers = Sim->stats.cache_to_cache_transfers / references;
+        }
+        return;
+    }
+
+    mean.cycles /= n;
+    mean.misses /= n;
+    mean.upgrades /= n;
+    mean.transfers /= n;
+    if (n < 2)
+        return;
+
+    /** Sample variance, from the sums; clamped for rounding.  */
+    error.cycles = SAMPLE_Z * sqrt (fmax (0, (squares.cycles - n * mean.cycles * mean.cycles) / (n - 1)) / n);
+    error.misses = SAMPLE_Z * sqrt (fmax (0, (squares.misses - n * mean.misses * mean.misses) / (n - 1)) / n);
+    error.upgrades = SAMPLE_Z * sqrt (fmax (0, (squares.upgrades - n * mean.upgrades * mean.upgrades) / (n - 1)) / n);
+    error.transfers = SAMPLE_Z * sqrt (fmax (0, (squares.transfers - n * mean.transfers * mean.transfers) / (n - 1)) / n);
+}
+
+static void report_line (const char *name, double per_reference, double error, double references)
+{
+    if (error == 0 || per_reference == 0)
+        fprintf (stdout, "%-18s %12.0f\n", name, per_reference * references);
+    else
+        fprintf (stdout, "%-18s %12.0f   +/- %5.1f%%\n", name, per_reference * references,
+                 100.0 * error / per_reference);
+}
+
+void Sampler::report (void)
+{
+    double references = detailed_references + functional_references;
+
+    fprintf (stdout, "\nSampled %lld references per core every %lld, after %lld of detailed warmup:\n",
+             (long long int)settings.sample_size, (long long int)settings.sampling_interval,
+             (long long int)settings.sample_warmup);
+    fprintf (stdout, "%-18s %12s   %d%% confidence\n", "", "Estimate", SAMPLE_CONFIDENCE);
+    report_line ("Run Time:", mean.cycles, error.cycles, references);
+    report_line ("Cache Misses:", mean.misses, error.misses, references);
+    report_line ("Silent Upgrades:", mean.upgrades, error.upgrades, references);
+    report_line ("$-to-$ Transfers:", mean.transfers, error.transfers, references);
+    fprintf (stdout, "Samples:           %12lld of %lld windows\n",
+             (long long int)samples.size (), (long long int)windows);
+    fprintf (stdout, "Detailed:          %12lld of %.0f references (%.1f%%), %lld cycles\n",
+             (long long int)detailed_references, references,
+             references ? 100.0 * detailed_references / references : 0.0,
+             (long long int)detailed_cycles);
+}
@@ -0,0 +1,82 @@
+#ifndef SAMPLE_H_
+#define SAMPLE_H_
+
+#include "functional.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/** Standard normal quantile for the reported confidence intervals.  */
+#define SAMPLE_CONFIDENCE   95
+#define SAMPLE_Z            1.96
+
+/**
+ * Systematic sampling of a run, after SMARTS.
+ *
+ * Every sampling_interval references per core, the processors run for a
+ * short window under the detailed engine: sample_warmup references each to
+ * get the bus and the memory controller back into a typical state, then
+ * sample_size references that are measured, up to the point where the
+ * first core has run out of them.  At the end of a window the
+ * processors stop fetching and everything they have in flight drains, and
+ * the rest of the interval is played through the functional model, which
+ * keeps the caches and protocol states warm at a fraction of the cost.
+ *
+ * Each window yields the cycles, misses, silent upgrades and cache to cache
+ * transfers per reference over all cores.  Their means, times the number of
+ * references in the traces, estimate the totals of a full detailed run,
+ * and their spread over the windows gives a confidence interval for each.
+ */
+class Sampler {
+public:
+    Sampler ();
+    ~Sampler ();
+
+    /** Runs the simulation in place of the engine, leaving the clock at
+     *  the estimated run time.  */
+    void run (void);
+
+    /** Call at the start of a cycle, before the bus ticks.  Starts the
+     *  measurement once every core is past its detailed warmup, and stops
+     *  it as soon as one core has finished its window.  */
+    void check (void);
+
+    /** Statistics.  */
+    counter_t windows;
+    counter_t detailed_references;
+    counter_t functional_references;
+    timestamp_t detailed_cycles;
+    void report (void);
+
+private:
+    class Sample {
+    public:
+        double cycles;
+        double misses;
+        double upgrades;
+        double transfers;
+    };
+
+    Functional_model model;
+    VECTOR<Sample> samples;
+
+    /** The current window.  */
+    bool measuring;
+    bool measured;
+    timestamp_t measure_cycle;
+    Sim_stats measure_stats;
+    VECTOR<counter_t> window_accesses;
+
+    /** Results, set by run ().  */
+    Sample mean;
+    Sample error;
+
+    bool traces_ended (void);
+    void stop_measuring (void);
+    void end_window (void);
+    void fast_forward (void);
+    void summarize (void);
+};
+
+#endif /* SAMPLE_H_ */
@@ -0,0 +1,125 @@
+#include <assert.h>
+
+#include "scheduler.h"
+
+using namespace std;
+
+Scheduler::Scheduler ()
+{
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        slots[i].time = 0;
+        slots[i].count = 0;
+    }
+    now = 0;
+    num_events = 0;
+}
+
+Scheduler::~Scheduler ()
+{
+}
+
+void Scheduler::schedule (phase_t phase, int nodeID, timestamp_t when)
+{
+    assert (when >= now && "Scheduler: event scheduled in the past");
+
+    if (when - now < WHEEL_SLOTS)
+        insert (phase, nodeID, when);
+    else
+        overflow[when].push_back (pair<phase_t, int>(phase, nodeID));
+
+    num_events++;
+}
+
+void Scheduler::insert (phase_t phase, int nodeID, timestamp_t when)
+{
+    Slot *slot = &slots[when % WHEEL_SLOTS];
+
+    /** The wheel spans less than one revolution, so a busy slot can only
+     *  belong to the same cycle.  */
+    assert (slot->count == 0 || slot->time == when);
+
+    slot->time = when;
+    slot->nodes[phase].push_back (nodeID);
+    slot->count++;
+}
+
+/** Move the wheel forward to cycle when and pull in overflow events that
+ *  now fall inside it.  */
+void Scheduler::advance (timestamp_t when)
+{
+    assert (when >= now);
+    now = when;
+
+    while (!overflow.empty () && overflow.begin ()->first - now < WHEEL_SLOTS)
+    {
+        VECTOR<pair<phase_t, int> > &events = overflow.begin ()->second;
+
+        for (unsigned int i = 0; i < events.size (); i++)
+            insert (events[i].first, events[i].second, overflow.begin ()->first);
+        overflow.erase (overflow.begin ());
+    }
+}
+
+timestamp_t Scheduler::next_time (void)
+{
+    assert (!empty ());
+
+    for (timestamp_t t = now; t < now + WHEEL_SLOTS; t++)
+    {
+        Slot *slot = &slots[t % WHEEL_SLOTS];
+        if (slot->count && slot->time == t)
+            return t;
+    }
+
+    assert (!overflow.empty ());
+    return overflow.begin ()->first;
+}
+
+void Scheduler::pop (timestamp_t when, phase_t phase, VECTOR<int> &nodes)
+{
+    Slot *slot;
+
+    advance (when);
+
+    nodes.clear ();
+    slot = &slots[when % WHEEL_SLOTS];
+    if (slot->count == 0 || slot->time != when)
+        return;
+
+    nodes.swap (slot->nodes[phase]);
+    slot->count -= nodes.size ();
+    num_events -= nodes.size ();
+
+    sort (nodes.begin (), nodes.end ());
+    nodes.erase (unique (nodes.begin (), nodes.end ()), nodes.end ());
+}
+
+void Scheduler::shift (timestamp_t delta)
+{
+    VECTOR<pair<timestamp_t, pair<phase_t, int> > > events;
+    MAP<timestamp_t, VECTOR<pair<phase_t, int> > >::iterator it;
+
+    for (int i = 0; i < WHEEL_SLOTS; i++)
+    {
+        Slot *slot = &slots[i];
+
+        for (int phase = 0; phase < NUM_PHASES; phase++)
+        {
+            for (unsigned int j = 0; j < slot->nodes[phase].size (); j++)
+                events.push_back (make_pair (slot->time, make_pair ((phase_t)phase, slot->nodes[phase][j])));
+            slot->nodes[phase].clear ();
+        }
+        slot->count = 0;
+    }
+
+    for (it = overflow.begin (); it != overflow.end (); it++)
+        for (unsigned int j = 0; j < it->second.size (); j++)
+            events.push_back (make_pair (it->first, it->second[j]));
+    overflow.clear ();
+
+    now += delta;
+    num_events = 0;
+    for (unsigned int i = 0; i < events.size (); i++)
+        schedule (events[i].second.first, events[i].second.second, events[i].first + delta);
+}
@@ -0,0 +1,66 @@
+#ifndef SCHEDULER_H_
+#define SCHEDULER_H_
+
+#include "types.h"
+
+using namespace std;
+
+/** Phases of a simulated cycle, in the order they execute.  Must match the
+ *  order of the tick/tock loops in Simulator::run_tick ().  */
+typedef enum {
+    BUS_PHASE = 0,
+    CACHE_PHASE,
+    PR_PHASE,
+    MC_PHASE,
+    TOCK_PHASE,
+    NUM_PHASES
+} phase_t;
+
+/** Number of cycles covered by the timing wheel.  Events further out than
+ *  this wait in the overflow map until the wheel catches up with them.  */
+#define WHEEL_SLOTS 256
+
+/**
+ * Timing wheel of module wakeups for the event-driven engine.  Each slot
+ * holds, per phase, the nodes that asked to run in that cycle.
+ */
+class Scheduler {
+public:
+    Scheduler ();
+    ~Scheduler ();
+
+    /** Ask for nodeID's module of the given phase to run at cycle when.  */
+    void schedule (phase_t phase, int nodeID, timestamp_t when);
+
+    bool empty (void) { return num_events == 0; }
+
+    /** Earliest cycle holding an event.  Only valid if !empty ().  */
+    timestamp_t next_time (void);
+
+    /** Remove the events of one phase of cycle when (which must be the
+     *  earliest pending cycle), returned in node order without duplicates.  */
+    void pop (timestamp_t when, phase_t phase, VECTOR<int> &nodes);
+
+    /** Move the wheel and every pending event delta cycles later.  */
+    void shift (timestamp_t delta);
+
+private:
+    class Slot {
+    public:
+        timestamp_t time;
+        int count;
+        VECTOR<int> nodes[NUM_PHASES];
+    };
+
+    Slot slots[WHEEL_SLOTS];
+    MAP<timestamp_t, VECTOR<pair<phase_t, int> > > overflow;
+
+    /** Earliest cycle the wheel may still hold events for.  */
+    timestamp_t now;
+    long int num_events;
+
+    void insert (phase_t phase, int nodeID, timestamp_t when);
+    void advance (timestamp_t when);
+};
+
+#endif /* SCHEDULER_H_ */
@@ -0,0 +1,142 @@
+#include <math.h>
+#include <stdio.h>
+
+#include "seeds.h"
+#include "sim.h"
+#include "thread_pool.h"
+
+using namespace std;
+
+/** Two-sided 95% quantiles of Student's t, by degrees of freedom.  */
+static const double t_95[] = {0, 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                              2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110,
+                              2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064, 2.060, 2.056,
+                              2.052, 2.048, 2.045, 2.042};
+
+#define T_95_ENTRIES    31
+
+static double t_quantile (int df)
+{
+    if (df < T_95_ENTRIES)
+        return t_95[df];
+
+    /** Within a thousandth of the table from there on.  */
+    return 1.960 + 2.5 / df;
+}
+
+Seeds::Seeds (Sim_settings &base, const char *trace_dir, int count)
+{
+    if (count < 1)
+        fatal_error ("Seeds: invalid number of seeds %d\n", count);
+
+    /** Leave out the seed, which plain_run () minds.  */
+    Sim_settings config = base;
+    config.jitter_seed = 0;
+    if (!config.plain_run ())
+        fatal_error ("Seeds run plain simulations only\n");
+
+    if (base.engine == OPTIMISTIC_ENGINE)
+        fatal_error ("Jitter needs a synchronous engine\n");
+
+    config.verbose = false;
+    config.num_threads = 1;
+    for (int i = 0; i < count; i++)
+    {
+        config.jitter_seed = i + 1;
+        simulations.push_back (new Simulation (config, trace_dir));
+    }
+
+    /** The seeds run at any pace, so the trace stays decoded in full.  */
+    source = new Trace_source (trace_dir, simulations[0]->config.num_nodes, 0);
+    for (int i = 0; i < count; i++)
+    {
+        simulations[i]->config.trace_source = source;
+        simulations[i]->config.trace_instance = 0;
+    }
+
+    results.resize (count);
+    num_threads = base.num_threads;
+}
+
+Seeds::~Seeds ()
+{
+    for (unsigned int i = 0; i < simulations.size (); i++)
+        delete simulations[i];
+    delete source;
+}
+
+void Seeds::run (void)
+{
+    VECTOR<int> seeds;
+
+    for (unsigned int i = 0; i < simulations.size (); i++)
+        seeds.push_back (i);
+
+    Job_pool pool (min ((int)seeds.size (), num_threads));
+    pool.run (seeds, run_worker, this);
+
+    report ();
+}
+
+void Seeds::run_worker (int seed, void *arg)
+{
+    Seeds *seeds = (Seeds *)arg;
+
+    seeds->simulations[seed]->log = Simulation::discard ();
+    seeds->results[seed] = seeds->simulations[seed]->run ();
+}
+
+void Seeds::report_line (const char *name, VECTOR<double> &values)
+{
+    int n = values.size ();
+    double mean = 0, variance = 0, low = values[0], high = values[0];
+
+    for (int i = 0; i < n; i++)
+    {
+        mean += values[i];
+        low = min (low, values[i]);
+        high = max (high, values[i]);
+    }
+    mean /= n;
+
+    /** One run says nothing about the spread.  */
+    if (n < 2)
+    {
+        fprintf (stdout, "%-18s %12.1f %10s %12s %12s %10.0f %10.0f\n", name, mean,
+                 "-", "-", "-", low, high);
+        return;
+    }
+
+    for (int i = 0; i < n; i++)
+        variance += (values[i] - mean) * (values[i] - mean);
+    variance /= n - 1;
+
+    double deviation = sqrt (variance);
+    double half = t_quantile (n - 1) * deviation / sqrt (n);
+
+    fprintf (stdout, "%-18s %12.1f %10.1f %12.1f %12.1f %10.0f %10.0f\n", name, mean,
+             deviation, mean - half, mean + half, low, high);
+}
+
+void Seeds::report (void)
+{
+    Sim_settings &config = simulations[0]->config;
+    int n = results.size ();
+    VECTOR<double> run_time (n), misses (n), transfers (n);
+
+    for (int i = 0; i < n; i++)
+    {
+        run_time[i] = results[i].run_time;
+        misses[i] = results[i].stats.cache_misses;
+        transfers[i] = results[i].stats.cache_to_cache_transfers;
+    }
+
+    fprintf (stdout, "\nJitter over %d seed%s of %s, %s: random arbitration, "
+             "memory latency %d +- %d cycles\n", n, n == 1 ? "" : "s", config.trace_dir,
+             protocol_name (config.protocol), config.mem_hit_time, config.jitter_cycles);
+    fprintf (stdout, "%-18s %12s %10s %12s %12s %10s %10s\n", "", "Mean", "Std Dev",
+             "95% CI Low", "95% CI High", "Min", "Max");
+    report_line ("Run Time", run_time);
+    report_line ("Cache Misses", misses);
+    report_line ("$-to-$ Transfers", transfers);
+}
@@ -0,0 +1,42 @@
+#ifndef SEEDS_H_
+#define SEEDS_H_
+
+#include "settings.h"
+#include "simulation.h"
+#include "stats.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Runs a simulation under jitter once for each of the seeds 1 to count,
+ * num_threads at a time, and reports how far run time, misses and
+ * cache-to-cache transfers move: their mean, standard deviation, and 95%
+ * confidence interval for the mean.  A single seed has no spread to
+ * report, so those columns show "-".
+ *
+ * Every seed is a simulation (see simulation.h) of its own, on a trace
+ * decoded once for all of them (see trace.h).  Any one of them can be run
+ * again, with its log, with -o jitter_seed=<seed>.
+ */
+class Seeds {
+public:
+    Seeds (Sim_settings &base, const char *trace_dir, int count);
+    ~Seeds ();
+
+    /** Runs them all, then reports to stdout.  */
+    void run (void);
+
+private:
+    VECTOR<Simulation *> simulations;
+    VECTOR<Sim_result> results;
+    Trace_source *source;
+    int num_threads;
+
+    static void run_worker (int seed, void *arg);
+    void report (void);
+    void report_line (const char *name, VECTOR<double> &values);
+};
+
+#endif /* SEEDS_H_ */
@@ -8,7 +8,7 @@
 #include "settings.h"
 #include "enums.h"
 
-extern Sim_settings settings;
+extern thread_local Sim_settings settings;
 extern FILE * yyin;
 
 //TODO: this needs to be called to reclaim space allocated by flex, but yylex_destroy() doesn't exist
@@ -16,7 +16,7 @@ extern FILE * yyin;
 // and our macs has v.2.5.35
 //extern int yylex_destroy();
 
-extern Simulator Sim;
+extern thread_local Simulator *Sim;
 
 // Possible identifiers for config file
 setts identifiers [] = {
@@ -32,6 +32,7 @@ setts identifiers [] = {
     /** Memory controller.  */
     {"num_mem_ctrls",           &(settings.num_mem_ctrls)         },
     {"mem_ctrl_array",          &(settings.mem_ctrl_array)        },
+    {"mem_hit_time",            &(settings.mem_hit_time)          },
 
 	{"heartrate",               &(settings.heartrate)             },
 	{"net_infinite_bw",		   	&(settings.net_infinite_bw)       },
@@ -77,6 +78,7 @@ setts identifiers [] = {
 	{"l1_replacement_policy",  	&(settings.l1_replacement_policy) },
 	{"l1_lookup_time",		   	&(settings.l1_lookup_time)        },
 	{"l1_infinite",		   	    &(settings.l1_infinite)           },
+	{"l1_lru_check",		   	&(settings.l1_lru_check)          },
 
     /** L2 cache.  */
     {"l2_cache_type",           &(settings.l2_cache_type)         },
@@ -145,26 +147,190 @@ setts identifiers [] = {
 
 	/** Sampling Rate for statistics that are collected in intervals (i.e. avg sharer stat **/
 	{"sampling_interval",		&(settings.sampling_interval)	  },
+	{"sample_size",		        &(settings.sample_size)	          },
+	{"sample_warmup",		    &(settings.sample_warmup)	      },
+	{"simpoint_interval",		&(settings.simpoint_interval)	  },
+	{"simpoint_clusters",		&(settings.simpoint_clusters)	  },
 
     /** Invalid.  */
     {"end",						NULL                                  }
 };
 
+/** Settings a variant may change in the middle of a run (see branch.h).
+ *  All are ints that the simulator rereads in apply_settings ().  */
+setts tunables [] = {
+    {"mem_hit_time",            &(settings.mem_hit_time)          },
+    {"jitter_seed",             &(settings.jitter_seed)           },
+    {"jitter_cycles",           &(settings.jitter_cycles)         },
+
+    /** Invalid.  */
+    {"end",                     NULL                              }
+};
+
+/** Settings that only take effect when a run starts, as they shape the
+ *  caches it builds.  Ints too.  */
+setts presets [] = {
+    {"l1_cache_size",           &(settings.l1_cache_size)         },
+    {"l1_cache_assoc",          &(settings.l1_cache_assoc)        },
+    {"l1_infinite",             &(settings.l1_infinite)           },
+    {"l1_lru_check",            &(settings.l1_lru_check)          },
+    {"cache_line_size_log2",    &(settings.cache_line_size_log2)  },
+
+    /** Invalid.  */
+    {"end",                     NULL                              }
+};
+
+/** The tables are filled in with the settings of the thread that starts the
+ *  program; every thread has its own (see simulation.h).  */
+static Sim_settings *table_settings = &settings;
+
 Sim_settings::Sim_settings (void)
 {
-    mem_ctrl_array = NULL;
+    set_defaults ();
 }
 
 Sim_settings::~Sim_settings (void)
 {
-    if (mem_ctrl_array)
-        delete [] mem_ctrl_array;
-
     //TODO: reenable this after we get a newer version of flex on pasta?
     //free resources claimed by flex
     //yylex_destroy();
 }
 
+/** Apply "name=value[,name=value...]" over the tunable settings, and with
+ *  at_start over the presets as well.  Returns false, having changed
+ *  nothing, if any name or value is invalid; with apply false, only
+ *  checks.  */
+bool Sim_settings::apply_override (const char *spec, bool apply, bool at_start)
+{
+    char *copy = strdup (spec);
+    char *item, *save = NULL;
+    VECTOR<pair<int *, int> > changes;
+    bool ok = true;
+
+    for (item = strtok_r (copy, ",", &save); item && ok; item = strtok_r (NULL, ",", &save))
+    {
+        char *value = strchr (item, '=');
+        char *end;
+        int i;
+
+        if (value == NULL)
+        {
+            ok = false;
+            break;
+        }
+        *value++ = '\0';
+
+        setts *table = tunables;
+        for (i = 0; table[i].pointer; i++)
+            if (!strcmp (table[i].name, item))
+                break;
+
+        if (table[i].pointer == NULL && at_start)
+        {
+            table = presets;
+            for (i = 0; table[i].pointer; i++)
+                if (!strcmp (table[i].name, item))
+                    break;
+        }
+
+        long n = strtol (value, &end, 0);
+        if (table[i].pointer == NULL || *value == '\0' || *end != '\0')
+        {
+            ok = false;
+            break;
+        }
+
+        /** Find the member the table points to in this instance.  */
+        changes.push_back (make_pair ((int *)((char *)this + ((char *)table[i].pointer -
+                                                              (char *)table_settings)), (int)n));
+    }
+    free (copy);
+
+    if (ok && apply)
+    {
+        for (unsigned int i = 0; i < changes.size (); i++)
+            *changes[i].first = changes[i].second;
+
+        /** Derived from cache_line_size_log2, which is what is set.  */
+        cache_line_size = 1 << cache_line_size_log2;
+    }
+
+    return ok;
+}
+
+Sim_context::Sim_context (void)
+{
+    sim = Sim;
+    settings = ::settings;
+}
+
+void Sim_context::adopt (void)
+{
+    Sim = sim;
+    ::settings = settings;
+}
+
+typedef struct {
+    const char *name;
+    protocol_t protocol;
+} protocol_name_t;
+
+static const protocol_name_t protocol_names[] = {
+    {"MI",      MI_PRO     },
+    {"MSI",     MSI_PRO    },
+    {"MESI",    MESI_PRO   },
+    {"MOSI",    MOSI_PRO   },
+    {"MOESI",   MOESI_PRO  },
+    {"MOESIF",  MOESIF_PRO },
+    {NULL,      NULL_PRO   }
+};
+
+/** Same order as engine_t.  */
+static const char *engine_names[] = {"tick", "event", "parallel", "optimistic", NULL};
+
+const char *protocol_name (protocol_t protocol)
+{
+    for (int i = 0; protocol_names[i].name; i++)
+        if (protocol_names[i].protocol == protocol)
+            return protocol_names[i].name;
+    return "?";
+}
+
+bool parse_protocol (const char *name, protocol_t *protocol)
+{
+    for (int i = 0; protocol_names[i].name; i++)
+        if (!strcmp (protocol_names[i].name, name))
+        {
+            *protocol = protocol_names[i].protocol;
+            return true;
+        }
+    return false;
+}
+
+const char *engine_name (engine_t engine)
+{
+    return engine_names[engine];
+}
+
+bool parse_engine (const char *name, engine_t *engine)
+{
+    for (int i = 0; engine_names[i]; i++)
+        if (!strcmp (engine_names[i], name))
+        {
+            *engine = (engine_t)i;
+            return true;
+        }
+    return false;
+}
+
+bool Sim_settings::plain_run (void)
+{
+    return !extrapolate && !estimate && !estimate_only && !stack_study &&
+           !checkpoint_file && !restore_file && variants.empty () && !functional_warmup && !sampling &&
+           !simpoint && !record_file && !replay_file && !lockstep && !jitter_seed &&
+           !cycle_bound;
+}
+
 void Sim_settings::print_settings (void) 
 {
     fprintf (stderr, "SIM Settings:\n");
@@ -177,6 +343,7 @@ void Sim_settings::print_settings (void)
     fprintf (stderr, "nhood_y_blocking_factor %16d\n", nhood_y_blocking_factor);
 
 	fprintf (stderr, " num_mem_ctrls:         %16d\n", num_mem_ctrls);
+	fprintf (stderr, " mem_hit_time:          %16d\n", mem_hit_time);
 
 
 	fprintf (stderr, " net_infinite_bw:       %16s\n", net_infinite_bw == true ? "true" : "false");
@@ -221,7 +388,8 @@ void Sim_settings::print_settings (void)
 	fprintf (stderr, " l1_coherence_policy:   %16d\n", l1_coherence_policy);
 	fprintf (stderr, " l1_cache_policy:       %16d\n", l1_cache_policy);
 	fprintf (stderr, " l1_lookup_time:        %16d\n", l1_lookup_time);
-	fprintf (stderr, " l1_infinite:           %16s\n", l1_infinite == true ? "true" : "false");
+	fprintf (stderr, " l1_infinite:           %16s\n", l1_infinite ? "true" : "false");
+	fprintf (stderr, " l1_lru_check:          %16s\n", l1_lru_check ? "true" : "false");
 
     //TODO: L2 cache type
 	fprintf (stderr, " l2_cache_size:         %16d\n", l2_cache_size);
@@ -292,6 +460,10 @@ void Sim_settings::print_settings (void)
     fprintf (stderr, " test_addr:             0x%14llx\n", (unsigned long long int) test_addr);
 
 	fprintf (stderr, " sampling_interval:     %lld\n", sampling_interval);
+	fprintf (stderr, " sample_size:           %lld\n", sample_size);
+	fprintf (stderr, " sample_warmup:         %lld\n", sample_warmup);
+	fprintf (stderr, " simpoint_interval:     %lld\n", simpoint_interval);
+	fprintf (stderr, " simpoint_clusters:     %lld\n", simpoint_clusters);
 }
 
 void Sim_settings::set_defaults (void)
@@ -306,13 +478,14 @@ void Sim_settings::set_defaults (void)
 
     num_mem_ctrls           = 4;
 
-    assert (mem_ctrl_array == NULL);
- 
-    mem_ctrl_array          = new int [4];
+    mem_ctrl_array.resize (4);
     mem_ctrl_array[0]       = 0;
     mem_ctrl_array[1]       = 4;
     mem_ctrl_array[2]       = 32;
     mem_ctrl_array[3]       = 36;
+    mem_hit_time            = 100;
+    jitter_seed             = 0;
+    jitter_cycles           = 0;
 
     heartrate               = (1 << 16);
     net_infinite_bw			= false;
@@ -327,6 +500,7 @@ void Sim_settings::set_defaults (void)
     sesc_nsim_per_core      = 10000000;
     sesc_disable_llsc       = false;
 
+    functional_warmup       = false;
     warmup_time				= 0;
     warmup_time_per_core   	= 100000;
 
@@ -353,7 +527,8 @@ void Sim_settings::set_defaults (void)
     l1_coherence_policy		= MESI;
     l1_cache_policy			= CACHE_PRIVATE;
     l1_lookup_time			= 3;
-    l1_infinite             = false;
+    l1_infinite             = true;
+    l1_lru_check            = false;
     
     l2_cache_type           = CACHE_DATA;
     l2_cache_size           = 65536;
@@ -376,7 +551,7 @@ void Sim_settings::set_defaults (void)
     l3_infinite             = false;
 
     dir_tiers               = 1;
-    dir_coherence_policy    = new int[1];
+    dir_coherence_policy.resize (1);
     dir_coherence_policy[0] = MESI;
     dir_mode                = DIR_1L;
     dir_addr_per_node_log2  = 13;
@@ -395,6 +570,24 @@ void Sim_settings::set_defaults (void)
     sel_rep_pred_threshold  = 0;
 
     debug = false;
+    verbose                 = true;
+    extrapolate             = false;
+    estimate                = false;
+    estimate_only           = false;
+    stack_study             = NULL;
+    checkpoint_file         = NULL;
+    checkpoint_cycle        = 0;
+    restore_file            = NULL;
+    branch_cycle            = 0;
+    variants.clear ();
+    record_file             = NULL;
+    replay_file             = NULL;
+    lockstep                = false;
+    memo_dir                = NULL;
+    memo_refresh            = false;
+    cycle_bound             = NULL;
+    engine                  = EVENT_ENGINE;
+    num_threads             = sysconf (_SC_NPROCESSORS_ONLN);
 
     sim_analysis_enabled    = false;
     ro_tracker_gran         = cache_line_size;
@@ -406,7 +599,13 @@ void Sim_settings::set_defaults (void)
 	num_virtual_channels	= 16;
 	buffer_entries_per_vc	= 6;
 
+	sampling                = false;
 	sampling_interval	    = 1 << 10;
+	sample_size             = 64;
+	sample_warmup           = 16;
+	simpoint                = false;
+	simpoint_interval       = 1 << 10;
+	simpoint_clusters       = 4;
 
     debug_addr              = 0x0;
     test_addr               = 0x0;
@@ -416,5 +615,7 @@ void Sim_settings::set_defaults (void)
     report_output           = OUTPUT_FMT_CSV;
 
     trace_dir               = NULL;
+    trace_source            = NULL;
+    trace_instance          = 0;
 }
 
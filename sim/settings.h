@@ -1,9 +1,13 @@
 #ifndef SETTINGS_H_
 #define SETTINGS_H_
 
+#include <atomic>
+
 #include "enums.h"
 #include "types.h"
 
+class Trace_source;
+
 typedef struct setts {
 	char name[50];
 	void *pointer;
@@ -24,7 +28,14 @@ public:
     int                  nhood_y_blocking_factor;
 
     int                  num_mem_ctrls;
-    int*                 mem_ctrl_array;
+    VECTOR<int>          mem_ctrl_array;
+    int                  mem_hit_time;
+
+    /** With a seed, buses grant among requests queued in the same cycle at
+     *  random, and memory takes up to jitter_cycles more or less than
+     *  mem_hit_time, all drawn from the seed (see seeds.h).  */
+    int                  jitter_seed;
+    int                  jitter_cycles;
 
     unsigned int         heartrate;
 
@@ -42,6 +53,10 @@ public:
 	signed long long int sesc_nsim_per_core;
     bool                 sesc_disable_llsc;
 
+	/** With functional_warmup, references played functionally before the
+	 *  detailed run: at most warmup_time_per_core from each trace, and
+	 *  warmup_time in all unless zero.  */
+	bool                 functional_warmup;
 	long long int        warmup_time;
 	long long int        warmup_time_per_core;
 
@@ -75,7 +90,13 @@ public:
 	coherence_policy_t	 l1_coherence_policy;
 	cache_policy_t		 l1_cache_policy;
 	int                  l1_lookup_time;
-    bool                 l1_infinite;
+    /** The L1 keeps every line it is given; otherwise it holds
+     *  l1_cache_assoc lines to a set (see hash_table.h).  An int, so that
+     *  -o can set it.  */
+    int                  l1_infinite;
+    /** Check a finite L1 against a brute force LRU as it runs (see
+     *  lru_check.h).  Slow.  */
+    int                  l1_lru_check;
 
     // L2
     cache_type_t         l2_cache_type;
@@ -103,7 +124,7 @@ public:
 
     // Directory
     int                  dir_tiers;
-    int*                 dir_coherence_policy;
+    VECTOR<int>          dir_coherence_policy;
     dir_mode_t           dir_mode;
     int                  dir_addr_per_node_log2;
 
@@ -138,7 +159,20 @@ public:
 	int					 num_virtual_channels;
 	int					 buffer_entries_per_vc;
 
+	/** With sampling, references per core from the start of one detailed
+	 *  window to the next, of which sample_warmup are run in detail before
+	 *  the sample_size that are measured (see sample.h).  */
+	bool                 sampling;
 	long long int		 sampling_interval;
+	long long int        sample_size;
+	long long int        sample_warmup;
+
+	/** Simulate only representatives of simpoint_clusters phases of the
+	 *  intervals of simpoint_interval references per core (see
+	 *  simpoint.h).  */
+	bool                 simpoint;
+	long long int        simpoint_interval;
+	long long int        simpoint_clusters;
 
 	sim_output_mode_t    report_output;
 
@@ -147,9 +181,64 @@ public:
 
     char                 *trace_dir;
 
+    /** Traces decoded once for several simulations (see trace.h), of which
+     *  this is number trace_instance; NULL to read the files in trace_dir.  */
+    Trace_source         *trace_source;
+    int                  trace_instance;
+
     protocol_t protocol;
+    engine_t engine;
+    int num_threads;
     bool debug;
 
+    /** Log every request as it is handled (the validation output).  */
+    bool verbose;
+
+    /** Skip over periodic steady states (see period.h).  */
+    bool extrapolate;
+
+    /** Predict the run analytically (see estimate.h), before running it
+     *  for comparison or instead of it.  */
+    bool estimate;
+    bool estimate_only;
+
+    /** Count the misses of each of these L1 caches, given as size:assoc
+     *  pairs, in one functional pass instead of running (see stack.h).  */
+    char *stack_study;
+
+    /** Save the state to checkpoint_file at the start of the first cycle
+     *  from checkpoint_cycle on, or start from the state in restore_file
+     *  (see checkpoint.h).  */
+    char *checkpoint_file;
+    timestamp_t checkpoint_cycle;
+    char *restore_file;
+
+    /** Run to branch_cycle once, then each of the variants, given as
+     *  apply_override () specs, from there in a child process of its own
+     *  (see branch.h).  */
+    timestamp_t branch_cycle;
+    VECTOR<char *> variants;
+
+    /** Write the order of events on the bus to record_file, or drive the
+     *  caches from the one in replay_file instead of running (see
+     *  replay.h).  */
+    char *record_file;
+    char *replay_file;
+
+    /** Run the engine under test side by side with the tick engine, and
+     *  stop where they differ (see lockstep.h).  */
+    bool lockstep;
+
+    /** Keep results in memo_dir, keyed by everything they depend on, and
+     *  take them from there instead of running again; with memo_refresh,
+     *  run anyway and replace them (see memo.h).  */
+    char *memo_dir;
+    bool memo_refresh;
+
+    /** Give up on the run once the clock passes this, which other threads
+     *  may lower as it goes; NULL for no bound (see tune.h).  */
+    const atomic<timestamp_t> *cycle_bound;
+
     Sim_settings (void);
     ~Sim_settings (void);
 
@@ -157,6 +246,37 @@ public:
   	void get_settings (void);
     void get_topology (void);
     void print_settings (void);
+    bool apply_override (const char *spec, bool apply = true, bool at_start = false);
+
+    /** Just runs the traces: nothing printed along the way, nothing
+     *  forked, no files but the traces.  */
+    bool plain_run (void);
+};
+
+/** Names of protocols and engines, as on the command line.  */
+const char *protocol_name (protocol_t protocol);
+bool parse_protocol (const char *name, protocol_t *protocol);
+const char *engine_name (engine_t engine);
+bool parse_engine (const char *name, engine_t *engine);
+
+class Simulator;
+
+/**
+ * What a thread simulates.  Sim and settings are per thread, so that several
+ * simulations can run side by side in one process (see simulation.h); the
+ * threads an engine starts take on the context of the thread that starts
+ * them.
+ */
+class Sim_context {
+public:
+    /** Captures the calling thread's.  */
+    Sim_context (void);
+
+    /** Makes it the calling thread's.  */
+    void adopt (void);
+
+    Simulator *sim;
+    Sim_settings settings;
 };
 
 // Debug
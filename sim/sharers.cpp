@@ -4,8 +4,8 @@
 #include "sim.h"
 #include "settings.h"
 
-extern Sim_settings settings;
-extern Simulator *Sim;
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
 
 /********************************
  * Constructor/destructor.
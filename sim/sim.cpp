@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <strings.h>
 
+#include "functional.h"
 #include "hash_table.h"
 #include "processor.h"
 #include "memory.h"
@@ -10,15 +11,45 @@
 #include "mreq.h"
 #include "settings.h"
 #include "sim.h"
+#include "stack.h"
+#include "timewarp.h"
 #include "types.h"
 
-extern Sim_settings settings;
+/** Each thread runs a simulation of its own (see simulation.h).  */
+thread_local Sim_settings settings;
+thread_local Simulator *Sim = NULL;
+
+thread_local FILE *sim_log_stream = NULL;
+thread_local timestamp_t *sim_thread_clock = NULL;
+thread_local bool fatal_throws = false;
 
 /** Fatal Error.  */
 void fatal_error (const char *fmt, ...)
 {
     va_list ap;
 
+    /** Under the optimistic engine this may be an artifact of speculation.
+     *  The engine decides once the event can no longer be rolled back.  */
+    if (tw_lp)
+    {
+        char msg[1000];
+
+        va_start (ap, fmt);
+        vsnprintf (msg, sizeof (msg), fmt, ap);
+        va_end (ap);
+        throw Tw_error (msg);
+    }
+
+    if (fatal_throws)
+    {
+        char msg[1000];
+
+        va_start (ap, fmt);
+        vsnprintf (msg, sizeof (msg), fmt, ap);
+        va_end (ap);
+        throw Sim_error (msg);
+    }
+
     va_start (ap, fmt);
     vfprintf (stderr, fmt, ap);
     va_end (ap);
@@ -40,6 +71,20 @@ Simulator::Simulator ()
     bus = new Bus ();
     assert (bus && "Sim error: Unable to alloc bus.");
 
+    scheduler = NULL;
+    periods = NULL;
+    estimator = NULL;
+    checkpointed = false;
+    brancher = NULL;
+    branched = false;
+    sampler = NULL;
+    simpoints = NULL;
+    recorder = NULL;
+    replayer = NULL;
+    lockstep = NULL;
+    jitter_state = settings.jitter_seed;
+    stopped = false;
+
     Nd = new Node*[settings.num_nodes+1];
 
     /** Allocate processors.  */
@@ -56,51 +101,332 @@ Simulator::Simulator ()
     Nd[settings.num_nodes] = new Node (settings.num_nodes);
     Nd[settings.num_nodes]->build_memory_controller ();
 
-    cache_misses = 0;
-    silent_upgrades = 0;
-    cache_to_cache_transfers = 0;
-    cache_accesses = 0;
+    stats.clear ();
+    pool = NULL;
 }
 
 Simulator::~Simulator ()
 {
-    for (int i = 0; i < settings.num_nodes; i++)
+    for (int i = 0; i <= settings.num_nodes; i++)
         delete Nd[i];
 
     delete [] Nd;    
+
+    delete bus;
+
+    if (scheduler)
+        delete scheduler;
+
+    if (periods)
+        delete periods;
+
+    if (estimator)
+        delete estimator;
+
+    if (brancher)
+        delete brancher;
+
+    if (sampler)
+        delete sampler;
+
+    if (simpoints)
+        delete simpoints;
+
+    if (recorder)
+        delete recorder;
+
+    if (replayer)
+        delete replayer;
+
+    if (lockstep)
+        delete lockstep;
+
+    if (pool)
+        delete pool;
+
+    for (unsigned int i = 0; i < node_logs.size (); i++)
+    {
+        fclose (node_logs[i]);
+        free (node_log_bufs[i]);
+    }
+}
+
+void Simulator::collect_stats ()
+{
+    stats.clear ();
+    for (int i = 0; i < settings.num_nodes; i++)
+        stats += get_L1(i)->stats;
+}
+
+Sim_result Simulator::result ()
+{
+    Sim_result result;
+
+    collect_stats ();
+    result.run_time = global_clock;
+    result.stats = stats;
+    result.bus_busy_cycles = bus->busy_cycles;
+
+    return result;
 }
 
 void Simulator::dump_stats ()
 {
+    collect_stats ();
+
     for (int i=0; i < settings.num_nodes; i++)
     {
     	get_L1(i)->dump_hash_table();
     }
-    fprintf(stderr,"\nRun Time:         %8lld cycles\n",global_clock);
-    fprintf(stderr,"Cache Misses:     %8ld misses\n",cache_misses);
-    fprintf(stderr,"Cache Accesses:   %8ld accesses\n",cache_accesses);
-    fprintf(stderr,"Silent Upgrades:  %8ld upgrades\n",silent_upgrades);
-    fprintf(stderr,"$-to-$ Transfers: %8ld transfers\n",cache_to_cache_transfers);
+    fprintf(SIM_LOG,"\nRun Time:         %8lld cycles\n",global_clock);
+    fprintf(SIM_LOG,"Cache Misses:     %8ld misses\n",stats.cache_misses);
+    fprintf(SIM_LOG,"Cache Accesses:   %8ld accesses\n",stats.cache_accesses);
+    fprintf(SIM_LOG,"Silent Upgrades:  %8ld upgrades\n",stats.silent_upgrades);
+    fprintf(SIM_LOG,"$-to-$ Transfers: %8ld transfers\n",stats.cache_to_cache_transfers);
+    if (!settings.l1_infinite)
+        fprintf(SIM_LOG,"Writebacks:       %8ld writebacks\n",stats.writebacks);
 }
 
 void Simulator::run ()
 {
-    int sched;
-    bool done;
-
     /** This must match what's in enums.h.  */
     const char *cp_str[9] = {"CACHE_PRO","MI_PRO","MSI_PRO","MESI_PRO",
 							 "MOESI_PRO","MOSI_PRO","MOESIF_PRO","NULL_PRO","MEM_PRO"};
 
-    fprintf (stderr, "CSX290 Sim - Begins  ");
-    fprintf (stderr, " Cores: %d", settings.num_nodes);
-    fprintf (stderr, " Protocol: %s\n", cp_str[settings.protocol]);
+    /** Both engines have to run the same thing from the same start.  */
+    if (settings.lockstep)
+    {
+        if (settings.extrapolate || settings.estimate || settings.estimate_only ||
+            settings.checkpoint_file || settings.restore_file || !settings.variants.empty () ||
+            settings.functional_warmup || settings.sampling || settings.simpoint ||
+            settings.record_file || settings.replay_file)
+            fatal_error ("Lockstep checks run plain simulations only\n");
+
+        lockstep = new Lockstep ();
+        lockstep->start (settings.engine);
+    }
+
+    /** Neither a snapshot of the caches nor a steady state of them takes
+     *  in the order their lines were used in.  */
+    if (!settings.l1_infinite)
+    {
+        if (settings.engine == OPTIMISTIC_ENGINE)
+            fatal_error ("A finite L1 needs a synchronous engine\n");
+        if (settings.stack_study || settings.extrapolate || settings.checkpoint_file ||
+            settings.restore_file || settings.record_file || settings.replay_file)
+            fatal_error ("A finite L1 does not mix with stack studies, extrapolation, "
+                         "checkpoints or bus logs\n");
+    }
+
+    if (settings.stack_study)
+    {
+        Stack_study study (settings.stack_study);
+
+        study.run ();
+        study.report ();
+        return;
+    }
+
+    /** The draws have to come in the same order every time, and a steady
+     *  state may well not repeat.  */
+    if (settings.jitter_seed)
+    {
+        if (settings.engine == OPTIMISTIC_ENGINE)
+            fatal_error ("Jitter needs a synchronous engine\n");
+        if (settings.extrapolate || settings.checkpoint_file || settings.restore_file ||
+            settings.sampling || settings.simpoint || settings.record_file ||
+            settings.replay_file)
+            fatal_error ("Jittered runs do not mix with extrapolation, checkpoints, "
+                         "sampling or bus logs\n");
+    }
+
+    /** Before anything else touches the caches: the pass leaves them empty.  */
+    if (settings.estimate || settings.estimate_only)
+    {
+        estimator = new Estimator ();
+        estimator->functional_pass ();
+        estimator->solve ();
+
+        if (settings.estimate_only)
+        {
+            estimator->report (false);
+            return;
+        }
+    }
+
+    fprintf (SIM_LOG, "CSX290 Sim - Begins  ");
+    fprintf (SIM_LOG, " Cores: %d", settings.num_nodes);
+    fprintf (SIM_LOG, " Protocol: %s\n", cp_str[settings.protocol]);
+
+    if (settings.extrapolate)
+    {
+        if (settings.engine == OPTIMISTIC_ENGINE)
+            fatal_error ("Steady state extrapolation needs a synchronous engine\n");
+        periods = new Period_detector ();
+    }
+
+    if (settings.engine == OPTIMISTIC_ENGINE &&
+        (settings.checkpoint_file || settings.restore_file))
+        fatal_error ("Checkpoints need a synchronous engine\n");
+
+    if (!settings.variants.empty ())
+    {
+        /** fork () only carries over the calling thread.  */
+        if (settings.engine == OPTIMISTIC_ENGINE || settings.engine == PARALLEL_ENGINE)
+            fatal_error ("Variants need a single threaded engine\n");
+        brancher = new Brancher ();
+    }
+
+    if (settings.sampling || settings.simpoint)
+    {
+        if (settings.engine == OPTIMISTIC_ENGINE)
+            fatal_error ("Sampling needs a synchronous engine\n");
+        if (settings.extrapolate || estimator || settings.checkpoint_file ||
+            settings.restore_file || !settings.variants.empty () ||
+            settings.functional_warmup || (settings.sampling && settings.simpoint))
+            fatal_error ("Sampling runs only part of the traces in detail: it does not "
+                         "mix with extrapolation, estimates, checkpoints, variants, "
+                         "warmup or other sampling\n");
+    }
+
+    if (settings.sampling)
+    {
+        if (settings.sample_size <= 0 || settings.sample_warmup < 0)
+            fatal_error ("Sampling: invalid sample size %lld\n",
+                         (long long int)settings.sample_size);
+        sampler = new Sampler ();
+    }
+
+    if (settings.simpoint)
+    {
+        if (settings.simpoint_interval <= 0 || settings.simpoint_clusters <= 0)
+            fatal_error ("Simpoints: invalid interval %lld or number of phases %lld\n",
+                         (long long int)settings.simpoint_interval,
+                         (long long int)settings.simpoint_clusters);
+        simpoints = new Simpoints ();
+        simpoints->choose ();
+    }
+
+    if (settings.record_file || settings.replay_file)
+    {
+        /** The log is written as the bus runs, and replay starts from reset.  */
+        if (settings.record_file &&
+            settings.engine != TICK_ENGINE && settings.engine != EVENT_ENGINE)
+            fatal_error ("Bus logs need a single threaded engine\n");
+        if (settings.extrapolate || estimator || settings.checkpoint_file ||
+            settings.restore_file || !settings.variants.empty () ||
+            settings.functional_warmup || sampler || simpoints ||
+            (settings.record_file && settings.replay_file))
+            fatal_error ("Bus logs cover one whole run from reset: they do not mix "
+                         "with extrapolation, estimates, checkpoints, variants, "
+                         "warmup or sampling\n");
+
+        if (settings.record_file)
+            recorder = new Bus_recorder (settings.record_file);
+        else
+        {
+            replayer = new Replayer ();
+            replayer->hooks.push_back (new Bus_traffic ());
+        }
+    }
+
+    if (settings.restore_file)
+    {
+        Checkpoint checkpoint;
+
+        checkpoint.restore (settings.restore_file);
+        fprintf (stdout, "Restored %s at cycle %lld\n",
+                 settings.restore_file, (long long int)global_clock);
+    }
+    else if (settings.functional_warmup)
+        warm_up ();
+
+    if (sampler)
+        sampler->run ();
+    else if (simpoints)
+        simpoints->run ();
+    else if (replayer)
+        replayer->run (settings.replay_file);
+    else
+        run_engine ();
+
+    if (recorder)
+    {
+        long size = recorder->finish ();
+
+        fprintf (stdout, "Bus log %s: %lld records, %ld bytes\n", settings.record_file,
+                 (long long int)recorder->records, size);
+    }
+
+    /** Only returns in the reference.  */
+    if (lockstep)
+        lockstep->finish ();
+
+    if (brancher && !branched)
+        fatal_error ("The run ended before the branch cycle, %lld\n",
+                     (long long int)settings.branch_cycle);
+
+    /** Lines may be left mid transaction, which the dumps have no names
+     *  for.  */
+    if (stopped)
+    {
+        fprintf (SIM_LOG, "\n\nSimulation stopped at cycle %lld, past its bound\n",
+                 (long long int)global_clock);
+        return;
+    }
+
+    fprintf(SIM_LOG,"\n\nSimulation Finished\n");
+    dump_stats();
+
+    if (periods)
+        periods->report ();
+
+    if (estimator)
+        estimator->report (true);
+
+    if (sampler)
+        sampler->report ();
+
+    if (simpoints)
+        simpoints->report ();
+
+    if (replayer)
+        replayer->report ();
+
+    if (lockstep)
+        lockstep->report ();
+
+    if (brancher)
+        brancher->send_result ();
+}
+
+/** Run until every processor is done, under the engine chosen.  */
+void Simulator::run_engine ()
+{
+    if (settings.engine == EVENT_ENGINE)
+        run_event ();
+    else if (settings.engine == PARALLEL_ENGINE)
+        run_parallel ();
+    else if (settings.engine == OPTIMISTIC_ENGINE)
+        run_optimistic ();
+    else
+        run_tick ();
+}
+
+/** Polled engine: every module is ticked on every (non-idle) cycle.  */
+void Simulator::run_tick ()
+{
+    bool done;
 
     /** Main run loop.  */
-    sched = 0;
     done = false;
     while (!done)
     {
+        /** Jump over cycles in which no module has any work to do.  */
+        global_clock = next_active_cycle ();
+
+        start_cycle ();
+
         bus->tick ();
 
         for (int i = 0; i <= settings.num_nodes; i++)
@@ -117,17 +443,376 @@ void Simulator::run ()
 
         global_clock++;
 
-        done = true;
+        done = all_processors_done ();
+    }
+}
+
+/** Work done by every synchronous engine at the start of a cycle, before
+ *  the bus ticks.  */
+void Simulator::start_cycle ()
+{
+    if (periods)
+        periods->check ();
+
+    if (sampler)
+        sampler->check ();
+
+    if (settings.checkpoint_file && !checkpointed &&
+        global_clock >= settings.checkpoint_cycle)
+    {
+        Checkpoint checkpoint;
+        long size;
+
+        size = checkpoint.save (settings.checkpoint_file);
+        checkpointed = true;
+        fprintf (stdout, "Checkpoint %s at cycle %lld: %ld bytes\n",
+                 settings.checkpoint_file, (long long int)global_clock, size);
+    }
+
+    /** Returns in each child, with its variant applied.  */
+    if (brancher && !branched && global_clock >= settings.branch_cycle)
+    {
+        branched = true;
+        brancher->branch ();
+    }
+}
+
+/** Play the start of the traces through the functional model, so that the
+ *  detailed run starts with warm caches, and start the counters over.  */
+void Simulator::warm_up ()
+{
+    Functional_model model;
+    VECTOR<FILE *> traces (settings.num_nodes);
+    counter_t played;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        traces[i] = get_PR (i)->infile;
+
+    played = model.run (traces, settings.warmup_time_per_core, settings.warmup_time);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        get_L1 (i)->stats.clear ();
+    bus->busy_cycles = 0;
+
+    if (settings.verbose)
+        fprintf (stdout, "Functional warmup: %lld references\n", (long long int)played);
+}
+
+/** Bring the modules in line with settings that changed mid-run.  */
+void Simulator::apply_settings ()
+{
+    get_MC (settings.num_nodes)->hit_time = settings.mem_hit_time;
+    jitter_state = settings.jitter_seed;
+}
+
+/** splitmix64: every seed gives a stream of its own.  */
+int Simulator::jitter (int n)
+{
+    uint64_t z = (jitter_state += 0x9e3779b97f4a7c15ULL);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    z = z ^ (z >> 31);
+    return (int)(z % n);
+}
+
+/** Wake every module now, and each again when its state says it is due,
+ *  for a run that starts from a restored state instead of from reset.  */
+void Simulator::wake_all ()
+{
+    Memory_controller *mc = get_MC (settings.num_nodes);
+
+    schedule (BUS_PHASE, 0, global_clock);
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        schedule (CACHE_PHASE, i, global_clock);
+        schedule (PR_PHASE, i, global_clock);
+        schedule (TOCK_PHASE, i, global_clock);
+        if (get_PR (i)->resume_time > global_clock)
+            schedule (PR_PHASE, i, get_PR (i)->resume_time);
+    }
+
+    schedule (MC_PHASE, settings.num_nodes, global_clock);
+    if (mc->request_in_progress && mc->data_time > global_clock)
+        schedule (MC_PHASE, settings.num_nodes, mc->data_time);
+}
+
+/** Event-driven engine: only modules with a pending wakeup are run.  Phases
+ *  and nodes within a phase run in the same order as in run_tick, so the
+ *  two engines produce identical output.  */
+void Simulator::run_event ()
+{
+    VECTOR<int> nodes;
+
+    /** A sampled run comes back here for every window.  */
+    if (scheduler)
+        delete scheduler;
+    scheduler = new Scheduler ();
+
+    if (settings.restore_file)
+        wake_all ();
+    else
+    {
         for (int i = 0; i < settings.num_nodes; i++)
-            if (!get_PR(i)->done ())
+            schedule (PR_PHASE, i, global_clock);
+    }
+
+    while (!all_processors_done ())
+    {
+        if (scheduler->empty ())
+            fatal_error ("Deadlock: nothing left to run at cycle %lld\n",
+                         (long long int)global_clock);
+
+        global_clock = scheduler->next_time ();
+
+        start_cycle ();
+
+        scheduler->pop (global_clock, BUS_PHASE, nodes);
+        if (!nodes.empty ())
+        {
+            bus->tick ();
+
+            /** Whatever is on the bus is snooped by every cache and the MC.  */
+            if (bus->current_request)
             {
-                done = false;
-                break;        
+                for (int i = 0; i < settings.num_nodes; i++)
+                    schedule (CACHE_PHASE, i, global_clock);
+                schedule (MC_PHASE, settings.num_nodes, global_clock);
             }
+        }
+
+        scheduler->pop (global_clock, CACHE_PHASE, nodes);
+        for (unsigned int i = 0; i < nodes.size (); i++)
+            Nd[nodes[i]]->tick_cache ();
+
+        scheduler->pop (global_clock, PR_PHASE, nodes);
+        for (unsigned int i = 0; i < nodes.size (); i++)
+            Nd[nodes[i]]->tick_pr ();
+
+        scheduler->pop (global_clock, MC_PHASE, nodes);
+        for (unsigned int i = 0; i < nodes.size (); i++)
+            Nd[nodes[i]]->tick_mc ();
+
+        scheduler->pop (global_clock, TOCK_PHASE, nodes);
+        for (unsigned int i = 0; i < nodes.size (); i++)
+            Nd[nodes[i]]->tock_pr ();
+
+        global_clock++;
     }
+}
 
-    fprintf(stderr,"\n\nSimulation Finished\n");
-    dump_stats();
+/** Parallel engine: run_tick with the per-node cache, processor and tock
+ *  loops spread over a thread pool.  Everything a node sends to the bus or
+ *  prints is buffered and released in node order at the end of the phase,
+ *  so the result is bit-identical to run_tick.  */
+void Simulator::run_parallel ()
+{
+    bool done;
+
+    if (!pool)
+    {
+        pool = new Thread_pool (settings.num_threads);
+
+        for (int i = 0; i < settings.num_nodes; i++)
+        {
+            node_log_bufs.push_back (NULL);
+            node_log_sizes.push_back (0);
+        }
+        for (int i = 0; i < settings.num_nodes; i++)
+            node_logs.push_back (open_memstream (&node_log_bufs[i], &node_log_sizes[i]));
+    }
+
+    done = false;
+    while (!done)
+    {
+        global_clock = next_active_cycle ();
+
+        start_cycle ();
+
+        bus->tick ();
+
+        run_parallel_phase (CACHE_PHASE);
+        run_parallel_phase (PR_PHASE);
+
+        /** The memory controller is a single module: no point farming it out.  */
+        for (int i = 0; i <= settings.num_nodes; i++)
+            Nd[i]->tick_mc ();
+
+        run_parallel_phase (TOCK_PHASE);
+
+        global_clock++;
+
+        done = all_processors_done ();
+    }
+}
+
+/** Optimistic engine: every node runs ahead on its own thread and rolls back
+ *  when the bus shows it something from its past.  See timewarp.h.  */
+void Simulator::run_optimistic ()
+{
+    Tw_kernel *kernel = new Tw_kernel ();
+
+    global_clock = kernel->run ();
+    kernel->report ();
+    delete kernel;
+}
+
+/** Would running nodeID's module for this phase do anything?  */
+bool Simulator::node_has_work (phase_t phase, int nodeID)
+{
+    switch (phase) {
+    case CACHE_PHASE: return bus->current_request || !get_L1(nodeID)->is_idle ();
+    case PR_PHASE:    return !get_PR(nodeID)->is_idle ();
+    case TOCK_PHASE:  return get_PR(nodeID)->inbound_request_buf != NULL;
+    default:
+        fatal_error ("node_has_work: phase %d does not run per node\n", phase);
+    }
+}
+
+void Simulator::run_node_phase (phase_t phase, int nodeID)
+{
+    FILE *log = sim_log_stream;
+
+    sim_log_stream = node_logs[nodeID];
+
+    switch (phase) {
+    case CACHE_PHASE: Nd[nodeID]->tick_cache (); break;
+    case PR_PHASE:    Nd[nodeID]->tick_pr (); break;
+    case TOCK_PHASE:  Nd[nodeID]->tock_pr (); break;
+    default:
+        fatal_error ("run_node_phase: phase %d does not run per node\n", phase);
+    }
+
+    sim_log_stream = log;
+}
+
+typedef struct {
+    Simulator *sim;
+    phase_t phase;
+    VECTOR<int> *nodes;
+} phase_work_t;
+
+static void run_node_phase_worker (int i, void *arg)
+{
+    phase_work_t *work = (phase_work_t *)arg;
+    work->sim->run_node_phase (work->phase, (*work->nodes)[i]);
+}
+
+void Simulator::run_parallel_phase (phase_t phase)
+{
+    VECTOR<int> nodes;
+    phase_work_t work;
+    int ordered_node = -1;
+
+    /** The destination of DATA on the bus reads the shared line, which lower
+     *  numbered caches may still be setting this cycle.  It runs on its own
+     *  once everyone else is done.  */
+    if (phase == CACHE_PHASE && bus->current_request &&
+        bus->current_request->msg == DATA &&
+        bus->current_request->dest_mid.nodeID < settings.num_nodes)
+        ordered_node = bus->current_request->dest_mid.nodeID;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        if (i != ordered_node && node_has_work (phase, i))
+            nodes.push_back (i);
+
+    if (nodes.empty () && ordered_node < 0)
+        return;
+
+    work.sim = this;
+    work.phase = phase;
+    work.nodes = &nodes;
+
+    bus->defer (settings.num_nodes, ordered_node);
+    pool->parallel_for (nodes.size (), run_node_phase_worker, &work);
+    if (ordered_node >= 0)
+        run_node_phase (phase, ordered_node);
+    bus->merge ();
+
+    flush_node_logs ();
+}
+
+void Simulator::flush_node_logs (void)
+{
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        fflush (node_logs[i]);
+        if (node_log_sizes[i])
+        {
+            fwrite (node_log_bufs[i], 1, node_log_sizes[i], SIM_LOG);
+            fseek (node_logs[i], 0, SEEK_SET);
+            fflush (node_logs[i]);
+        }
+    }
+}
+
+bool Simulator::all_processors_done (void)
+{
+    if (settings.cycle_bound &&
+        global_clock > settings.cycle_bound->load (memory_order_relaxed))
+    {
+        stopped = true;
+        return true;
+    }
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        if (!get_PR(i)->done ())
+            return false;
+    return true;
+}
+
+void Simulator::schedule (phase_t phase, int nodeID, timestamp_t when)
+{
+    if (tw_lp)
+        tw_lp->schedule_self (phase, nodeID, when);
+    else if (scheduler)
+        scheduler->schedule (phase, nodeID, when);
+}
+
+/** Earliest cycle, starting at global_clock, in which some module can change
+ *  state.  While every processor waits on the bus and the bus waits on the
+ *  memory controller, that is the cycle the memory controller's data is due.  */
+timestamp_t Simulator::next_active_cycle (void)
+{
+    Memory_controller *mc;
+
+    if (!bus->is_idle ())
+        return global_clock;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        if (!get_L1(i)->is_idle () || !get_PR(i)->is_idle ())
+            return global_clock;
+
+    mc = get_MC (settings.num_nodes);
+    if (mc->request_in_progress && mc->data_time > global_clock)
+        return mc->data_time;
+
+    return global_clock;
+}
+
+/** Earliest cycle after this one in which the caches could snoop a bus
+ *  request, judging from what the bus and memory controller are doing.  A
+ *  cache can look up processor requests up to and including that cycle,
+ *  since a cache handles its processor request before its snoop.  Only
+ *  valid after the cache phase of the current cycle.  */
+timestamp_t Simulator::next_snoop_cycle (void)
+{
+    Memory_controller *mc = get_MC (settings.num_nodes);
+
+    /** Anything queued can be granted next cycle.  */
+    if (!bus->request_in_progress)
+        return global_clock + 1;
+
+    /** The reply goes on the bus next cycle, and the next grant after it.
+     *  Only memory can still reply later: caches do so when they snoop.  */
+    if (bus->data_reply)
+        return global_clock + 2;
+    if (mc->request_in_progress)
+        return max (mc->data_time, global_clock) + 2;
+    if (bus->current_request && bus->current_request->msg != DATA)
+        return global_clock + mc->min_latency () + 2;
+
+    return global_clock + 1;
 }
 
 Processor* Simulator::get_PR (int node)
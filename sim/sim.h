@@ -1,13 +1,35 @@
 #ifndef SIM_H
 #define SIM_H
 
+#include <stdio.h>
+#include <string>
+
+#include "branch.h"
 #include "bus.h"
+#include "checkpoint.h"
 #include "enums.h"
+#include "estimate.h"
 #include "node.h"
+#include "lockstep.h"
+#include "period.h"
+#include "replay.h"
+#include "sample.h"
+#include "scheduler.h"
 #include "settings.h"
+#include "simpoint.h"
+#include "stats.h"
+#include "thread_pool.h"
 #include "types.h"
 
-#define Global_Clock Sim->global_clock
+/** Threads of the optimistic engine each run at their own point in time and
+ *  point sim_thread_clock at it; everyone else sees the global clock.  */
+extern thread_local timestamp_t *sim_thread_clock;
+#define Global_Clock (sim_thread_clock ? *sim_thread_clock : Sim->global_clock)
+
+/** Destination of all simulator output.  Threads that run nodes in parallel
+ *  point sim_log_stream at a per-node buffer; everyone else writes to stderr.  */
+extern thread_local FILE *sim_log_stream;
+#define SIM_LOG (sim_log_stream ? sim_log_stream : stderr)
 
 class Node;
 class Processor;
@@ -17,6 +39,17 @@ class Memory_controller;
 
 void fatal_error (const char *fmt, ...) __attribute__ ((noreturn));
 
+/** Set by threads that have to outlive a simulation that fails, as the
+ *  workers of the job server do (see daemon.h): fatal_error then throws a
+ *  Sim_error for them rather than ending the process.  */
+extern thread_local bool fatal_throws;
+
+class Sim_error {
+public:
+    std::string msg;
+    Sim_error (const char *msg) : msg (msg) {}
+};
+
 class Simulator {
 public:
     Simulator ();
@@ -27,9 +60,63 @@ public:
     Node **Nd;
     Bus *bus;
 
+    /** Pending module wakeups, only allocated by the event engine.  */
+    Scheduler *scheduler;
+
+    /** Steady state extrapolation, only allocated when enabled.  */
+    Period_detector *periods;
+
+    /** Analytical estimate, only allocated when asked for.  */
+    Estimator *estimator;
+
+    /** Set once the checkpoint has been saved.  */
+    bool checkpointed;
+
+    /** Variant runs, only allocated when there are variants.  */
+    Brancher *brancher;
+    bool branched;
+
+    /** Sampled run, only allocated when enabled.  */
+    Sampler *sampler;
+
+    /** Representative intervals, only allocated when enabled.  */
+    Simpoints *simpoints;
+
+    /** Bus log being written, or being replayed, only allocated when asked
+     *  for.  */
+    Bus_recorder *recorder;
+    Replayer *replayer;
+
+    /** Check against a second engine, only allocated when asked for.  */
+    Lockstep *lockstep;
+
+    /** Where the draws of a jittered run are, from settings.jitter_seed.  */
+    uint64_t jitter_state;
+
+    /** A draw in [0, n).  */
+    int jitter (int n);
+
+    /** Set if the run was given up on at settings.cycle_bound.  */
+    bool stopped;
+
     /** Run/Fini for simulator.  */
     void run (void);
+    void run_engine (void);
+    void run_tick (void);
+    void run_event (void);
+    void run_parallel (void);
+    void run_optimistic (void);
+    bool all_processors_done (void);
+    void start_cycle (void);
+    void wake_all (void);
+    void apply_settings (void);
+    void warm_up (void);
     void dump_stats (void);
+    timestamp_t next_active_cycle (void);
+    timestamp_t next_snoop_cycle (void);
+
+    /** Wake a module for the event engine; a no-op under the tick engine.  */
+    void schedule (phase_t phase, int nodeID, timestamp_t when);
 
     /** Accessor functions */
     Processor *get_PR (int node);
@@ -41,10 +128,23 @@ public:
 	void dump_outstanding_requests (int nodeID);
     void dump_cache_block (int nodeID, paddr_t addr);
 
-    unsigned long int cache_misses;
-    unsigned long int cache_accesses;
-    unsigned long int silent_upgrades;
-    unsigned long int cache_to_cache_transfers;
+    /** Totals over all caches, filled in by collect_stats ().  */
+    Sim_stats stats;
+    void collect_stats (void);
+
+    /** Collects the stats, too.  */
+    Sim_result result (void);
+
+    /** Parallel engine.  */
+    Thread_pool *pool;
+    VECTOR<FILE *> node_logs;
+    VECTOR<char *> node_log_bufs;
+    VECTOR<size_t> node_log_sizes;
+
+    bool node_has_work (phase_t phase, int nodeID);
+    void run_node_phase (phase_t phase, int nodeID);
+    void run_parallel_phase (phase_t phase);
+    void flush_node_logs (void);
 };
 
 #endif
@@ -0,0 +1,314 @@
+#include <algorithm>
+#include <float.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "memory.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+#include "simpoint.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+static inline unsigned int bucket (paddr_t line)
+{
+    uint64_t h = line * 0x9e3779b97f4a7c15ULL;
+    return (h >> 32) % SIMPOINT_DIMS;
+}
+
+static double distance (double *a, double *b)
+{
+    double d = 0;
+
+    for (int i = 0; i < 2 * SIMPOINT_DIMS; i++)
+        d += (a[i] - b[i]) * (a[i] - b[i]);
+    return d;
+}
+
+Simpoints::Simpoints ()
+{
+    detailed_references = 0;
+    functional_references = 0;
+    detailed_cycles = 0;
+}
+
+Simpoints::~Simpoints ()
+{
+}
+
+void Simpoints::choose (void)
+{
+    profile ();
+    cluster ();
+}
+
+/** Read every trace on its own handle, so the processors' are left at the
+ *  start.  */
+void Simpoints::profile (void)
+{
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        char *trace_file = Sim->get_PR (i)->trace_file;
+        FILE *trace = fopen (trace_file, "r");
+        counter_t count = 0;
+        char c;
+        paddr_t addr;
+
+        if (trace == NULL)
+            fatal_error ("Simpoints: cannot open %s\n", trace_file);
+
+        while (fscanf (trace, "%c 0x%llx\n", &c, (unsigned long long int*)&addr) == 2)
+        {
+            unsigned int k = count++ / settings.simpoint_interval;
+
+            if (k >= intervals.size ())
+            {
+                Interval interval;
+
+                memset (interval.signature, 0, sizeof (interval.signature));
+                interval.references = 0;
+                interval.cluster = -1;
+                intervals.resize (k + 1, interval);
+            }
+
+            intervals[k].signature[bucket (addr >> settings.cache_line_size_log2) +
+                                   (c == 'w' ? SIMPOINT_DIMS : 0)] += 1;
+            intervals[k].references++;
+        }
+        fclose (trace);
+    }
+
+    /** Intervals differ in length only at the end of the traces; what the
+     *  signature compares is the mix.  */
+    for (unsigned int k = 0; k < intervals.size (); k++)
+        for (int d = 0; d < 2 * SIMPOINT_DIMS; d++)
+            intervals[k].signature[d] /= intervals[k].references;
+}
+
+int Simpoints::nearest (double *signature)
+{
+    double best = DBL_MAX;
+    int which = -1;
+
+    for (unsigned int c = 0; c < clusters.size (); c++)
+    {
+        double d = distance (signature, clusters[c].centre);
+        if (d < best)
+        {
+            best = d;
+            which = c;
+        }
+    }
+    return which;
+}
+
+/** k-means, started deterministically from intervals as far apart as
+ *  possible: the first, then each time the one farthest from any centre
+ *  so far.  */
+void Simpoints::cluster (void)
+{
+    int k = min ((long long int)intervals.size (), settings.simpoint_clusters);
+    bool changed = true;
+    Cluster empty;
+
+    if (k <= 0)
+        return;
+
+    memset (empty.centre, 0, sizeof (empty.centre));
+    empty.references = 0;
+    empty.intervals = 0;
+    empty.representative = -1;
+    empty.cycles = 0;
+    empty.measured = 0;
+
+    clusters.push_back (empty);
+    memcpy (clusters[0].centre, intervals[0].signature, sizeof (empty.centre));
+    while ((int)clusters.size () < k)
+    {
+        double farthest = 0;
+        int which = -1;
+
+        for (unsigned int i = 0; i < intervals.size (); i++)
+        {
+            double d = distance (intervals[i].signature,
+                                 clusters[nearest (intervals[i].signature)].centre);
+            if (d > farthest)
+            {
+                farthest = d;
+                which = i;
+            }
+        }
+
+        /** Fewer distinct signatures than clusters.  */
+        if (which < 0)
+            break;
+
+        clusters.push_back (empty);
+        memcpy (clusters.back ().centre, intervals[which].signature, sizeof (empty.centre));
+    }
+
+    for (int iteration = 0; changed && iteration < SIMPOINT_MAX_ITERATIONS; iteration++)
+    {
+        changed = false;
+        for (unsigned int i = 0; i < intervals.size (); i++)
+        {
+            int c = nearest (intervals[i].signature);
+            if (c != intervals[i].cluster)
+            {
+                intervals[i].cluster = c;
+                changed = true;
+            }
+        }
+
+        for (unsigned int c = 0; c < clusters.size (); c++)
+        {
+            memset (clusters[c].centre, 0, sizeof (empty.centre));
+            clusters[c].intervals = 0;
+        }
+        for (unsigned int i = 0; i < intervals.size (); i++)
+        {
+            Cluster &cl = clusters[intervals[i].cluster];
+
+            for (int d = 0; d < 2 * SIMPOINT_DIMS; d++)
+                cl.centre[d] += intervals[i].signature[d];
+            cl.intervals++;
+        }
+        for (unsigned int c = 0; c < clusters.size (); c++)
+            for (int d = 0; d < 2 * SIMPOINT_DIMS; d++)
+                if (clusters[c].intervals)
+                    clusters[c].centre[d] /= clusters[c].intervals;
+    }
+
+    /** The representative is the member nearest the centre.  */
+    for (unsigned int c = 0; c < clusters.size (); c++)
+    {
+        double best = DBL_MAX;
+
+        for (unsigned int i = 0; i < intervals.size (); i++)
+        {
+            if (intervals[i].cluster != (int)c)
+                continue;
+
+            clusters[c].references += intervals[i].references;
+            double d = distance (intervals[i].signature, clusters[c].centre);
+            if (d < best)
+            {
+                best = d;
+                clusters[c].representative = i;
+            }
+        }
+    }
+}
+
+void Simpoints::run (void)
+{
+    VECTOR<FILE *> traces (settings.num_nodes);
+    VECTOR<int> order;
+    unsigned int position = 0;
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        traces[i] = Sim->get_PR (i)->infile;
+
+    for (unsigned int c = 0; c < clusters.size (); c++)
+        if (clusters[c].representative >= 0)
+            order.push_back (c);
+    sort (order.begin (), order.end (), [this] (int a, int b) {
+        return clusters[a].representative < clusters[b].representative;
+    });
+
+    for (unsigned int n = 0; n < order.size (); n++)
+    {
+        Cluster &cl = clusters[order[n]];
+        Bus *bus = Sim->bus;
+        timestamp_t start;
+        Sim_stats before;
+
+        if ((unsigned int)cl.representative > position)
+            functional_references += model.run (traces, (cl.representative - position) *
+                                                        settings.simpoint_interval);
+
+        Sim->collect_stats ();
+        before = Sim->stats;
+        start = Sim->global_clock;
+
+        for (int i = 0; i < settings.num_nodes; i++)
+            Sim->get_PR (i)->resume (settings.simpoint_interval);
+        Sim->run_engine ();
+
+        if (bus->request_in_progress || !bus->pending_requests.empty () || bus->data_reply ||
+            Sim->get_MC (settings.num_nodes)->request_in_progress)
+            fatal_error ("Simpoints: the bus is still busy after interval %d, cycle %lld\n",
+                         cl.representative, (long long int)Sim->global_clock);
+
+        Sim->collect_stats ();
+        cl.stats = Sim->stats;
+        cl.stats -= before;
+        cl.measured = cl.stats.cache_accesses;
+        cl.cycles = Sim->global_clock - start;
+
+        detailed_references += cl.measured;
+        detailed_cycles += Sim->global_clock - start;
+        position = cl.representative + 1;
+    }
+
+    /** The rest only so the final cache contents and counters are those of
+     *  the whole run.  */
+    functional_references += model.run (traces, 0);
+    for (int i = 0; i < settings.num_nodes; i++)
+        Sim->get_PR (i)->resume (-1);
+    Sim->run_engine ();
+
+    Sim->global_clock = (timestamp_t)(estimate (NULL) + 0.5);
+}
+
+/** Sum over the clusters of what the representative measured per
+ *  reference, times the references in the cluster: for counter, or for
+ *  the cycles if it is NULL.  */
+double Simpoints::estimate (counter_t Sim_stats::*counter)
+{
+    double total = 0;
+
+    for (unsigned int c = 0; c < clusters.size (); c++)
+    {
+        Cluster &cl = clusters[c];
+
+        if (cl.measured == 0)
+            continue;
+        total += (counter ? cl.stats.*counter : cl.cycles) * cl.references / cl.measured;
+    }
+    return total;
+}
+
+void Simpoints::report (void)
+{
+    counter_t references = detailed_references + functional_references;
+
+    fprintf (stdout, "\n%d intervals of %lld references per core in %d phases:\n",
+             (int)intervals.size (), (long long int)settings.simpoint_interval,
+             (int)clusters.size ());
+    fprintf (stdout, "%8s %10s %8s %15s %12s\n", "Phase", "Intervals", "Weight",
+             "Representative", "Cycles/Ref");
+    for (unsigned int c = 0; c < clusters.size (); c++)
+    {
+        Cluster &cl = clusters[c];
+
+        fprintf (stdout, "%8d %10d %7.1f%% %15d %12.2f\n", c, cl.intervals,
+                 references ? 100.0 * cl.references / references : 0.0,
+                 cl.representative, cl.measured ? cl.cycles / cl.measured : 0.0);
+    }
+
+    fprintf (stdout, "%-18s %12.0f\n", "Run Time:", estimate (NULL));
+    fprintf (stdout, "%-18s %12.0f\n", "Cache Misses:", estimate (&Sim_stats::cache_misses));
+    fprintf (stdout, "%-18s %12.0f\n", "Silent Upgrades:", estimate (&Sim_stats::silent_upgrades));
+    fprintf (stdout, "%-18s %12.0f\n", "$-to-$ Transfers:",
+             estimate (&Sim_stats::cache_to_cache_transfers));
+    fprintf (stdout, "Detailed:          %12lld of %lld references (%.1f%%), %lld cycles\n",
+             (long long int)detailed_references, (long long int)references,
+             references ? 100.0 * detailed_references / references : 0.0,
+             (long long int)detailed_cycles);
+}
@@ -0,0 +1,82 @@
+#ifndef SIMPOINT_H_
+#define SIMPOINT_H_
+
+#include "functional.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/** Buckets the lines of a signature are hashed into, for reads and for
+ *  writes each.  */
+#define SIMPOINT_DIMS           32
+
+/** Bound on the k-means iterations.  */
+#define SIMPOINT_MAX_ITERATIONS 100
+
+/**
+ * Simulates a few representative intervals of the traces in place of all
+ * of them, after SimPoint.
+ *
+ * A pre-pass over the trace files splits them into intervals of
+ * simpoint_interval references per core, and gives every interval a
+ * signature: how often it touches each line, read and written separately,
+ * hashed down to a fixed number of buckets and normalized.  The signatures
+ * are clustered with k-means into at most simpoint_clusters phases, and
+ * the interval nearest the centre of each phase stands for all of it.
+ *
+ * The run then plays the traces through the functional model, which keeps
+ * the caches warm, and switches to the detailed engine for each of the
+ * representatives in turn.  What each one measures per reference, weighted
+ * by the references in its phase, estimates the whole run.
+ */
+class Simpoints {
+public:
+    Simpoints ();
+    ~Simpoints ();
+
+    /** Pre-pass: signatures, clusters and representatives.  */
+    void choose (void);
+
+    /** Runs the simulation in place of the engine, leaving the clock at
+     *  the estimated run time.  */
+    void run (void);
+
+    void report (void);
+
+private:
+    class Interval {
+    public:
+        double signature[2 * SIMPOINT_DIMS];
+        counter_t references;
+        int cluster;
+    };
+
+    class Cluster {
+    public:
+        double centre[2 * SIMPOINT_DIMS];
+        counter_t references;
+        int intervals;
+        int representative;
+
+        /** What the representative measured, per reference.  */
+        double cycles;
+        Sim_stats stats;
+        counter_t measured;
+    };
+
+    VECTOR<Interval> intervals;
+    VECTOR<Cluster> clusters;
+    Functional_model model;
+
+    counter_t detailed_references;
+    counter_t functional_references;
+    timestamp_t detailed_cycles;
+
+    void profile (void);
+    void cluster (void);
+    int nearest (double *signature);
+    double estimate (counter_t Sim_stats::*counter);
+};
+
+#endif /* SIMPOINT_H_ */
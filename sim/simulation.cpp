@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "memo.h"
+#include "settings.h"
+#include "sim.h"
+#include "simulation.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Simulation::Simulation (const Sim_settings &settings, const char *trace_dir)
+{
+    char config_path[1000];
+    FILE *config_file;
+
+    config = settings;
+    config.trace_dir = strdup (trace_dir);
+    log = NULL;
+    memo_hit = false;
+    stopped = false;
+
+    snprintf (config_path, sizeof (config_path), "%s/config", trace_dir);
+    config_file = fopen (config_path, "r");
+    if (config_file == NULL || fscanf (config_file, "%d\n", &config.num_nodes) != 1)
+        fatal_error ("Config File should contain number of traces\n");
+    fclose (config_file);
+
+    if (config.num_nodes == 0)
+        fatal_error ("Error: number of processors is zero.\n");
+}
+
+Simulation::~Simulation ()
+{
+    free (config.trace_dir);
+}
+
+FILE *Simulation::discard (void)
+{
+    static FILE *null_log = fopen ("/dev/null", "w");
+
+    if (null_log == NULL)
+        fatal_error ("Simulation: cannot open /dev/null\n");
+    return null_log;
+}
+
+Sim_result Simulation::run (void)
+{
+    Sim_context caller;
+    FILE *caller_log = sim_log_stream;
+    Sim_result result;
+    Memo *memo = NULL;
+    FILE *capture = NULL;
+    char *captured = NULL;
+    size_t captured_size = 0;
+
+    settings = config;
+    sim_log_stream = log;
+    memo_hit = false;
+
+    /** A run that reads traces shared with others is not worth the hashing.  */
+    if (config.memo_dir && config.plain_run () && !config.trace_source)
+    {
+        memo = new Memo (config);
+
+        if (!config.memo_refresh && memo->load (&result, SIM_LOG))
+            memo_hit = true;
+        else
+            sim_log_stream = capture = open_memstream (&captured, &captured_size);
+    }
+
+    if (!memo_hit)
+    {
+        Sim = NULL;
+        try
+        {
+            Sim = new Simulator ();
+            Sim->run ();
+        }
+        catch (Sim_error &error)
+        {
+            /** Only for a thread that set fatal_throws (see sim.h): it
+             *  carries on, so leave it as it was.  */
+            if (Sim)
+                delete Sim;
+            if (capture)
+            {
+                fclose (capture);
+                free (captured);
+            }
+            if (memo)
+                delete memo;
+            caller.adopt ();
+            sim_log_stream = caller_log;
+            throw;
+        }
+        result = Sim->result ();
+        stopped = Sim->stopped;
+        delete Sim;
+    }
+
+    if (capture)
+    {
+        fclose (capture);
+        sim_log_stream = log;
+        memo->store (result, captured, captured_size);
+        fwrite (captured, 1, captured_size, SIM_LOG);
+        free (captured);
+    }
+
+    if (memo)
+        delete memo;
+
+    caller.adopt ();
+    sim_log_stream = caller_log;
+
+    return result;
+}
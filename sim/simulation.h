@@ -0,0 +1,51 @@
+#ifndef SIMULATION_H_
+#define SIMULATION_H_
+
+#include <stdio.h>
+
+#include "settings.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * A whole simulation as a library call: settings and traces in, results out.
+ *
+ * The simulator reaches the run it is part of through Sim and settings,
+ * which are per thread.  run () points the calling thread's at this
+ * simulation for as long as it takes and then puts back what was there, so
+ * one thread can run any number of simulations in turn, and simulations on
+ * different threads run side by side without touching each other.  Threads
+ * an engine starts take on the simulation of the thread that starts them
+ * (see Sim_context).
+ *
+ * Variants (see branch.h) and lockstep checks (see lockstep.h) fork, and
+ * the processes they fork exit when they are done: they are only for the
+ * command line.
+ */
+class Simulation {
+public:
+    /** Takes the number of cores from the config file in trace_dir.  */
+    Simulation (const Sim_settings &settings, const char *trace_dir);
+    ~Simulation ();
+
+    Sim_settings config;
+
+    /** Where the run logs to; NULL for stderr, discard () for nowhere.  */
+    FILE *log;
+
+    /** Set by run () if the result came from the memo cache.  */
+    bool memo_hit;
+
+    /** Set by run () if the run was given up on at config.cycle_bound, so
+     *  that it only got as far as the run time in the result.  */
+    bool stopped;
+
+    Sim_result run (void);
+
+    /** A log that goes nowhere, shared by every run given it.  */
+    static FILE *discard (void);
+};
+
+#endif /* SIMULATION_H_ */
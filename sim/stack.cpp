@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hash_table.h"
+#include "settings.h"
+#include "sim.h"
+#include "stack.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+Stack_study::Stack_study (const char *spec)
+{
+    char *copy = strdup (spec);
+    char *item, *save = NULL;
+
+    for (item = strtok_r (copy, ",", &save); item; item = strtok_r (NULL, ",", &save))
+    {
+        Config config;
+        char *end;
+        int sets;
+
+        config.size = strtol (item, &end, 0);
+        config.assoc = *end == ':' ? strtol (end + 1, &end, 0) : settings.l1_cache_assoc;
+
+        if (*end != '\0' || config.size <= 0 || config.assoc <= 0 ||
+            config.size % (config.assoc * settings.cache_line_size))
+            fatal_error ("Stack study: invalid cache %s\n", item);
+
+        sets = config.size / (config.assoc * settings.cache_line_size);
+        if (!ISPOW2 (sets))
+            fatal_error ("Stack study: %s has %d sets, not a power of 2\n", item, sets);
+
+        for (config.mapping = 0; config.mapping < (int)mappings.size (); config.mapping++)
+            if (mappings[config.mapping].sets == sets)
+                break;
+
+        if (config.mapping == (int)mappings.size ())
+        {
+            Mapping m;
+
+            m.sets = sets;
+            m.depth = 0;
+            m.index_mask = (paddr_t)(sets - 1) << settings.cache_line_size_log2;
+            mappings.push_back (m);
+        }
+
+        Mapping &m = mappings[config.mapping];
+        m.depth = max (m.depth, config.assoc);
+        configs.push_back (config);
+    }
+    free (copy);
+
+    if (configs.empty ())
+        fatal_error ("Stack study: no caches given\n");
+
+    for (unsigned int i = 0; i < mappings.size (); i++)
+    {
+        Mapping &m = mappings[i];
+
+        m.lines.resize ((size_t)settings.num_nodes * m.sets * m.depth);
+        m.used.resize ((size_t)settings.num_nodes * m.sets, 0);
+        m.hits.resize (m.depth, 0);
+    }
+
+    references = 0;
+    model_misses = 0;
+    invalidations = 0;
+    last_misses.resize (settings.num_nodes, 0);
+
+    Hash_entry probe (Sim->get_L1 (0), 0);
+    invalid_state = probe.protocol->get_state ();
+}
+
+Stack_study::~Stack_study ()
+{
+}
+
+void Stack_study::run (void)
+{
+    Functional_model model;
+    VECTOR<FILE *> traces (settings.num_nodes);
+    char trace_file[1000];
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        snprintf (trace_file, sizeof (trace_file), "%s/p%d.trace", settings.trace_dir, i);
+        traces[i] = fopen (trace_file, "r");
+        if (traces[i] == NULL)
+            fatal_error ("Stack study: cannot open %s\n", trace_file);
+    }
+
+    model.hook = this;
+    model.run (traces, 0);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        fclose (traces[i]);
+        Sim->get_L1 (i)->clear ();
+    }
+}
+
+void Stack_study::reference (int node, char op, paddr_t addr, bool bus)
+{
+    Hash_table *cache = Sim->get_L1 (node);
+    bool missed = cache->stats.cache_misses != last_misses[node];
+
+    last_misses[node] = cache->stats.cache_misses;
+    references++;
+    if (missed)
+        model_misses++;
+
+    for (unsigned int i = 0; i < mappings.size (); i++)
+        touch (mappings[i], node, addr, missed);
+
+    /** Only a bus request invalidates, and only the line it is for.  */
+    if (!bus)
+        return;
+
+    for (int j = 0; j < settings.num_nodes; j++)
+    {
+        Hash_entry *entry;
+
+        if (j == node)
+            continue;
+
+        bool held = false;
+
+        entry = Sim->get_L1 (j)->find_entry (addr);
+        if (entry == NULL || entry->protocol->get_state () != invalid_state)
+            continue;
+
+        for (unsigned int i = 0; i < mappings.size (); i++)
+            held |= drop (mappings[i], j, addr);
+        if (held)
+            invalidations++;
+    }
+}
+
+/** Count the reference at the depth it is found at, unless the model
+ *  missed, and move its line to the top of the stack.  */
+void Stack_study::touch (Mapping &m, int node, paddr_t line, bool missed)
+{
+    size_t set = (size_t)node * m.sets + ((line & m.index_mask) >> settings.cache_line_size_log2);
+    paddr_t *stack = &m.lines[set * m.depth];
+    int &used = m.used[set];
+    int depth;
+
+    for (depth = 0; depth < used; depth++)
+        if (stack[depth] == line)
+            break;
+
+    if (depth < used)
+    {
+        if (!missed)
+            m.hits[depth]++;
+    }
+    else if (used < m.depth)
+        used++;
+    else
+        depth = used - 1;
+
+    memmove (stack + 1, stack, depth * sizeof (paddr_t));
+    stack[0] = line;
+}
+
+bool Stack_study::drop (Mapping &m, int node, paddr_t line)
+{
+    size_t set = (size_t)node * m.sets + ((line & m.index_mask) >> settings.cache_line_size_log2);
+    paddr_t *stack = &m.lines[set * m.depth];
+    int &used = m.used[set];
+
+    for (int depth = 0; depth < used; depth++)
+        if (stack[depth] == line)
+        {
+            memmove (stack + depth, stack + depth + 1, (used - depth - 1) * sizeof (paddr_t));
+            used--;
+            return true;
+        }
+    return false;
+}
+
+void Stack_study::report (void)
+{
+    fprintf (stdout, "\nStack Study: %lld references, %lld missed at any size, "
+             "%lld lines invalidated in the stacks\n", (long long int)references,
+             (long long int)model_misses, (long long int)invalidations);
+    fprintf (stdout, "%10s %6s %6s %10s %9s\n", "Size", "Ways", "Sets", "Misses", "Miss Rate");
+
+    for (unsigned int i = 0; i < configs.size (); i++)
+    {
+        Config &config = configs[i];
+        Mapping &m = mappings[config.mapping];
+        counter_t misses = references;
+
+        for (int d = 0; d < config.assoc; d++)
+            misses -= m.hits[d];
+
+        fprintf (stdout, "%10d %6d %6d %10lld %8.2f%%\n", config.size, config.assoc, m.sets,
+                 (long long int)misses, references ? 100.0 * misses / references : 0.0);
+    }
+}
@@ -0,0 +1,75 @@
+#ifndef STACK_H_
+#define STACK_H_
+
+#include "functional.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Misses of a range of L1 caches, by size and associativity, out of one
+ * pass of the functional model (see functional.h) over the traces.
+ *
+ * The caches of the model are infinite, and they settle coherence: a
+ * reference they miss on (a first touch, a line another core has
+ * invalidated, a store to a shared line) misses in every cache.  One they
+ * hit on also hits in an LRU cache of A ways if fewer than A other lines
+ * of its set were touched by the core since.  By the inclusion property of
+ * LRU, one stack of lines per set and core then serves all associativities
+ * with the same number of sets: the depth a reference is found at is the
+ * fewest ways it hits with.  So the pass keeps a set of stacks per number
+ * of sets, each no deeper than the most ways asked for, and a line the
+ * model invalidates leaves its core's stacks as well.
+ *
+ * Lines are what the caches of the model key their entries by, and they
+ * map to sets by the index bits of Hash_table.
+ */
+class Stack_study : public Functional_hook {
+public:
+    Stack_study (const char *spec);
+    ~Stack_study ();
+
+    void run (void);
+    void reference (int node, char op, paddr_t addr, bool bus);
+
+    /** Goes to stdout.  */
+    void report (void);
+
+private:
+    class Config {
+    public:
+        int size;
+        int assoc;
+        int mapping;
+    };
+
+    class Mapping {
+    public:
+        int sets;
+        int depth;
+        paddr_t index_mask;
+
+        /** depth lines per set and core, most recently used first, of
+         *  which used are in use.  */
+        VECTOR<paddr_t> lines;
+        VECTOR<int> used;
+
+        /** References that hit at each depth.  */
+        VECTOR<counter_t> hits;
+    };
+
+    VECTOR<Config> configs;
+    VECTOR<Mapping> mappings;
+
+    counter_t references;
+    counter_t model_misses;
+    counter_t invalidations;
+    VECTOR<counter_t> last_misses;
+    int invalid_state;
+
+    void touch (Mapping &m, int node, paddr_t line, bool missed);
+    /** False if the line was not in the stack.  */
+    bool drop (Mapping &m, int node, paddr_t line);
+};
+
+#endif /* STACK_H_ */
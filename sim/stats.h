@@ -0,0 +1,70 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#include "types.h"
+
+/**
+ * Event counters reported at the end of a run.  Every cache keeps its own
+ * set so that caches never share a counter; the simulator sums them.
+ */
+class Sim_stats {
+public:
+    counter_t cache_misses;
+    counter_t cache_accesses;
+    counter_t silent_upgrades;
+    counter_t cache_to_cache_transfers;
+
+    /** Dirty lines a finite cache dropped, and wrote back over the bus.  */
+    counter_t writebacks;
+
+    Sim_stats () { clear (); }
+
+    void clear (void)
+    {
+        cache_misses = 0;
+        cache_accesses = 0;
+        silent_upgrades = 0;
+        cache_to_cache_transfers = 0;
+        writebacks = 0;
+    }
+
+    Sim_stats& operator+= (const Sim_stats &s)
+    {
+        cache_misses += s.cache_misses;
+        cache_accesses += s.cache_accesses;
+        silent_upgrades += s.silent_upgrades;
+        cache_to_cache_transfers += s.cache_to_cache_transfers;
+        writebacks += s.writebacks;
+        return *this;
+    }
+
+    Sim_stats& operator-= (const Sim_stats &s)
+    {
+        cache_misses -= s.cache_misses;
+        cache_accesses -= s.cache_accesses;
+        silent_upgrades -= s.silent_upgrades;
+        cache_to_cache_transfers -= s.cache_to_cache_transfers;
+        writebacks -= s.writebacks;
+        return *this;
+    }
+
+    Sim_stats& operator*= (counter_t n)
+    {
+        cache_misses *= n;
+        cache_accesses *= n;
+        silent_upgrades *= n;
+        cache_to_cache_transfers *= n;
+        writebacks *= n;
+        return *this;
+    }
+};
+
+/** What a whole run comes to.  */
+class Sim_result {
+public:
+    timestamp_t run_time;
+    Sim_stats stats;
+    counter_t bus_busy_cycles;
+};
+
+#endif /* STATS_H_ */
@@ -0,0 +1,207 @@
+#include <glob.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <chrono>
+
+#include "sim.h"
+#include "simulation.h"
+#include "sweep.h"
+
+using namespace std;
+
+static double seconds_since (chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double> (chrono::steady_clock::now () - start).count ();
+}
+
+Sweep::Sweep (const char *spec_file)
+{
+    parse (spec_file);
+}
+
+Sweep::~Sweep ()
+{
+    for (unsigned int i = 0; i < trace_dirs.size (); i++)
+        free (trace_dirs[i]);
+    for (unsigned int i = 0; i < variants.size (); i++)
+        free (variants[i]);
+}
+
+void Sweep::parse (const char *spec_file)
+{
+    FILE *spec = fopen (spec_file, "r");
+    char line[4096];
+    int line_no = 0;
+
+    if (spec == NULL)
+        fatal_error ("Sweep: cannot open %s\n", spec_file);
+
+    while (fgets (line, sizeof (line), spec))
+    {
+        char *save = NULL;
+        char *list, *word;
+
+        line_no++;
+        if (strchr (line, '#'))
+            *strchr (line, '#') = '\0';
+
+        list = strtok_r (line, " \t\r\n", &save);
+        if (list == NULL)
+            continue;
+
+        while ((word = strtok_r (NULL, " \t\r\n", &save)) != NULL)
+        {
+            if (!strcmp (list, "protocols"))
+            {
+                protocol_t protocol;
+
+                if (!parse_protocol (word, &protocol))
+                    fatal_error ("Sweep: %s:%d: invalid protocol %s\n", spec_file, line_no, word);
+                protocols.push_back (protocol);
+            }
+            else if (!strcmp (list, "traces"))
+            {
+                glob_t matches;
+
+                if (glob (word, 0, NULL, &matches) != 0)
+                    fatal_error ("Sweep: %s:%d: no trace directory matches %s\n",
+                                 spec_file, line_no, word);
+                for (size_t i = 0; i < matches.gl_pathc; i++)
+                    trace_dirs.push_back (strdup (matches.gl_pathv[i]));
+                globfree (&matches);
+            }
+            else if (!strcmp (list, "variants"))
+            {
+                if (!settings.apply_override (word, false, true))
+                    fatal_error ("Sweep: %s:%d: invalid variant %s\n", spec_file, line_no, word);
+                variants.push_back (strdup (word));
+            }
+            else
+                fatal_error ("Sweep: %s:%d: unknown list %s\n", spec_file, line_no, list);
+        }
+    }
+    fclose (spec);
+
+    if (protocols.empty () || trace_dirs.empty ())
+        fatal_error ("Sweep: %s needs protocols and traces\n", spec_file);
+}
+
+/** Bytes over all the traces in the directory, which is about what it
+ *  takes to run them.  */
+long long Sweep::trace_bytes (const char *trace_dir)
+{
+    long long bytes = 0;
+    struct stat st;
+    char trace_file[1000];
+
+    for (int i = 0; ; i++)
+    {
+        snprintf (trace_file, sizeof (trace_file), "%s/p%d.trace", trace_dir, i);
+        if (stat (trace_file, &st) != 0)
+            break;
+        bytes += st.st_size;
+    }
+
+    return bytes;
+}
+
+void Sweep::run (Sim_settings &base)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+    VECTOR<int> order;
+
+    if (!base.plain_run ())
+        fatal_error ("A sweep runs plain simulations only\n");
+
+    settings = base;
+    settings.verbose = false;
+    settings.num_threads = 1;
+
+    for (unsigned int t = 0; t < trace_dirs.size (); t++)
+    {
+        long long cost = trace_bytes (trace_dirs[t]);
+
+        for (unsigned int p = 0; p < protocols.size (); p++)
+            for (unsigned int v = 0; v < max (variants.size (), (size_t)1); v++)
+            {
+                Job job;
+
+                job.protocol = protocols[p];
+                job.trace_dir = trace_dirs[t];
+                job.variant = variants.empty () ? NULL : variants[v];
+                job.cost = cost;
+                job.seconds = 0;
+                job.memo_hit = false;
+                jobs.push_back (job);
+            }
+    }
+
+    for (unsigned int i = 0; i < jobs.size (); i++)
+        order.push_back (i);
+    stable_sort (order.begin (), order.end (),
+                 [this] (int a, int b) { return jobs[a].cost > jobs[b].cost; });
+
+    Job_pool pool (min (base.num_threads, (int)jobs.size ()));
+    pool.run (order, run_job_worker, this);
+
+    report (pool, seconds_since (start));
+}
+
+void Sweep::run_job_worker (int job, void *arg)
+{
+    ((Sweep *)arg)->run_job (job);
+}
+
+void Sweep::run_job (int i)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+    Job &job = jobs[i];
+    Sim_settings config = settings;
+
+    config.protocol = job.protocol;
+    if (job.variant)
+        config.apply_override (job.variant, true, true);
+
+    Simulation simulation (config, job.trace_dir);
+    simulation.log = Simulation::discard ();
+    job.result = simulation.run ();
+    job.memo_hit = simulation.memo_hit;
+    job.seconds = seconds_since (start);
+}
+
+void Sweep::report (Job_pool &pool, double seconds)
+{
+    double busy = 0;
+    int steals = 0;
+    int kept = 0;
+
+    for (unsigned int i = 0; i < jobs.size (); i++)
+    {
+        busy += jobs[i].seconds;
+        kept += jobs[i].memo_hit;
+    }
+    for (int i = 0; i < pool.num_threads; i++)
+        steals += pool.stolen[i];
+
+    fprintf (stdout, "\nSweep of %d runs on %d threads: %.2f s, %.2f s of runs, %d stolen, "
+             "%d kept from before\n", (int)jobs.size (), pool.num_threads, seconds, busy,
+             steals, kept);
+    fprintf (stdout, "%-8s %-28s %-20s %10s %10s %10s %10s %10s %8s %8s\n", "Protocol",
+             "Traces", "Variant", "Run Time", "Misses", "Accesses", "Upgrades", "$-to-$",
+             "Bus", "Seconds");
+
+    for (unsigned int i = 0; i < jobs.size (); i++)
+    {
+        Job &job = jobs[i];
+        Sim_result &r = job.result;
+
+        fprintf (stdout, "%-8s %-28s %-20s %10lld %10ld %10ld %10ld %10ld %7.1f%% %8.3f\n",
+                 protocol_name (job.protocol), job.trace_dir,
+                 job.variant ? job.variant : "-", (long long int)r.run_time,
+                 r.stats.cache_misses, r.stats.cache_accesses,
+                 r.stats.silent_upgrades, r.stats.cache_to_cache_transfers,
+                 r.run_time ? 100.0 * r.bus_busy_cycles / r.run_time : 0.0, job.seconds);
+    }
+}
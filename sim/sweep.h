@@ -0,0 +1,69 @@
+#ifndef SWEEP_H_
+#define SWEEP_H_
+
+#include "enums.h"
+#include "settings.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Runs every combination of the protocols, trace directories and variants
+ * listed in a spec file, as simulations (see simulation.h) that share one
+ * process, and prints all the results in one table.
+ *
+ * The spec has one list per line, named by its first word, and # starts a
+ * comment:
+ *
+ *     protocols MI MSI MESI MOSI MOESI MOESIF
+ *     traces traces/experiment*
+ *     variants mem_hit_time=50 mem_hit_time=100
+ *
+ * Trace directories may be glob patterns.  Variants are apply_override ()
+ * specs, which may set the presets as well, since each is a run of its own;
+ * without any, each combination runs once with the settings given.
+ *
+ * The runs are jobs on a Job_pool of num_threads workers, and every run is
+ * single threaded.  They start longest first, by the size of their traces,
+ * so that the ones still running at the end are short.
+ */
+class Sweep {
+public:
+    Sweep (const char *spec_file);
+    ~Sweep ();
+
+    /** Runs everything with base settings, then reports to stdout.  */
+    void run (Sim_settings &base);
+
+private:
+    class Job {
+    public:
+        protocol_t protocol;
+        char *trace_dir;
+        char *variant;
+
+        /** Bytes of trace, for the order the jobs start in.  */
+        long long cost;
+
+        Sim_result result;
+        double seconds;
+        bool memo_hit;
+    };
+
+    VECTOR<protocol_t> protocols;
+    VECTOR<char *> trace_dirs;
+    VECTOR<char *> variants;
+    VECTOR<Job> jobs;
+
+    Sim_settings settings;
+
+    void parse (const char *spec_file);
+    long long trace_bytes (const char *trace_dir);
+    void run_job (int job);
+    static void run_job_worker (int job, void *arg);
+    void report (Job_pool &pool, double seconds);
+};
+
+#endif /* SWEEP_H_ */
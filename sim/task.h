@@ -0,0 +1,105 @@
+#ifndef TASK_H_
+#define TASK_H_
+
+#include <coroutine>
+
+/**
+ * Coroutine that models a module.  The module's tick resumes it, but only
+ * once the condition it awaits holds.  A module blocked on a long event
+ * therefore costs one check per cycle under the tick engine and nothing
+ * at all under the event engine, which only ticks modules that were woken.
+ *
+ * A coroutine frame cannot be saved or copied, so a task must keep
+ * everything that outlives a suspension in members of its module, and be
+ * able to carry on from them when it is restarted from the top.
+ */
+class Sim_wait {
+public:
+    virtual bool ready (void) =0;
+};
+
+class Sim_task {
+public:
+    class promise_type {
+    public:
+        /** What the coroutine is suspended on; NULL if it can just go.  */
+        Sim_wait *waiting;
+
+        promise_type () : waiting (NULL) {}
+
+        Sim_task get_return_object ()
+        {
+            return Sim_task (std::coroutine_handle<promise_type>::from_promise (*this));
+        }
+        std::suspend_always initial_suspend () noexcept { return {}; }
+        std::suspend_always final_suspend () noexcept { return {}; }
+        void return_void () {}
+
+        /** fatal_error may throw (optimistic engine): pass it to the caller
+         *  of poll ().  The task is finished afterwards.  */
+        void unhandled_exception () { throw; }
+    };
+
+    typedef std::coroutine_handle<promise_type> handle_t;
+
+    Sim_task () : handle () {}
+    Sim_task (handle_t handle) : handle (handle) {}
+    Sim_task (Sim_task &&task) : handle (task.handle) { task.handle = handle_t (); }
+    ~Sim_task () { if (handle) handle.destroy (); }
+
+    Sim_task& operator= (Sim_task &&task)
+    {
+        if (this != &task)
+        {
+            if (handle)
+                handle.destroy ();
+            handle = task.handle;
+            task.handle = handle_t ();
+        }
+        return *this;
+    }
+
+    bool done (void) { return !handle || handle.done (); }
+
+    /** Resume the coroutine if what it awaits has come about.  */
+    void poll (void)
+    {
+        if (!done () && (!handle.promise ().waiting || handle.promise ().waiting->ready ()))
+            handle.resume ();
+    }
+
+private:
+    handle_t handle;
+};
+
+/** Awaitable that suspends until cond () holds.  */
+template <typename F>
+class Sim_until : public Sim_wait {
+public:
+    F cond;
+    Sim_task::promise_type *promise;
+
+    Sim_until (F cond) : cond (cond), promise (NULL) {}
+
+    bool ready (void) { return cond (); }
+
+    bool await_ready (void) { return cond (); }
+    void await_suspend (Sim_task::handle_t handle)
+    {
+        promise = &handle.promise ();
+        promise->waiting = this;
+    }
+    void await_resume (void)
+    {
+        if (promise)
+            promise->waiting = NULL;
+    }
+};
+
+template <typename F>
+Sim_until<F> wait_until (F cond)
+{
+    return Sim_until<F> (cond);
+}
+
+#endif /* TASK_H_ */
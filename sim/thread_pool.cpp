@@ -0,0 +1,183 @@
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "thread_pool.h"
+
+using namespace std;
+
+Thread_pool::Thread_pool (int num_threads)
+{
+    assert (num_threads > 0);
+
+    this->num_threads = num_threads;
+    generation = 0;
+    loop_n = 0;
+    loop_fn = NULL;
+    loop_arg = NULL;
+    busy = 0;
+    shutdown = false;
+
+    for (int i = 1; i < num_threads; i++)
+        workers.push_back (thread (&Thread_pool::worker_main, this, i));
+}
+
+Thread_pool::~Thread_pool ()
+{
+    {
+        unique_lock<mutex> guard (lock);
+        shutdown = true;
+    }
+    start_cv.notify_all ();
+
+    for (unsigned int i = 0; i < workers.size (); i++)
+        workers[i].join ();
+}
+
+/** Worker id handles a contiguous block of the index space, so the split
+ *  of work among threads is the same for every loop of the same size.  */
+void Thread_pool::run_share (int id)
+{
+    int begin = (long)loop_n * id / num_threads;
+    int end = (long)loop_n * (id + 1) / num_threads;
+
+    for (int i = begin; i < end; i++)
+        loop_fn (i, loop_arg);
+}
+
+void Thread_pool::worker_main (int id)
+{
+    unsigned long seen = 0;
+
+    context.adopt ();
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard (lock);
+            while (!shutdown && generation == seen)
+                start_cv.wait (guard);
+            if (shutdown)
+                return;
+            seen = generation;
+        }
+
+        run_share (id);
+
+        {
+            unique_lock<mutex> guard (lock);
+            if (--busy == 0)
+                done_cv.notify_one ();
+        }
+    }
+}
+
+void Thread_pool::parallel_for (int n, void (*fn) (int, void *), void *arg)
+{
+    if (num_threads == 1 || n <= 1)
+    {
+        for (int i = 0; i < n; i++)
+            fn (i, arg);
+        return;
+    }
+
+    {
+        unique_lock<mutex> guard (lock);
+        loop_n = n;
+        loop_fn = fn;
+        loop_arg = arg;
+        busy = num_threads - 1;
+        generation++;
+    }
+    start_cv.notify_all ();
+
+    run_share (0);
+
+    unique_lock<mutex> guard (lock);
+    while (busy > 0)
+        done_cv.wait (guard);
+}
+
+Job_pool::Job_pool (int num_threads)
+{
+    cpu_set_t allowed;
+
+    assert (num_threads > 0);
+
+    this->num_threads = num_threads;
+    job_fn = NULL;
+    job_arg = NULL;
+
+    if (sched_getaffinity (0, sizeof (allowed), &allowed) == 0)
+        for (int i = 0; i < CPU_SETSIZE; i++)
+            if (CPU_ISSET (i, &allowed))
+                cpus.push_back (i);
+}
+
+Job_pool::~Job_pool ()
+{
+}
+
+void Job_pool::run (VECTOR<int> &jobs, void (*fn) (int, void *), void *arg)
+{
+    VECTOR<thread> workers;
+
+    job_fn = fn;
+    job_arg = arg;
+
+    queues.assign (num_threads, DEQUE<int> ());
+    for (unsigned int i = 0; i < jobs.size (); i++)
+        queues[i % num_threads].push_back (jobs[i]);
+
+    ran.assign (num_threads, 0);
+    stolen.assign (num_threads, 0);
+
+    for (int i = 0; i < num_threads; i++)
+        workers.push_back (thread (&Job_pool::worker_main, this, i));
+
+    for (int i = 0; i < num_threads; i++)
+        workers[i].join ();
+}
+
+/** Front of the worker's own queue, or else of the longest other.  */
+bool Job_pool::next_job (int id, int *job)
+{
+    unique_lock<mutex> guard (lock);
+    int victim = id;
+
+    if (queues[id].empty ())
+        for (int i = 0; i < num_threads; i++)
+            if (queues[i].size () > queues[victim].size ())
+                victim = i;
+
+    if (queues[victim].empty ())
+        return false;
+
+    *job = queues[victim].front ();
+    queues[victim].pop_front ();
+
+    ran[id]++;
+    if (victim != id)
+        stolen[id]++;
+
+    return true;
+}
+
+void Job_pool::worker_main (int id)
+{
+    int job;
+
+    context.adopt ();
+
+    if (!cpus.empty ())
+    {
+        cpu_set_t cpu;
+
+        CPU_ZERO (&cpu);
+        CPU_SET (cpus[id % cpus.size ()], &cpu);
+        pthread_setaffinity_np (pthread_self (), sizeof (cpu), &cpu);
+    }
+
+    while (next_job (id, &job))
+        job_fn (job, job_arg);
+}
@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H_
+#define THREAD_POOL_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "settings.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Fixed set of worker threads that run one data-parallel loop at a time.
+ * The calling thread takes part as worker 0, and parallel_for only returns
+ * once every index has been processed, so each call is a barrier.
+ */
+class Thread_pool {
+public:
+    Thread_pool (int num_threads);
+    ~Thread_pool ();
+
+    int num_threads;
+
+    /** Call fn (i, arg) for every i in [0, n).  */
+    void parallel_for (int n, void (*fn) (int, void *), void *arg);
+
+private:
+    /** Of the thread that built the pool, for the workers.  */
+    Sim_context context;
+
+    VECTOR<thread> workers;
+    mutex lock;
+    condition_variable start_cv;
+    condition_variable done_cv;
+
+    /** Current loop, bumped by generation each time one is posted.  */
+    unsigned long generation;
+    int loop_n;
+    void (*loop_fn) (int, void *);
+    void *loop_arg;
+    int busy;
+    bool shutdown;
+
+    void worker_main (int id);
+    void run_share (int id);
+};
+
+/**
+ * Worker threads that run independent jobs, each to completion, with work
+ * stealing.  The jobs are dealt out in the order given, so each worker's
+ * queue holds its share in that order.  A worker whose queue runs dry
+ * takes the next job from the longest of the other queues.  Each worker is
+ * pinned to a cpu of its own, as far as the calling thread's cpus go.
+ */
+class Job_pool {
+public:
+    Job_pool (int num_threads);
+    ~Job_pool ();
+
+    int num_threads;
+
+    /** Call fn (job, arg) for every job in jobs.  Returns once all are
+     *  done.  */
+    void run (VECTOR<int> &jobs, void (*fn) (int, void *), void *arg);
+
+    /** Jobs each worker ran, and how many of them it stole.  */
+    VECTOR<int> ran;
+    VECTOR<int> stolen;
+
+private:
+    /** Of the thread that built the pool, for the workers.  */
+    Sim_context context;
+
+    mutex lock;
+    VECTOR<DEQUE<int> > queues;
+    VECTOR<int> cpus;
+    void (*job_fn) (int, void *);
+    void *job_arg;
+
+    void worker_main (int id);
+    bool next_job (int id, int *job);
+};
+
+#endif /* THREAD_POOL_H_ */
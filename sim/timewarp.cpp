@@ -0,0 +1,873 @@
+#include <assert.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bus.h"
+#include "hash_table.h"
+#include "memory.h"
+#include "processor.h"
+#include "settings.h"
+#include "sim.h"
+#include "timewarp.h"
+
+using namespace std;
+
+extern thread_local Sim_settings settings;
+extern thread_local Simulator *Sim;
+
+thread_local Tw_lp *tw_lp = NULL;
+thread_local Tw_node_lp *tw_node = NULL;
+
+static Mreq *copy_mreq (Mreq *request)
+{
+    Mreq *copy;
+
+    if (request == NULL)
+        return NULL;
+
+    copy = new Mreq ();
+    *copy = *request;
+    return copy;
+}
+
+/** Overwrite *dst with a copy of src.  */
+static void restore_mreq (Mreq **dst, Mreq *src)
+{
+    if (*dst)
+        delete *dst;
+    *dst = copy_mreq (src);
+}
+
+/***************************************************************************
+ * Tw_lp: event list, rollback and fossil collection.
+ ***************************************************************************/
+Tw_lp::Tw_lp (Tw_kernel *kernel, int id)
+{
+    this->kernel = kernel;
+    this->id = id;
+    clock = 0;
+    current = NULL;
+    next_id = 0;
+    last_time = TW_INFINITY;
+    last_type = TW_DELIVER;
+    poisoned = NULL;
+
+    log_buf = NULL;
+    log_size = 0;
+    log = open_memstream (&log_buf, &log_size);
+
+    events_processed = 0;
+    events_rolled_back = 0;
+    events_committed = 0;
+    rollbacks = 0;
+    anti_messages = 0;
+}
+
+Tw_lp::~Tw_lp ()
+{
+    SET<Tw_event *, Tw_event_less>::iterator it;
+
+    for (it = pending.begin (); it != pending.end (); it++)
+        delete *it;
+    for (unsigned int i = 0; i < inbox.size (); i++)
+        delete inbox[i];
+
+    fclose (log);
+    free (log_buf);
+}
+
+void Tw_lp::send (int dst, tw_time_t time, tw_event_t type, Mreq *msg, bool shared)
+{
+    Tw_event *event;
+
+    assert (current && "Tw_lp: send outside of an event");
+    assert (time >= current->event->time && "Tw_lp: event sent into the past");
+
+    event = new Tw_event ();
+    event->time = time;
+    event->type = type;
+    event->src = id;
+    event->dst = dst;
+    event->id = next_id++;
+    event->anti = false;
+    if (msg)
+        event->msg = *msg;
+    event->shared = shared;
+
+    current->sent.push_back (*event);
+
+    if (dst == id)
+        pending.insert (event);
+    else
+        kernel->lps[dst]->post (event);
+}
+
+/** Sim->schedule () for the modules of this LP.  */
+void Tw_lp::schedule_self (phase_t phase, int nodeID, timestamp_t when)
+{
+    switch (phase) {
+    case BUS_PHASE:   send (id, TW_TIME (when, phase, 0, 0), TW_BUS_TICK, NULL, false); break;
+    case CACHE_PHASE: send (id, TW_TIME (when, phase, nodeID, 0), TW_CACHE_TICK, NULL, false); break;
+    case PR_PHASE:    send (id, TW_TIME (when, phase, nodeID, 0), TW_PR_TICK, NULL, false); break;
+    case MC_PHASE:    send (id, TW_TIME (when, phase, nodeID, 0), TW_MC_TICK, NULL, false); break;
+    case TOCK_PHASE:  send (id, TW_TIME (when, phase, nodeID, 0), TW_TOCK, NULL, false); break;
+    default:
+        fatal_error ("Tw_lp: unknown phase %d\n", phase);
+    }
+}
+
+/** Seed the LP with an event before the run starts.  */
+void Tw_lp::start (tw_time_t time, tw_event_t type)
+{
+    Tw_event *event = new Tw_event ();
+
+    event->time = time;
+    event->type = type;
+    event->src = id;
+    event->dst = id;
+    event->id = next_id++;
+    event->anti = false;
+    event->shared = false;
+    pending.insert (event);
+}
+
+void Tw_lp::post (Tw_event *event)
+{
+    {
+        unique_lock<mutex> guard (inbox_lock);
+        inbox.push_back (event);
+    }
+    inbox_cv.notify_one ();
+}
+
+void Tw_lp::drain_inbox (void)
+{
+    VECTOR<Tw_event *> events;
+
+    {
+        unique_lock<mutex> guard (inbox_lock);
+        events.swap (inbox);
+    }
+
+    for (unsigned int i = 0; i < events.size (); i++)
+        receive (events[i]);
+}
+
+void Tw_lp::receive (Tw_event *event)
+{
+    Tw_event_less less;
+    SET<Tw_event *, Tw_event_less>::iterator it;
+
+    if (event->anti)
+    {
+        /** The positive copy was posted first, so it is either still
+         *  pending or has already been run.  */
+        anti_messages++;
+        it = pending.find (event);
+        if (it == pending.end ())
+        {
+            rollback (event);
+            it = pending.find (event);
+            assert (it != pending.end () && "Tw_lp: anti-message without a twin");
+        }
+        if (*it == poisoned)
+            poisoned = NULL;
+        delete *it;
+        pending.erase (it);
+        delete event;
+        return;
+    }
+
+    /** Straggler.  */
+    if (!processed.empty () && less (event, processed.back ()->event))
+        rollback (event);
+
+    if (poisoned && less (event, poisoned))
+        poisoned = NULL;
+
+    pending.insert (event);
+}
+
+/** Undo every event run at or after event.  */
+void Tw_lp::rollback (Tw_event *event)
+{
+    Tw_event_less less;
+
+    rollbacks++;
+    poisoned = NULL;
+
+    while (!processed.empty () && !less (processed.back ()->event, event))
+    {
+        Tw_record *record = processed.back ();
+        processed.pop_back ();
+        undo (record);
+        events_rolled_back++;
+    }
+}
+
+/** Restore the state from before record's event, cancel what it sent, and
+ *  put the event back in the pending set.  */
+void Tw_lp::undo (Tw_record *record)
+{
+    restore_state (record->state);
+    free_state (record->state);
+    last_time = record->last_time;
+    last_type = record->last_type;
+
+    for (unsigned int i = 0; i < record->sent.size (); i++)
+        cancel (&record->sent[i]);
+
+    pending.insert (record->event);
+    delete record;
+}
+
+void Tw_lp::cancel (Tw_event *sent)
+{
+    SET<Tw_event *, Tw_event_less>::iterator it;
+    Tw_event *anti;
+
+    if (sent->dst == id)
+    {
+        /** Events run after the sender have already been undone, so the
+         *  event is back in the pending set.  */
+        it = pending.find (sent);
+        assert (it != pending.end ());
+        if (*it == poisoned)
+            poisoned = NULL;
+        delete *it;
+        pending.erase (it);
+    }
+    else
+    {
+        anti = new Tw_event (*sent);
+        anti->anti = true;
+        kernel->lps[sent->dst]->post (anti);
+    }
+}
+
+void Tw_lp::reset_log (void)
+{
+    fseek (log, 0, SEEK_SET);
+    fflush (log);
+}
+
+/** Run the earliest pending event if it lies before limit.  */
+bool Tw_lp::process_next (tw_time_t limit)
+{
+    Tw_event *event;
+    Tw_record *record;
+
+    if (pending.empty ())
+        return false;
+
+    event = *pending.begin ();
+    if (event == poisoned || event->time >= limit)
+        return false;
+    pending.erase (pending.begin ());
+
+    record = new Tw_record ();
+    record->event = event;
+    record->state = save_state (event);
+    record->last_time = last_time;
+    record->last_type = last_type;
+
+    current = record;
+    clock = TW_CYCLE (event->time);
+
+    try
+    {
+        if (event->time != last_time || event->type != last_type)
+        {
+            last_time = event->time;
+            last_type = event->type;
+            handle (event);
+        }
+    }
+    catch (Tw_error &error)
+    {
+        current = NULL;
+        reset_log ();
+        undo (record);
+
+        /** Stay put until a rollback changes the picture or GVT shows the
+         *  error is real.  */
+        poisoned = event;
+        poison_msg = error.msg;
+        return false;
+    }
+    current = NULL;
+
+    fflush (log);
+    if (log_size)
+    {
+        record->log.assign (log_buf, log_size);
+        reset_log ();
+    }
+
+    processed.push_back (record);
+    events_processed++;
+    return true;
+}
+
+/** Earliest unprocessed event, pending or still in the inbox.  Only called
+ *  while the LP's thread is stopped.  */
+tw_time_t Tw_lp::next_time (void)
+{
+    tw_time_t time = TW_INFINITY;
+
+    if (!pending.empty ())
+        time = (*pending.begin ())->time;
+    for (unsigned int i = 0; i < inbox.size (); i++)
+        time = min (time, inbox[i]->time);
+    return time;
+}
+
+/** Commit the events before gvt, which can no longer be rolled back.  */
+void Tw_lp::fossil_collect (tw_time_t gvt, VECTOR<pair<tw_time_t, string> > &logs)
+{
+    while (!processed.empty () && processed.front ()->event->time < gvt)
+    {
+        Tw_record *record = processed.front ();
+        processed.pop_front ();
+
+        if (!record->log.empty ())
+            logs.push_back (pair<tw_time_t, string> (record->event->time, record->log));
+
+        free_state (record->state);
+        delete record->event;
+        delete record;
+        events_committed++;
+    }
+}
+
+void Tw_lp::thread_main (void)
+{
+    kernel->context.adopt ();
+    tw_lp = this;
+    tw_node = dynamic_cast<Tw_node_lp *> (this);
+    sim_thread_clock = &clock;
+    sim_log_stream = log;
+
+    while (true)
+    {
+        if (kernel->gvt_requested)
+        {
+            kernel->wait_for_gvt ();
+            if (kernel->finished)
+                break;
+            continue;
+        }
+
+        drain_inbox ();
+
+        if (!process_next (TW_TIME (TW_CYCLE (kernel->gvt) + TW_WINDOW, 0, 0, 0)))
+        {
+            unique_lock<mutex> guard (inbox_lock);
+
+            if (++kernel->idle_lps == (int)kernel->lps.size ())
+                kernel->gvt_cv.notify_all ();
+            while (inbox.empty () && !kernel->gvt_requested)
+                inbox_cv.wait (guard);
+            kernel->idle_lps--;
+        }
+    }
+
+    tw_lp = NULL;
+    tw_node = NULL;
+    sim_thread_clock = NULL;
+    sim_log_stream = NULL;
+}
+
+/***************************************************************************
+ * Tw_node_lp: processor and L1 cache, with incremental state saving.
+ ***************************************************************************/
+class Tw_node_state {
+public:
+    long trace_pos;             /** -1 unless the event may read the trace.  */
+    bool end_of_trace;
+    bool outstanding_request;
+    Mreq *inbound_request;
+    Mreq *inbound_request_buf;
+    Mreq *proc_request;
+    Sim_stats stats;
+    bool done;
+    timestamp_t done_cycle;
+
+    /** The one cache entry the event may touch.  */
+    bool touches_entry;
+    paddr_t addr;
+    bool existed;
+    int state;
+};
+
+Tw_node_lp::Tw_node_lp (Tw_kernel *kernel, int id)
+    : Tw_lp (kernel, id)
+{
+    pr = Sim->get_PR (id);
+    cache = Sim->get_L1 (id);
+    snoop = NULL;
+    done = false;
+    done_cycle = 0;
+}
+
+Tw_node_lp::~Tw_node_lp ()
+{
+}
+
+void *Tw_node_lp::save_state (Tw_event *event)
+{
+    Tw_node_state *s = new Tw_node_state ();
+    Hash_entry *entry;
+
+    s->trace_pos = event->type == TW_PR_TICK ? ftell (pr->infile) : -1;
+    s->end_of_trace = pr->end_of_trace;
+    s->outstanding_request = pr->outstanding_request;
+    s->inbound_request = copy_mreq (pr->inbound_request);
+    s->inbound_request_buf = copy_mreq (pr->inbound_request_buf);
+    s->proc_request = copy_mreq (cache->proc_request);
+    s->stats = cache->stats;
+    s->done = done;
+    s->done_cycle = done_cycle;
+
+    s->touches_entry = false;
+    if (event->type == TW_CACHE_TICK && cache->proc_request)
+    {
+        s->touches_entry = true;
+        s->addr = cache->proc_request->addr;
+    }
+    else if (event->type == TW_SNOOP)
+    {
+        s->touches_entry = true;
+        s->addr = event->msg.addr;
+    }
+
+    if (s->touches_entry)
+    {
+        entry = cache->find_entry (s->addr);
+        s->existed = entry != NULL;
+        s->state = entry ? entry->protocol->get_state () : 0;
+    }
+
+    return s;
+}
+
+void Tw_node_lp::restore_state (void *state)
+{
+    Tw_node_state *s = (Tw_node_state *)state;
+
+    if (s->trace_pos >= 0)
+        fseek (pr->infile, s->trace_pos, SEEK_SET);
+    pr->end_of_trace = s->end_of_trace;
+    pr->outstanding_request = s->outstanding_request;
+    restore_mreq (&pr->inbound_request, s->inbound_request);
+    restore_mreq (&pr->inbound_request_buf, s->inbound_request_buf);
+    restore_mreq (&cache->proc_request, s->proc_request);
+    cache->stats = s->stats;
+    pr->restart ();
+    done = s->done;
+    done_cycle = s->done_cycle;
+
+    if (s->touches_entry)
+    {
+        if (s->existed)
+            cache->get_entry (s->addr)->protocol->set_state (s->state);
+        else if (cache->find_entry (s->addr))
+            cache->remove_entry (s->addr);
+    }
+}
+
+void Tw_node_lp::free_state (void *state)
+{
+    Tw_node_state *s = (Tw_node_state *)state;
+
+    if (s->inbound_request)
+        delete s->inbound_request;
+    if (s->inbound_request_buf)
+        delete s->inbound_request_buf;
+    if (s->proc_request)
+        delete s->proc_request;
+    delete s;
+}
+
+void Tw_node_lp::handle (Tw_event *event)
+{
+    switch (event->type) {
+    case TW_PR_TICK:
+        pr->tick ();
+        if (!done && pr->done ())
+        {
+            done = true;
+            done_cycle = clock;
+        }
+        break;
+
+    case TW_CACHE_TICK:
+        cache->tick ();
+        break;
+
+    case TW_SNOOP:
+        snoop = event;
+        try
+        {
+            cache->tick ();
+        }
+        catch (...)
+        {
+            snoop = NULL;
+            throw;
+        }
+        snoop = NULL;
+        break;
+
+    case TW_TOCK:
+        pr->tock ();
+        break;
+
+    default:
+        fatal_error ("Tw_node_lp: unexpected event %d\n", event->type);
+    }
+}
+
+void Tw_node_lp::bus_request (Mreq *request)
+{
+    send (kernel->bus_lp->id, current->event->time, TW_BUS_REQ, request, false);
+    delete request;
+}
+
+Mreq *Tw_node_lp::bus_snoop (void)
+{
+    return snoop ? copy_mreq (&snoop->msg) : NULL;
+}
+
+void Tw_node_lp::set_shared_line (void)
+{
+    send (kernel->bus_lp->id, current->event->time, TW_SHARED, NULL, false);
+}
+
+/** Only the receiver of DATA reads the shared line, as sampled by the bus
+ *  when it delivered the data.  */
+bool Tw_node_lp::get_shared_line (void)
+{
+    assert (snoop && snoop->msg.msg == DATA && "Shared line read outside a DATA snoop");
+    return snoop->shared;
+}
+
+/***************************************************************************
+ * Tw_bus_lp: bus and memory controller, with copy state saving.
+ ***************************************************************************/
+class Tw_bus_state {
+public:
+    Mreq *current_request;
+    LIST<Mreq *> pending_requests;
+    Mreq *data_reply;
+    bool request_in_progress;
+    bool shared_line;
+    timestamp_t grant_cycle;
+    counter_t busy_cycles;
+
+    bool mc_request_in_progress;
+    timestamp_t mc_data_time;
+    paddr_t mc_data_addr;
+    ModuleID mc_data_target;
+};
+
+Tw_bus_lp::Tw_bus_lp (Tw_kernel *kernel, int id)
+    : Tw_lp (kernel, id)
+{
+    bus = Sim->bus;
+    mc = Sim->get_MC (settings.num_nodes);
+}
+
+Tw_bus_lp::~Tw_bus_lp ()
+{
+}
+
+void *Tw_bus_lp::save_state (Tw_event *event)
+{
+    Tw_bus_state *s = new Tw_bus_state ();
+    LIST<Mreq *>::iterator it;
+
+    s->current_request = copy_mreq (bus->current_request);
+    for (it = bus->pending_requests.begin (); it != bus->pending_requests.end (); it++)
+        s->pending_requests.push_back (copy_mreq (*it));
+    s->data_reply = copy_mreq (bus->data_reply);
+    s->request_in_progress = bus->request_in_progress;
+    s->shared_line = bus->shared_line;
+    s->grant_cycle = bus->grant_cycle;
+    s->busy_cycles = bus->busy_cycles;
+
+    s->mc_request_in_progress = mc->request_in_progress;
+    s->mc_data_time = mc->data_time;
+    s->mc_data_addr = mc->data_addr;
+    s->mc_data_target = mc->data_target;
+
+    return s;
+}
+
+void Tw_bus_lp::restore_state (void *state)
+{
+    Tw_bus_state *s = (Tw_bus_state *)state;
+    LIST<Mreq *>::iterator it;
+
+    restore_mreq (&bus->current_request, s->current_request);
+    while (!bus->pending_requests.empty ())
+    {
+        delete bus->pending_requests.front ();
+        bus->pending_requests.pop_front ();
+    }
+    for (it = s->pending_requests.begin (); it != s->pending_requests.end (); it++)
+        bus->pending_requests.push_back (copy_mreq (*it));
+    restore_mreq (&bus->data_reply, s->data_reply);
+    bus->request_in_progress = s->request_in_progress;
+    bus->shared_line = s->shared_line;
+    bus->grant_cycle = s->grant_cycle;
+    bus->busy_cycles = s->busy_cycles;
+
+    mc->request_in_progress = s->mc_request_in_progress;
+    mc->data_time = s->mc_data_time;
+    mc->data_addr = s->mc_data_addr;
+    mc->data_target = s->mc_data_target;
+    mc->restart ();
+}
+
+void Tw_bus_lp::free_state (void *state)
+{
+    Tw_bus_state *s = (Tw_bus_state *)state;
+    LIST<Mreq *>::iterator it;
+
+    if (s->current_request)
+        delete s->current_request;
+    for (it = s->pending_requests.begin (); it != s->pending_requests.end (); it++)
+        delete *it;
+    if (s->data_reply)
+        delete s->data_reply;
+    delete s;
+}
+
+void Tw_bus_lp::handle (Tw_event *event)
+{
+    Mreq *request;
+    int dest;
+
+    switch (event->type) {
+    case TW_BUS_TICK:
+        bus->tick ();
+        request = bus->current_request;
+        if (request == NULL)
+            break;
+
+        /** DATA goes to its receiver only, once every cache ahead of it has
+         *  had its say on the shared line.  Anything else is snooped by all.  */
+        if (request->msg == DATA)
+        {
+            dest = request->dest_mid.nodeID;
+            if (dest < 0 || dest >= settings.num_nodes)
+                throw Tw_error ("Time Warp: DATA on the bus for no cache\n");
+            send (id, TW_TIME (clock, CACHE_PHASE, dest, 1), TW_DELIVER, NULL, false);
+        }
+        else
+        {
+            for (int i = 0; i < settings.num_nodes; i++)
+                send (i, TW_TIME (clock, CACHE_PHASE, i, 1), TW_SNOOP, request, false);
+        }
+        schedule_self (MC_PHASE, settings.num_nodes, clock);
+        break;
+
+    case TW_DELIVER:
+        request = bus->current_request;
+        assert (request && request->msg == DATA);
+        send (request->dest_mid.nodeID, event->time, TW_SNOOP, request, bus->shared_line);
+        break;
+
+    case TW_MC_TICK:
+        mc->tick ();
+        break;
+
+    case TW_BUS_REQ:
+        bus->bus_request (copy_mreq (&event->msg));
+        break;
+
+    case TW_SHARED:
+        bus->set_shared_line (event->src);
+        break;
+
+    default:
+        fatal_error ("Tw_bus_lp: unexpected event %d\n", event->type);
+    }
+}
+
+/***************************************************************************
+ * Tw_kernel: threads, GVT and commitment.
+ ***************************************************************************/
+Tw_kernel::Tw_kernel ()
+{
+    if (settings.num_nodes > TW_MAX_NODES)
+        fatal_error ("Time Warp: at most %d nodes are supported\n", TW_MAX_NODES);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        nodes.push_back (new Tw_node_lp (this, i));
+        lps.push_back (nodes[i]);
+    }
+    bus_lp = new Tw_bus_lp (this, settings.num_nodes);
+    lps.push_back (bus_lp);
+
+    for (int i = 0; i < settings.num_nodes; i++)
+        nodes[i]->start (TW_TIME (0, PR_PHASE, i, 0), TW_PR_TICK);
+
+    gvt_requested = false;
+    idle_lps = 0;
+    arrived = 0;
+    round = 0;
+    finished = false;
+    gvt = 0;
+    gvt_rounds = 0;
+}
+
+Tw_kernel::~Tw_kernel ()
+{
+    for (unsigned int i = 0; i < lps.size (); i++)
+        delete lps[i];
+}
+
+void Tw_kernel::wait_for_gvt (void)
+{
+    unique_lock<mutex> guard (gvt_lock);
+    unsigned long my_round = round;
+
+    arrived++;
+    gvt_cv.notify_all ();
+    while (round == my_round)
+        gvt_cv.wait (guard);
+}
+
+/** With every LP stopped, GVT is the earliest unprocessed event anywhere.
+ *  Everything before it is final and is committed, in timestamp order.  */
+void Tw_kernel::compute_gvt (void)
+{
+    VECTOR<pair<tw_time_t, string> > logs;
+    Tw_event_less less;
+    Tw_event *first = NULL;
+    Tw_lp *owner = NULL;
+
+    gvt = TW_INFINITY;
+    for (unsigned int i = 0; i < lps.size (); i++)
+    {
+        Tw_lp *lp = lps[i];
+
+        gvt = min (gvt, lp->next_time ());
+        if (!lp->pending.empty () && (!first || less (*lp->pending.begin (), first)))
+        {
+            first = *lp->pending.begin ();
+            owner = lp;
+        }
+        for (unsigned int j = 0; j < lp->inbox.size (); j++)
+        {
+            if (!first || less (lp->inbox[j], first))
+            {
+                first = lp->inbox[j];
+                owner = lp;
+            }
+        }
+    }
+
+    /** An event that failed even though nothing can come before it would
+     *  fail in the serial engines too.  */
+    if (first && first == owner->poisoned)
+        fatal_error ("%s", owner->poison_msg.c_str ());
+
+    for (unsigned int i = 0; i < lps.size (); i++)
+        lps[i]->fossil_collect (gvt, logs);
+
+    stable_sort (logs.begin (), logs.end (),
+                 [] (const pair<tw_time_t, string> &a, const pair<tw_time_t, string> &b)
+                 { return a.first < b.first; });
+    for (unsigned int i = 0; i < logs.size (); i++)
+        fputs (logs[i].second.c_str (), SIM_LOG);
+
+    gvt_rounds++;
+}
+
+timestamp_t Tw_kernel::run (void)
+{
+    VECTOR<thread> threads;
+    timestamp_t end = 0;
+
+    for (unsigned int i = 0; i < lps.size (); i++)
+        threads.push_back (thread (&Tw_lp::thread_main, lps[i]));
+
+    while (!finished)
+    {
+        {
+            unique_lock<mutex> guard (gvt_lock);
+            gvt_cv.wait_for (guard, chrono::milliseconds (1),
+                             [this] { return idle_lps == (int)lps.size (); });
+        }
+
+        gvt_requested = true;
+        for (unsigned int i = 0; i < lps.size (); i++)
+        {
+            {
+                unique_lock<mutex> guard (lps[i]->inbox_lock);
+            }
+            lps[i]->inbox_cv.notify_all ();
+        }
+
+        {
+            unique_lock<mutex> guard (gvt_lock);
+            while (arrived < (int)lps.size ())
+                gvt_cv.wait (guard);
+        }
+
+        compute_gvt ();
+
+        {
+            unique_lock<mutex> guard (gvt_lock);
+            if (gvt == TW_INFINITY)
+                finished = true;
+            arrived = 0;
+            gvt_requested = false;
+            round++;
+        }
+        gvt_cv.notify_all ();
+    }
+
+    for (unsigned int i = 0; i < threads.size (); i++)
+        threads[i].join ();
+
+    for (int i = 0; i < settings.num_nodes; i++)
+    {
+        if (!nodes[i]->done)
+            fatal_error ("Deadlock: processor %d never finished its trace\n", i);
+        end = max (end, nodes[i]->done_cycle + 1);
+    }
+    return end;
+}
+
+/** Goes to stdout, so the simulation output on stderr still matches the
+ *  other engines.  */
+void Tw_kernel::report (void)
+{
+    counter_t processed = 0, rolled_back = 0, committed = 0;
+    counter_t rollbacks = 0, anti_messages = 0;
+
+    for (unsigned int i = 0; i < lps.size (); i++)
+    {
+        processed += lps[i]->events_processed;
+        rolled_back += lps[i]->events_rolled_back;
+        committed += lps[i]->events_committed;
+        rollbacks += lps[i]->rollbacks;
+        anti_messages += lps[i]->anti_messages;
+    }
+
+    fprintf (stdout, "\nTime Warp Statistics (%d LPs):\n", (int)lps.size ());
+    fprintf (stdout, "Events Processed: %8lld events\n", (long long)processed);
+    fprintf (stdout, "Events Committed: %8lld events\n", (long long)committed);
+    fprintf (stdout, "Events Undone:    %8lld events\n", (long long)rolled_back);
+    fprintf (stdout, "Rollbacks:        %8lld rollbacks\n", (long long)rollbacks);
+    fprintf (stdout, "Anti-messages:    %8lld messages\n", (long long)anti_messages);
+    fprintf (stdout, "GVT Rounds:       %8lld rounds\n", (long long)gvt_rounds);
+    fprintf (stdout, "Efficiency:       %8.2f%%\n",
+             processed ? 100.0 * committed / processed : 100.0);
+}
@@ -0,0 +1,250 @@
+#ifndef TIMEWARP_H_
+#define TIMEWARP_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "mreq.h"
+#include "scheduler.h"
+#include "settings.h"
+#include "stats.h"
+#include "types.h"
+
+using namespace std;
+
+/**
+ * Optimistic (Time Warp) engine.  Every processor/L1 pair is a logical
+ * process (LP) with a thread of its own, and the bus together with the
+ * memory controller is one more.  LPs exchange timestamped events and run
+ * them speculatively, rolling back whenever an event turns up in their past.
+ *
+ * A timestamp packs the position of a module activation within a cycle of
+ * the serial engine: cycle, phase, node, and whether a cache activation is
+ * the processor request (0) or the snoop (1) half of Hash_table::tick.
+ * Committing events in timestamp order thus reproduces the serial output.
+ */
+typedef uint64_t tw_time_t;
+
+#define TW_TIME(cycle, phase, node, sub) \
+    (((tw_time_t)(cycle) << 16) | ((tw_time_t)(phase) << 13) | \
+     ((tw_time_t)(node) << 1) | (tw_time_t)(sub))
+#define TW_CYCLE(t)     ((timestamp_t)((t) >> 16))
+#define TW_INFINITY     (~(tw_time_t)0)
+
+/** Largest node count a timestamp has room for.  */
+#define TW_MAX_NODES    4095
+
+/** How many cycles past GVT an LP may run.  Bounds the saved state.  */
+#define TW_WINDOW       4096
+
+/** Event types.  The order breaks ties between events of equal time.  */
+typedef enum {
+    TW_DELIVER = 0,     /** Bus: hand the DATA on the bus to its receiver.  */
+    TW_BUS_TICK,        /** Bus: Bus::tick ().  */
+    TW_MC_TICK,         /** Bus: Memory_controller::tick ().  */
+    TW_BUS_REQ,         /** Bus: a cache put a request on the bus.  */
+    TW_SHARED,          /** Bus: a cache asserted the shared line.  */
+    TW_PR_TICK,         /** Node: Processor::tick ().  */
+    TW_CACHE_TICK,      /** Node: processor request half of Hash_table::tick ().  */
+    TW_SNOOP,           /** Node: snoop half of Hash_table::tick ().  */
+    TW_TOCK             /** Node: Processor::tock ().  */
+} tw_event_t;
+
+class Tw_event {
+public:
+    tw_time_t time;
+    tw_event_t type;
+    int src;            /** Sending LP.  */
+    int dst;            /** Receiving LP.  */
+    long id;            /** Sender's sequence number, shared with its anti-message.  */
+    bool anti;
+    Mreq msg;           /** Bus request, or the request being snooped.  */
+    bool shared;        /** Shared line, as seen by the receiver of DATA.  */
+};
+
+/** Total order on events.  Ignores anti so an anti-message finds its twin.  */
+class Tw_event_less {
+public:
+    bool operator() (const Tw_event *a, const Tw_event *b) const
+    {
+        if (a->time != b->time) return a->time < b->time;
+        if (a->type != b->type) return a->type < b->type;
+        if (a->src != b->src) return a->src < b->src;
+        return a->id < b->id;
+    }
+};
+
+/** Thrown by fatal_error while an LP runs an event.  The error may only be
+ *  an artifact of speculation, so it is not reported until GVT shows the
+ *  event can no longer be rolled back.  */
+class Tw_error {
+public:
+    string msg;
+    Tw_error (const char *msg) : msg (msg) {}
+};
+
+/** An event an LP has run, with what it takes to undo it.  */
+class Tw_record {
+public:
+    Tw_event *event;
+    void *state;                /** Module state from before the event.  */
+    tw_time_t last_time;
+    tw_event_t last_type;
+    VECTOR<Tw_event> sent;      /** Events it sent, to cancel on rollback.  */
+    string log;                 /** Output, printed once committed.  */
+};
+
+class Tw_kernel;
+
+class Tw_lp {
+public:
+    Tw_lp (Tw_kernel *kernel, int id);
+    virtual ~Tw_lp ();
+
+    Tw_kernel *kernel;
+    int id;
+
+    /** Cycle of the event being run; Global_Clock on this LP's thread.  */
+    timestamp_t clock;
+
+    SET<Tw_event *, Tw_event_less> pending;
+    DEQUE<Tw_record *> processed;
+    Tw_record *current;
+    long next_id;
+
+    /** Last event run, so that a module woken twice for the same
+     *  activation only runs once, as with the event engine.  */
+    tw_time_t last_time;
+    tw_event_t last_type;
+
+    /** Next event, which failed when last run.  */
+    Tw_event *poisoned;
+    string poison_msg;
+
+    /** Events posted by other LPs, drained by the owning thread.  */
+    mutex inbox_lock;
+    condition_variable inbox_cv;
+    VECTOR<Tw_event *> inbox;
+
+    FILE *log;
+    char *log_buf;
+    size_t log_size;
+
+    /** Statistics.  */
+    counter_t events_processed;
+    counter_t events_rolled_back;
+    counter_t events_committed;
+    counter_t rollbacks;
+    counter_t anti_messages;
+
+    /** Send an event from the one being run.  */
+    void send (int dst, tw_time_t time, tw_event_t type, Mreq *msg, bool shared);
+    void schedule_self (phase_t phase, int nodeID, timestamp_t when);
+    void start (tw_time_t time, tw_event_t type);
+    void post (Tw_event *event);
+
+    tw_time_t next_time (void);
+    void fossil_collect (tw_time_t gvt, VECTOR<pair<tw_time_t, string> > &logs);
+    void thread_main (void);
+
+protected:
+    virtual void *save_state (Tw_event *event) =0;
+    virtual void restore_state (void *state) =0;
+    virtual void free_state (void *state) =0;
+    virtual void handle (Tw_event *event) =0;
+
+private:
+    void drain_inbox (void);
+    bool process_next (tw_time_t limit);
+    void receive (Tw_event *event);
+    void rollback (Tw_event *event);
+    void undo (Tw_record *record);
+    void cancel (Tw_event *sent);
+    void reset_log (void);
+};
+
+/** Processor and L1 cache of one node.  */
+class Tw_node_lp : public Tw_lp {
+public:
+    Tw_node_lp (Tw_kernel *kernel, int id);
+    ~Tw_node_lp ();
+
+    Processor *pr;
+    Hash_table *cache;
+
+    /** SNOOP event being run, if any.  */
+    Tw_event *snoop;
+
+    /** Cycle in which the processor finished its trace.  */
+    bool done;
+    timestamp_t done_cycle;
+
+    /** Bus interface for the caches, used in place of Sim->bus.  */
+    void bus_request (Mreq *request);
+    Mreq *bus_snoop (void);
+    void set_shared_line (void);
+    bool get_shared_line (void);
+
+protected:
+    void *save_state (Tw_event *event);
+    void restore_state (void *state);
+    void free_state (void *state);
+    void handle (Tw_event *event);
+};
+
+/** The bus and the memory controller.  */
+class Tw_bus_lp : public Tw_lp {
+public:
+    Tw_bus_lp (Tw_kernel *kernel, int id);
+    ~Tw_bus_lp ();
+
+    Bus *bus;
+    Memory_controller *mc;
+
+protected:
+    void *save_state (Tw_event *event);
+    void restore_state (void *state);
+    void free_state (void *state);
+    void handle (Tw_event *event);
+};
+
+class Tw_kernel {
+public:
+    Tw_kernel ();
+    ~Tw_kernel ();
+
+    VECTOR<Tw_lp *> lps;
+    VECTOR<Tw_node_lp *> nodes;
+    Tw_bus_lp *bus_lp;
+
+    /** GVT rounds stop every LP thread at a barrier.  */
+    mutex gvt_lock;
+    condition_variable gvt_cv;
+    atomic<bool> gvt_requested;
+    atomic<int> idle_lps;
+    int arrived;
+    unsigned long round;
+    bool finished;
+    tw_time_t gvt;
+    counter_t gvt_rounds;
+
+    /** Of the thread running the engine, for the LP threads.  */
+    Sim_context context;
+
+    /** Run to completion, returning the cycle the serial engines end on.  */
+    timestamp_t run (void);
+    void wait_for_gvt (void);
+    void report (void);
+
+private:
+    void compute_gvt (void);
+};
+
+/** LP run by the calling thread, if any.  */
+extern thread_local Tw_lp *tw_lp;
+extern thread_local Tw_node_lp *tw_node;
+
+#endif /* TIMEWARP_H_ */
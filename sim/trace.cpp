@@ -0,0 +1,155 @@
+#include <stdio.h>
+
+#include "sim.h"
+#include "trace.h"
+
+using namespace std;
+
+Trace_source::Trace_source (const char *trace_dir, int num_nodes, int instances)
+{
+    this->num_nodes = num_nodes;
+    this->instances = instances;
+    references = 0;
+    chunks = 0;
+    waits = 0;
+
+    for (int i = 0; i < num_nodes; i++)
+    {
+        char trace_file[1000];
+
+        snprintf (trace_file, sizeof (trace_file), "%s/p%d.trace", trace_dir, i);
+        files.push_back (fopen (trace_file, "r"));
+        if (files[i] == NULL)
+            fatal_error ("Trace: cannot open %s\n", trace_file);
+    }
+
+    decoded.resize (num_nodes);
+    first.assign (num_nodes, 0);
+    entered.assign (instances, 0);
+    finished.assign (instances, false);
+}
+
+Trace_source::~Trace_source ()
+{
+    for (int i = 0; i < num_nodes; i++)
+    {
+        fclose (files[i]);
+        for (unsigned int j = 0; j < decoded[i].size (); j++)
+            delete decoded[i][j];
+    }
+}
+
+void Trace_source::finish (int instance)
+{
+    {
+        unique_lock<mutex> guard (lock);
+        finished[instance] = true;
+    }
+    progress.notify_all ();
+}
+
+/** Decode the next chunk of trace node, in the same format, and to the same
+ *  point, as the processor would have.  */
+void Trace_source::decode (int node)
+{
+    Trace_chunk *chunk = new Trace_chunk ();
+    Trace_chunk *last = decoded[node].empty () ? NULL : decoded[node].back ();
+
+    chunk->count = 0;
+    chunk->readers = instances;
+
+    if (last == NULL || last->count == TRACE_CHUNK)
+        while (chunk->count < TRACE_CHUNK)
+        {
+            Trace_ref &ref = chunk->refs[chunk->count];
+
+            if (fscanf (files[node], "%c 0x%llx\n", &ref.op,
+                        (unsigned long long int*)&ref.addr) != 2)
+                break;
+            chunk->count++;
+        }
+
+    decoded[node].push_back (chunk);
+    references += chunk->count;
+    chunks++;
+}
+
+/** Chunk number of trace node, for the given simulation, once it is not too
+ *  far ahead of the others.  */
+Trace_chunk *Trace_source::enter (int instance, int node, long long number)
+{
+    unique_lock<mutex> guard (lock);
+
+    if (instances)
+    {
+        entered[instance]++;
+        progress.notify_all ();
+    }
+
+    while (instances)
+    {
+        long long slowest = -1;
+
+        for (int i = 0; i < instances; i++)
+            if (!finished[i] && (slowest < 0 || entered[i] < slowest))
+                slowest = entered[i];
+
+        if (entered[instance] <= slowest + TRACE_LEAD)
+            break;
+
+        waits++;
+        progress.wait (guard);
+    }
+
+    while (first[node] + (long long)decoded[node].size () <= number)
+        decode (node);
+
+    return decoded[node][number - first[node]];
+}
+
+/** A reader is done with chunk number of trace node.  */
+void Trace_source::leave (int node, long long number)
+{
+    unique_lock<mutex> guard (lock);
+
+    if (instances == 0)
+        return;
+
+    decoded[node][number - first[node]]->readers--;
+
+    while (!decoded[node].empty () && decoded[node].front ()->readers == 0)
+    {
+        delete decoded[node].front ();
+        decoded[node].pop_front ();
+        first[node]++;
+    }
+}
+
+Trace_reader::Trace_reader (Trace_source *source, int instance, int node)
+{
+    this->source = source;
+    this->instance = instance;
+    this->node = node;
+    number = 0;
+    pos = 0;
+    chunk = source->enter (instance, node, number);
+}
+
+Trace_reader::~Trace_reader ()
+{
+    source->leave (node, number);
+}
+
+/** On to the next chunk, unless this was the last.  */
+bool Trace_reader::advance (void)
+{
+    if (chunk->count < TRACE_CHUNK)
+        return false;
+
+    chunk = source->enter (instance, node, number + 1);
+    source->leave (node, number);
+    number++;
+    pos = 0;
+
+    return chunk->count > 0;
+}
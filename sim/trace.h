@@ -0,0 +1,124 @@
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdio.h>
+#include <condition_variable>
+#include <mutex>
+
+#include "types.h"
+
+using namespace std;
+
+/** References decoded at a time from each trace.  */
+#define TRACE_CHUNK         4096
+
+/** Chunks, over all cores, that a simulation may have gone ahead of the
+ *  slowest one before it waits for it.  */
+#define TRACE_LEAD          64
+
+class Trace_ref {
+public:
+    char op;
+    paddr_t addr;
+};
+
+class Trace_chunk {
+public:
+    Trace_ref refs[TRACE_CHUNK];
+
+    /** Short only in the last chunk of a trace.  */
+    int count;
+
+    /** Readers that have yet to move past it.  */
+    int readers;
+};
+
+class Trace_reader;
+
+/**
+ * The traces of a directory, decoded once for several simulations that run
+ * side by side on threads of their own (see fanout.h).
+ *
+ * Each trace is decoded a chunk at a time, when the first simulation gets
+ * to it, and a chunk is freed once every simulation has gone past it.  So
+ * that this stays a handful of chunks, a simulation that gets TRACE_LEAD
+ * chunks ahead of the slowest one still running waits for it to catch up.
+ * The slowest never waits, so they all get to the end.
+ *
+ * With no instances, it is a cache instead (see daemon.h): any number of
+ * simulations may read it, at any pace, and it keeps all it decodes.
+ */
+class Trace_source {
+public:
+    Trace_source (const char *trace_dir, int num_nodes, int instances);
+    ~Trace_source ();
+
+    int num_nodes;
+    int instances;
+
+    /** Simulation instance is done and will read no more.  */
+    void finish (int instance);
+
+    /** Statistics.  */
+    counter_t references;
+    counter_t chunks;
+    counter_t waits;
+
+private:
+    friend class Trace_reader;
+
+    mutex lock;
+    condition_variable progress;
+
+    VECTOR<FILE *> files;
+
+    /** Per trace, the chunks still in use, from chunk number first on.  */
+    VECTOR<DEQUE<Trace_chunk *> > decoded;
+    VECTOR<long long> first;
+
+    /** Per simulation, the chunks it has started on.  */
+    VECTOR<long long> entered;
+    VECTOR<bool> finished;
+
+    Trace_chunk *enter (int instance, int node, long long number);
+    void leave (int node, long long number);
+    void decode (int node);
+};
+
+/** One simulation's place in one trace of a Trace_source.  */
+class Trace_reader {
+public:
+    Trace_reader (Trace_source *source, int instance, int node);
+    ~Trace_reader ();
+
+    /** The next reference, if the trace has not ended.  */
+    bool next (char *op, paddr_t *addr)
+    {
+        if (pos == chunk->count && !advance ())
+            return false;
+
+        *op = chunk->refs[pos].op;
+        *addr = chunk->refs[pos].addr;
+        pos++;
+        return true;
+    }
+
+    /** Back over the reference next () returned last.  */
+    void unread (void)
+    {
+        pos--;
+    }
+
+private:
+    Trace_source *source;
+    int instance;
+    int node;
+
+    Trace_chunk *chunk;
+    long long number;
+    int pos;
+
+    bool advance (void);
+};
+
+#endif /* TRACE_H_ */
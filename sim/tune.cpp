@@ -0,0 +1,503 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+#include "sim.h"
+#include "tune.h"
+
+using namespace std;
+
+static const protocol_t tune_protocols[] = {MI_PRO, MSI_PRO, MESI_PRO, MOSI_PRO,
+                                            MOESI_PRO, MOESIF_PRO};
+
+#define TUNE_PROTOCOLS  6
+
+static const char *list_names[TUNE_LISTS] = {"protocols", "l1_cache_assoc",
+                                             "cache_line_size_log2", "mem_hit_time"};
+
+static double seconds_since (chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double> (chrono::steady_clock::now () - start).count ();
+}
+
+Tuner::Tuner (const char *spec_file)
+{
+    source = NULL;
+    rounds = 0;
+    parse (spec_file);
+}
+
+Tuner::~Tuner ()
+{
+    for (unsigned int i = 0; i < candidates.size (); i++)
+        delete candidates[i];
+    if (source)
+        delete source;
+}
+
+void Tuner::parse (const char *spec_file)
+{
+    FILE *spec = fopen (spec_file, "r");
+    char line[4096];
+    int line_no = 0;
+
+    if (spec == NULL)
+        fatal_error ("Tuner: cannot open %s\n", spec_file);
+
+    while (fgets (line, sizeof (line), spec))
+    {
+        char *save = NULL;
+        char *list, *word;
+        int l;
+
+        line_no++;
+        if (strchr (line, '#'))
+            *strchr (line, '#') = '\0';
+
+        list = strtok_r (line, " \t\r\n", &save);
+        if (list == NULL)
+            continue;
+
+        for (l = 0; l < TUNE_LISTS; l++)
+            if (!strcmp (list, list_names[l]))
+                break;
+        if (l == TUNE_LISTS && strcmp (list, "l1_cache_size"))
+            fatal_error ("Tuner: %s:%d: unknown list %s\n", spec_file, line_no, list);
+
+        while ((word = strtok_r (NULL, " \t\r\n", &save)) != NULL)
+        {
+            protocol_t protocol;
+            char *end;
+            long n;
+
+            if (l == TUNE_PROTOCOL)
+            {
+                if (!parse_protocol (word, &protocol))
+                    fatal_error ("Tuner: %s:%d: invalid protocol %s\n", spec_file, line_no, word);
+                lists[l].push_back (protocol);
+                continue;
+            }
+
+            n = strtol (word, &end, 0);
+            if (*end != '\0' || n < 0 || (n == 0 && l != TUNE_LATENCY) ||
+                (l == TUNE_LINE && n > 16))
+                fatal_error ("Tuner: %s:%d: invalid %s %s\n", spec_file, line_no, list, word);
+
+            if (l == TUNE_LISTS)
+                sizes.push_back (n);
+            else
+                lists[l].push_back (n);
+        }
+    }
+    fclose (spec);
+
+    /** Steps go to the next value up or down.  */
+    sort (sizes.begin (), sizes.end ());
+    sizes.erase (unique (sizes.begin (), sizes.end ()), sizes.end ());
+    for (int l = 0; l < TUNE_LISTS; l++)
+    {
+        if (l != TUNE_PROTOCOL)
+            sort (lists[l].begin (), lists[l].end ());
+        lists[l].erase (unique (lists[l].begin (), lists[l].end ()), lists[l].end ());
+    }
+}
+
+/** Whether the L1 of the configuration has a power of 2 sets.  */
+bool Tuner::valid (int size, int *point)
+{
+    int way_bytes = lists[TUNE_ASSOC][point[TUNE_ASSOC]] << lists[TUNE_LINE][point[TUNE_LINE]];
+
+    return sizes[size] % way_bytes == 0 && sizes[size] / way_bytes > 0 &&
+           ISPOW2 (sizes[size] / way_bytes);
+}
+
+/** Configurations in the whole grid.  */
+int Tuner::space (void)
+{
+    int count = 0;
+    int point[TUNE_LISTS] = {0, 0, 0, 0};
+
+    for (unsigned int s = 0; s < sizes.size (); s++)
+        for (point[TUNE_ASSOC] = 0; point[TUNE_ASSOC] < (int)lists[TUNE_ASSOC].size (); point[TUNE_ASSOC]++)
+            for (point[TUNE_LINE] = 0; point[TUNE_LINE] < (int)lists[TUNE_LINE].size (); point[TUNE_LINE]++)
+                if (valid (s, point))
+                    count++;
+
+    return count * lists[TUNE_PROTOCOL].size () * lists[TUNE_LATENCY].size ();
+}
+
+/** The candidate at point, made the first time it is asked for.  Returns
+ *  its index, or -1 if it has been made before.  */
+int Tuner::candidate (int size, int *point)
+{
+    VECTOR<int> key (point, point + TUNE_LISTS);
+    Candidate *c;
+
+    key.push_back (size);
+    if (tried.find (key) != tried.end ())
+        return -1;
+
+    c = new Candidate ();
+    c->size = size;
+    memcpy (c->point, point, sizeof (c->point));
+    c->bound = TUNE_NO_BOUND;
+    c->done = false;
+    c->stopped = false;
+
+    tried[key] = candidates.size ();
+    candidates.push_back (c);
+    return candidates.size () - 1;
+}
+
+/** Pick the first candidate of a size: the first protocol, and the valid
+ *  geometry nearest the middle of the lists.  */
+void Tuner::start (int size, VECTOR<int> &round)
+{
+    Size &z = searched[size];
+    int point[TUNE_LISTS], middle[TUNE_LISTS], first[TUNE_LISTS];
+    int distance = -1;
+
+    for (int l = 0; l < TUNE_LISTS; l++)
+        middle[l] = (lists[l].size () - 1) / 2;
+    middle[TUNE_PROTOCOL] = 0;
+
+    memcpy (point, middle, sizeof (point));
+    memcpy (first, middle, sizeof (first));
+    for (int a = 0; a < (int)lists[TUNE_ASSOC].size (); a++)
+        for (int b = 0; b < (int)lists[TUNE_LINE].size (); b++)
+        {
+            int d = abs (a - middle[TUNE_ASSOC]) + abs (b - middle[TUNE_LINE]);
+
+            point[TUNE_ASSOC] = a;
+            point[TUNE_LINE] = b;
+            if (valid (size, point) && (distance < 0 || d < distance))
+            {
+                distance = d;
+                first[TUNE_ASSOC] = a;
+                first[TUNE_LINE] = b;
+            }
+        }
+
+    z.best = -1;
+    z.from = -1;
+    z.list = 0;
+    z.quiet = 0;
+    z.rounds = 0;
+    z.stepped = false;
+    z.improved = false;
+    z.converged = false;
+    z.dropped = false;
+
+    /** Nothing fits in this size.  */
+    if (distance < 0)
+    {
+        z.converged = true;
+        return;
+    }
+
+    z.from = candidate (size, first);
+    z.stepped = true;
+    round.push_back (z.from);
+}
+
+/** Add to the round the untried candidates one step from where the size's
+ *  descent is, along the next list that has any.  A list that has none is
+ *  as good as a round along it that did not improve.  */
+void Tuner::step (int size, VECTOR<int> &round)
+{
+    Size &z = searched[size];
+    int moving = 0;
+
+    for (int l = 0; l < TUNE_LISTS; l++)
+        moving += lists[l].size () > 1;
+
+    z.stepped = false;
+    while (!z.stepped && z.quiet < moving)
+    {
+        int l = z.list;
+        int *from = candidates[z.from]->point;
+
+        z.list = (z.list + 1) % TUNE_LISTS;
+        if (lists[l].size () < 2)
+            continue;
+
+        z.rounds++;
+        for (int i = 0; i < (int)lists[l].size (); i++)
+        {
+            int point[TUNE_LISTS];
+            int c;
+
+            /** Protocols are not in any order.  */
+            if (i == from[l] || (l != TUNE_PROTOCOL && abs (i - from[l]) != 1))
+                continue;
+
+            memcpy (point, from, sizeof (point));
+            point[l] = i;
+            if (!valid (size, point) || (c = candidate (size, point)) < 0)
+                continue;
+
+            round.push_back (c);
+            z.stepped = true;
+        }
+
+        if (!z.stepped)
+            z.quiet++;
+    }
+
+    if (z.quiet >= moving)
+        z.converged = true;
+}
+
+/** Move each size's descent to its best candidate, then drop the sizes
+ *  that a round along every list has left no faster than a smaller one.  */
+void Tuner::finish_round (VECTOR<int> &round)
+{
+    int moving = 0;
+
+    for (int l = 0; l < TUNE_LISTS; l++)
+        moving += lists[l].size () > 1;
+
+    for (unsigned int i = 0; i < round.size (); i++)
+    {
+        Candidate *c = candidates[round[i]];
+        Size &z = searched[c->size];
+
+        if (c->stopped)
+            continue;
+        if (z.best < 0 || c->result.run_time < candidates[z.best]->result.run_time)
+        {
+            z.best = round[i];
+            z.from = round[i];
+            z.improved = true;
+        }
+    }
+
+    for (unsigned int s = 0; s < sizes.size (); s++)
+    {
+        Size &z = searched[s];
+
+        if (!z.stepped)
+            continue;
+
+        z.quiet = z.improved || z.rounds == 0 ? 0 : z.quiet + 1;
+        z.stepped = false;
+        z.improved = false;
+        if (z.quiet >= moving)
+            z.converged = true;
+
+        if (z.converged || z.rounds < moving)
+            continue;
+
+        for (unsigned int t = 0; t < s; t++)
+            if (best_time[t] != TUNE_NO_BOUND && best_time[t] <= best_time[s])
+            {
+                z.dropped = true;
+                break;
+            }
+    }
+}
+
+/** Best run time finished at the size or any smaller one.  */
+timestamp_t Tuner::bound_at (int size)
+{
+    timestamp_t bound = TUNE_NO_BOUND;
+
+    for (int s = 0; s <= size; s++)
+        bound = min (bound, best_time[s]);
+    return bound;
+}
+
+void Tuner::run (Sim_settings &base, const char *trace_dir)
+{
+    chrono::steady_clock::time_point start_time = chrono::steady_clock::now ();
+    int num_threads;
+
+    if (!base.plain_run ())
+        fatal_error ("The tuner runs plain simulations only\n");
+
+    /** Rolling back reopens the trace files, which are not read here.  */
+    if (base.engine == OPTIMISTIC_ENGINE)
+        fatal_error ("The tuner needs a synchronous engine\n");
+
+    settings = base;
+    settings.verbose = false;
+    settings.num_threads = 1;
+    settings.l1_infinite = 0;
+    this->trace_dir = trace_dir;
+
+    if (sizes.empty ())
+        sizes.push_back (base.l1_cache_size);
+    if (lists[TUNE_PROTOCOL].empty ())
+    {
+        if (base.protocol != NULL_PRO)
+            lists[TUNE_PROTOCOL].push_back (base.protocol);
+        else
+            lists[TUNE_PROTOCOL].assign (tune_protocols, tune_protocols + TUNE_PROTOCOLS);
+    }
+    if (lists[TUNE_ASSOC].empty ())
+        lists[TUNE_ASSOC].push_back (base.l1_cache_assoc);
+    if (lists[TUNE_LINE].empty ())
+        lists[TUNE_LINE].push_back (base.cache_line_size_log2);
+    if (lists[TUNE_LATENCY].empty ())
+        lists[TUNE_LATENCY].push_back (base.mem_hit_time);
+
+    /** For the number of cores.  */
+    Simulation probe (settings, trace_dir);
+
+    /** The candidates run at any pace, so the trace stays decoded in full.  */
+    source = new Trace_source (trace_dir, probe.config.num_nodes, 0);
+    settings.trace_source = source;
+    settings.trace_instance = 0;
+
+    best_time.assign (sizes.size (), TUNE_NO_BOUND);
+    searched.resize (sizes.size ());
+
+    num_threads = base.num_threads;
+    Job_pool pool (num_threads);
+
+    while (true)
+    {
+        VECTOR<int> round;
+
+        /** Smallest size first: theirs are the bounds of the others.  */
+        for (unsigned int s = 0; s < sizes.size (); s++)
+        {
+            if (rounds == 0)
+                start (s, round);
+            else if (!searched[s].converged && !searched[s].dropped)
+                step (s, round);
+        }
+
+        if (round.empty ())
+            break;
+
+        pool.run (round, run_candidate_worker, this);
+        finish_round (round);
+        rounds++;
+    }
+
+    report (num_threads, seconds_since (start_time));
+}
+
+void Tuner::run_candidate_worker (int c, void *arg)
+{
+    ((Tuner *)arg)->run_candidate (c);
+}
+
+void Tuner::run_candidate (int i)
+{
+    Candidate *c = candidates[i];
+    Sim_settings config = settings;
+
+    config.protocol = (protocol_t)lists[TUNE_PROTOCOL][c->point[TUNE_PROTOCOL]];
+    config.l1_cache_size = sizes[c->size];
+    config.l1_cache_assoc = lists[TUNE_ASSOC][c->point[TUNE_ASSOC]];
+    config.cache_line_size_log2 = lists[TUNE_LINE][c->point[TUNE_LINE]];
+    config.cache_line_size = 1 << config.cache_line_size_log2;
+    config.mem_hit_time = lists[TUNE_LATENCY][c->point[TUNE_LATENCY]];
+    config.cycle_bound = &c->bound;
+
+    {
+        unique_lock<mutex> guard (lock);
+
+        c->bound = bound_at (c->size);
+        running.push_back (i);
+    }
+
+    Simulation simulation (config, trace_dir);
+    simulation.log = Simulation::discard ();
+    c->result = simulation.run ();
+    c->stopped = simulation.stopped;
+
+    unique_lock<mutex> guard (lock);
+
+    running.erase (find (running.begin (), running.end (), i));
+    c->done = true;
+    if (c->stopped || c->result.run_time >= best_time[c->size])
+        return;
+
+    /** Whatever is running at this size or a larger one has this to beat.  */
+    best_time[c->size] = c->result.run_time;
+    for (unsigned int r = 0; r < running.size (); r++)
+    {
+        Candidate *other = candidates[running[r]];
+
+        if (other->size >= c->size && other->bound > c->result.run_time)
+            other->bound = c->result.run_time;
+    }
+}
+
+/** Command line options that run the candidate again, with its log.  */
+void Tuner::describe (Candidate *c, char *spec, int size)
+{
+    snprintf (spec, size, "-p %s -o l1_infinite=0,l1_cache_size=%d,l1_cache_assoc=%d,"
+              "cache_line_size_log2=%d,mem_hit_time=%d",
+              protocol_name ((protocol_t)lists[TUNE_PROTOCOL][c->point[TUNE_PROTOCOL]]),
+              sizes[c->size], lists[TUNE_ASSOC][c->point[TUNE_ASSOC]],
+              lists[TUNE_LINE][c->point[TUNE_LINE]], lists[TUNE_LATENCY][c->point[TUNE_LATENCY]]);
+}
+
+void Tuner::report (int num_threads, double seconds)
+{
+    VECTOR<int> tried_at (sizes.size (), 0);
+    VECTOR<bool> front (sizes.size (), false);
+    timestamp_t fastest = TUNE_NO_BOUND;
+    int stopped = 0;
+    char spec[256];
+
+    for (unsigned int i = 0; i < candidates.size (); i++)
+    {
+        tried_at[candidates[i]->size]++;
+        stopped += candidates[i]->stopped;
+    }
+
+    /** On the front if faster than everything smaller.  */
+    for (unsigned int s = 0; s < sizes.size (); s++)
+        if (best_time[s] < fastest)
+        {
+            front[s] = true;
+            fastest = best_time[s];
+        }
+
+    fprintf (stdout, "\nTuning %s: %d of %d configurations run in %d rounds on %d threads, "
+             "%d given up on early, %.2f s\n", trace_dir, (int)candidates.size (), space (),
+             rounds, num_threads, stopped, seconds);
+    fprintf (stdout, "%10s %-8s %6s %6s %8s %10s %10s %10s %10s %6s  %s\n", "L1 Size",
+             "Protocol", "Ways", "Line", "Memory", "Run Time", "Misses", "$-to-$", "Writebacks",
+             "Tried", "");
+
+    for (unsigned int s = 0; s < sizes.size (); s++)
+    {
+        Size &z = searched[s];
+        const char *status = front[s] ? "front" : z.dropped ? "dropped" : "dominated";
+
+        if (z.best < 0)
+        {
+            fprintf (stdout, "%10d %-8s %6s %6s %8s %10s %10s %10s %10s %6d  %s\n", sizes[s],
+                     "-", "-", "-", "-", "-", "-", "-", "-", tried_at[s],
+                     z.from < 0 ? "no valid geometry" : status);
+            continue;
+        }
+
+        Candidate *c = candidates[z.best];
+        Sim_result &r = c->result;
+
+        fprintf (stdout, "%10d %-8s %6d %6d %8d %10lld %10ld %10ld %10ld %6d  %s\n", sizes[s],
+                 protocol_name ((protocol_t)lists[TUNE_PROTOCOL][c->point[TUNE_PROTOCOL]]),
+                 lists[TUNE_ASSOC][c->point[TUNE_ASSOC]],
+                 1 << lists[TUNE_LINE][c->point[TUNE_LINE]],
+                 lists[TUNE_LATENCY][c->point[TUNE_LATENCY]], (long long int)r.run_time,
+                 r.stats.cache_misses, r.stats.cache_to_cache_transfers, r.stats.writebacks,
+                 tried_at[s], status);
+    }
+
+    fprintf (stdout, "\nThe front, to run again:\n");
+    for (unsigned int s = 0; s < sizes.size (); s++)
+        if (front[s])
+        {
+            describe (candidates[searched[s].best], spec, sizeof (spec));
+            fprintf (stdout, "%10d  %s\n", sizes[s], spec);
+        }
+}
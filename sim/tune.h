@@ -0,0 +1,136 @@
+#ifndef TUNE_H_
+#define TUNE_H_
+
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+
+#include "settings.h"
+#include "simulation.h"
+#include "stats.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include "types.h"
+
+using namespace std;
+
+/** The lists a configuration picks one value from, besides the L1 size.  */
+#define TUNE_PROTOCOL   0
+#define TUNE_ASSOC      1
+#define TUNE_LINE       2
+#define TUNE_LATENCY    3
+#define TUNE_LISTS      4
+
+#define TUNE_NO_BOUND   ((timestamp_t)~0ULL)
+
+/**
+ * Searches L1 and memory settings for the fastest run of a trace at each
+ * L1 size, and reports the Pareto front of run time against L1 size.
+ *
+ * The spec has one list per line, named by its first word, and # starts a
+ * comment:
+ *
+ *     protocols MESI MOESI MOESIF
+ *     l1_cache_size 1024 2048 4096 8192
+ *     l1_cache_assoc 1 2 4 8
+ *     cache_line_size_log2 4 5 6
+ *     mem_hit_time 100 200
+ *
+ * A list left out holds the base setting alone (the protocol of -p, or
+ * every protocol without it).  The caches are finite (see hash_table.h),
+ * and a combination whose sets do not come to a power of 2 is left out.
+ *
+ * Rather than the whole grid, each size is searched by coordinate descent
+ * from the middle of the lists.  A round runs, for every size still
+ * searched, the configurations one step along one list from the best one
+ * of the size so far (every other protocol, the next value either way of
+ * the others), and the size is done once rounds along every list in turn
+ * have not improved on it.  The candidates of a round are jobs of one
+ * Job_pool, smallest size first, each a simulation (see simulation.h) on
+ * traces decoded once for all of them (see trace.h).
+ *
+ * A configuration can only be on the front if it beats every smaller one,
+ * so the search prunes twice.  A candidate is given up on (see
+ * cycle_bound) once its clock passes the best run time known at its size
+ * or any smaller one, which running candidates lower as they finish.  And
+ * a size that is still no faster than a smaller one after a round along
+ * every list is dropped, along with the rest of its part of the space.
+ */
+class Tuner {
+public:
+    Tuner (const char *spec_file);
+    ~Tuner ();
+
+    /** Searches with base settings, then reports to stdout.  */
+    void run (Sim_settings &base, const char *trace_dir);
+
+private:
+    class Candidate {
+    public:
+        int size;
+        int point[TUNE_LISTS];
+
+        /** The run's cycle_bound.  */
+        atomic<timestamp_t> bound;
+
+        Sim_result result;
+        bool done;
+        bool stopped;
+    };
+
+    class Size {
+    public:
+        /** Best finished candidate, and where the descent goes from: the
+         *  first one tried until one finishes.  -1 before any.  */
+        int best;
+        int from;
+
+        /** List the next round steps along, lists stepped along (or found
+         *  with nothing left to try) in all, and in a row without
+         *  improving on best.  */
+        int list;
+        int rounds;
+        int quiet;
+
+        /** In the round that is running.  */
+        bool stepped;
+        bool improved;
+
+        bool converged;
+        bool dropped;
+    };
+
+    VECTOR<int> sizes;
+    VECTOR<int> lists[TUNE_LISTS];
+
+    VECTOR<Candidate *> candidates;
+    MAP<VECTOR<int>, int> tried;
+    VECTOR<Size> searched;
+
+    /** Best run time finished at each size.  */
+    VECTOR<timestamp_t> best_time;
+
+    /** Over best_time and the bounds of the candidates running.  */
+    mutex lock;
+    VECTOR<int> running;
+
+    Sim_settings settings;
+    const char *trace_dir;
+    Trace_source *source;
+    int rounds;
+
+    void parse (const char *spec_file);
+    bool valid (int size, int *point);
+    int space (void);
+    void start (int size, VECTOR<int> &round);
+    int candidate (int size, int *point);
+    void step (int size, VECTOR<int> &round);
+    void finish_round (VECTOR<int> &round);
+    timestamp_t bound_at (int size);
+    void run_candidate (int c);
+    static void run_candidate_worker (int c, void *arg);
+    void report (int num_threads, double seconds);
+    void describe (Candidate *c, char *spec, int size);
+};
+
+#endif /* TUNE_H_ */